@@ -10,9 +10,11 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <limits.h>
+#include <setjmp.h>
 #include "incdir.h"
 
 #define TEXTLEN 512		// Used by several buffers
+#define QBECMD "qbe -o "	// Command to translate a QBE file
 #define PTR_SIZE 8		// Pointer size in bytes
 
 typedef struct Type Type;
@@ -23,6 +25,8 @@ typedef struct Strlit Strlit;
 typedef struct Sym Sym;
 typedef struct Scope Scope;
 typedef struct ASTnode ASTnode;
+typedef struct Pch Pch;
+typedef struct Heldfunc Heldfunc;
 
 // Type kinds
 enum {
@@ -30,6 +34,8 @@ enum {
   TY_VOID, TY_BOOL, TY_STRING, TY_USER, TY_STRUCT, TY_FUNCPTR
 };
 
+#define NUMBUILTIN 14		// Number of built-in types
+
 // Type structure. Built-ins are kept as
 // separate variables. We keep a linked
 // list of user-defined types
@@ -47,6 +53,9 @@ struct Type {
   Paramtype *paramtype;		// List of parameter types for function pointers
   Type *excepttype;		// Exception type for a function pointer
   bool is_variadic;		// Is the function pointer variadic
+  Type *ptrto;			// Cached result of pointer_to()
+  Type *valat;			// Cached result of value_at()
+  Type *hashnext;		// Next type in the same type hash bucket
   Type *next;
 };
 
@@ -126,6 +135,7 @@ struct Strlit {
   char *val;			// The string literal
   int label;			// Label associated with the string
   bool is_const;		// Is the literal constant?
+  Strlit *hashnext;		// Next literal in the same hash bucket
   Strlit *next;
 };
 
@@ -148,6 +158,10 @@ struct Sym {
   Type *keytype;		// Key type for associative arrays
   Sym *paramlist;		// List of function parameters
   Sym *exceptvar;		// Function variable that holds an exception
+  ASTnode *constval;		// Literal value of a const scalar, or NULL
+  bool in_unit;			// With -U, a private global of this file
+  char *qbename;		// The name in the QBE code, if not name
+  Heldfunc *heldcode;		// With -U, the function's held back code
   Sym *next;			// Pointer to the next symbol
 };
 
@@ -165,31 +179,48 @@ enum {
 // we search the most recent scope first.
 struct Scope {
   Sym *head;			// Head of the scope's symbol table
+  Sym *tail;			// Last symbol in the scope's table
+  Sym *func;			// Function whose parameters are in this scope
   Scope *next;			// Pointer to the next scope
 };
 
 // Abstract Syntax Tree structure
+//
+// The fields are ordered to avoid any padding,
+// and the flags are single bits, to keep the
+// nodes small. The literal value is only used by
+// nodes with no name: A_NUMLIT, A_SCALE, A_SWITCH
+// and A_CASE. So it shares its space with the name,
+// and the dimension sizes or key type which only
+// named declarations and references use.
 struct ASTnode {
-  int op;			// "Operation" to be performed on this tree
-  Type *type;			// Pointer to the node's type
-  Type *keytype;		// Key type of an assoc array declaration
-  bool rvalue;			// True if an expression is an rvalue
-  bool is_variadic;		// True if a function is variadic
-  bool is_array;		// True if a declaration is an array
-  int dimensions;		// Number of array dimensions
-  int *dimsize;			// List of sizes per dimension
-  bool is_const;		// True if a declaration is marked const
-  bool is_inout;		// True if a declaration is marked "inout"
-  bool is_short_assign;		// True if right child is the end code of a FOR loop
   ASTnode *left;		// Left, middle and right child trees
   ASTnode *mid;
   ASTnode *right;
+  Type *type;			// Pointer to the node's type
   Sym *sym;			// For many AST nodes, the pointer to
 				// the symbol in the symbol table
-  int count;			// For some nodes, the repetition count
-  Litval litval;		// For A_NUMLIT, the numeric literal value
-  char *strlit;			// For some nodes, the string literal value
+  union {
+    Litval litval;		// For A_NUMLIT, the numeric literal value
+    struct {
+      char *strlit;		// For some nodes, the string literal value
+      union {
+	int *dimsize;		// List of sizes per dimension, or
+	Type *keytype;		// key type of an assoc array declaration
+      };
+    };
+  };
   int line;			// Line number for this ASTnode
+  int count;			// For some nodes, the repetition count
+  int16_t dimensions;		// Number of array dimensions
+  uint8_t op;			// "Operation" to be performed on this tree
+  bool rvalue:1;		// True if an expression is an rvalue
+  bool is_variadic:1;		// True if a function is variadic
+  bool is_array:1;		// True if a declaration is an array
+  bool is_const:1;		// True if a declaration is marked const
+  bool is_inout:1;		// True if a declaration is marked "inout"
+  bool is_short_assign:1;	// True if right child is the end code of a FOR loop
+  bool in_range:1;		// True if the value needs no range or cast check
 };
 
 // AST node types
@@ -207,7 +238,7 @@ enum {
   A_VASTART, A_VAARG, A_VAEND, A_CAST,				// 50
   A_AARRAY, A_EXISTS, A_UNDEF, A_AAFREE,			// 54
   A_AAITERSTART, A_AANEXT, A_FUNCITER, A_STRINGITER,		// 58
-  A_ARRAYITER							// 62
+  A_ARRAYITER, A_STRLEN						// 62
 };
 
 // We keep a stack of jump labels
@@ -223,43 +254,212 @@ struct Breaklabel {
 // has no temporary number to return
 #define NOTEMP -1
 
-// External variables and structures
-extern char *Infilename;	// Name of file we are parsing
-extern FILE *Infh;		// The input file handle
-extern FILE *Outfh;		// The output file handle
-extern FILE *Debugfh;		// The debugging file handle
-extern int Line;		// Current line number
+// AST nodes, symbols and types are allocated from arenas.
+// An arena is a list of large blocks which can all be
+// released at once, e.g. at the end of each function
+typedef struct Arenablk Arenablk;
+struct Arenablk {
+  size_t size;			// Number of bytes in the block
+  size_t used;			// Number of bytes allocated so far
+  Arenablk *next;		// The next block in the arena
+  char mem[];			// The block's memory
+};
+
+typedef struct Arena Arena;
+struct Arena {
+  char *name;			// Name of the arena, for the stats
+  Arenablk *head;		// The first and last blocks in the arena
+  Arenablk *tail;
+  Arenablk *cur;		// The block we are allocating from
+  size_t inuse;			// Bytes currently allocated
+  size_t peak;			// Highest value of inuse
+  size_t total;			// Bytes allocated over the arena's lifetime
+};
+
+#define ARENABLKSIZE 65536	// Size of a normal arena block
+
+// The compiler's phases, for the -L time report
+enum {
+  PH_OTHER, PH_PREPROC, PH_SCAN, PH_PARSE, PH_OPTIMISE,
+  PH_GENAST, PH_QBE, PH_ASSEMBLE, PH_LINK, PH_MAX
+};
+
+// The types private to the parts of the compiler
+// which keep their state in the Compstate below
+typedef struct Edetails Edetails;
+typedef struct Switchlabel Switchlabel;
+typedef struct Macro Macro;
+typedef struct Srcfile Srcfile;
+typedef struct Hashent Hashent;
+
+// A growable list of interned names
+typedef struct Namelist Namelist;
+struct Namelist {
+  char **name;
+  int count;
+  int size;
+};
+
+// A range of values
+typedef struct Range Range;
+struct Range {
+  int64_t lo;
+  int64_t hi;
+};
+
+// A loop variable and its range in the loop's body
+typedef struct Loopvar Loopvar;
+struct Loopvar {
+  Sym *sym;
+  Range r;
+};
+
+#define OUTBUFSIZE 65536	// Size of the QBE output buffer
+#define MACROHASHSIZE 1024	// The hash table sizes,
+#define SYMHASHSIZE  4096	// which must be powers of two
+#define MEMBHASHSIZE 1024
+#define STRHASHSIZE 1024
+#define TYPEHASHSIZE 1024
+#define MAXLOOPDEPTH 64		// Deepest loop nesting we track
+
+// The state of the compiler while it compiles a file,
+// grouped by the file which uses it. Each thread has its
+// own, so that threads can compile files at once, and
+// state_reset() frees it and starts it afresh. The phase
+// times and where fatal() jumps to are kept in misc.c,
+// as they last over all the files that a thread compiles
+typedef struct Compstate Compstate;
+struct Compstate {
+  // main.c
+  char *Infilename;		// Name of file we are parsing
+  FILE *Outfh;			// The output file handle
+  char *Outfilename;		// Name of our output file
+  pid_t Qbepid;			// The qbe and as processes when
+  pid_t Aspid;			// we are piping the QBE code
+  int Line;			// Current line number
+  Arena *Permarena;		// Arena for globals and types
+  Arena *Funcarena;		// Arena for the function we are parsing
+  Arena *Thisarena;		// Arena for new AST nodes and local symbols
+
+  // lexer.c
+  Token Peektoken;		// A look-ahead token
+  Token Thistoken;		// The last token scanned
+  char Text[TEXTLEN + 1];	// Text of the last token scanned
+  char *Nextunit;		// With -U, the next file to parse
+  int Linestart;		// We are at start of the line
+  int Putback;			// The token that was put back
+  char *Inptr;			// The next character of the input
+  char *Inend;			// Just past the end of the input
+
+  // preproc.c
+  Macro *Macrohash[MACROHASHSIZE];	// The macros
+  Srcfile *Srchead;		// The files that we have read
+  char *Lineend;		// The end of the line being expanded
+  int Morelines;		// Lines added by a macro call
+  bool Recording;		// Precompiling a header, so record
+  Namelist Missed;		// names that were not macros
+  Namelist Readfiles;		// and the files read
+  char *Expr;			// The #if expression being evaluated
+  int Noeval;			// Non-zero where the value is not used
+
+  // parser.c
+  Sym *Thisfunction;		// The function we are parsing
+  Sym *lastmemb;		// The last member added to a struct
+  bool value_returned;		// The function has returned a value
+  int hididx;			// Number of the next hidden index variable
+  int bel_depth;		// Depth of '{' in an expression list
+
+  // syms.c
+  Scope *Scopehead;		// Pointer to the most recent scope
+  Scope *Globhead;		// Pointer to the global symbol table
+  Hashent *Symhash[SYMHASHSIZE];	// The visible symbols
+  Hashent *Membhash[MEMBHASHSIZE];	// The struct members
+  Hashent *Freeent;		// List of unused entries
+  char *Unitfile;		// With -U, the file we are parsing
+  int Unitnum;			// and its number
+
+  // types.c
+  Type Builtins[NUMBUILTIN];	// The built-in types
+  Type *Typehead;		// Head of the type list
+  Type *Typehash[TYPEHASHSIZE];	// The types by name or kind
 
-extern Token Peektoken;		// A look-ahead token
-extern Token Thistoken;		// The last token scanned
-extern char Text[];		// Text of the last token scanned
+  // pch.c
+  Pch *Thispch;			// The precompiled header we are reading
+  char *Rptr;			// Our position in its data
+  Type **Rtypes;		// The types, found or made
+  int Numrtypes;
 
-extern Sym *Thisfunction;	// The function we are parsing
+  // ranges.c
+  Loopvar Loopvars[MAXLOOPDEPTH];	// The loop variables' ranges
+  int Numloopvars;
+  Sym **Addrsyms;		// The symbols whose address is taken
+  int Numaddrsyms;
+  int Maxaddrsyms;
+  int Boundsremoved;		// The number of bounds and
+  int Rangesremoved;		// range checks removed
+  int Numslots;			// Slot numbers used in the function
+
+  // genast.c
+  Edetails *Ehead;		// The stack of Edetail nodes
+  Breaklabel *Breakhead;	// The stack of Breaklabel nodes
+  Switchlabel *Switchhead;	// The stack of Switchlabel nodes
+  int *Strlentemps;		// The temporaries holding string
+  int Maxstrlens;		// lengths, by slot number
+  int labelid;			// The last label number
+
+  // funcs.c
+  int Functemps;		// The temporaries and labels used
+  int Funclabels;		// before the current function
+  Heldfunc *Heldhead;		// With -U, the functions whose code
+  Heldfunc *Heldtail;		// is held back, and the one being
+  Heldfunc *Thisheld;		// generated
+  int Funcsremoved;		// Number of unused functions removed
+
+  // cgen.c
+  int nexttemp;			// Incrementing temporary number
+  int va_ptr;			// Temporary holding the vastart list
+  int globoffset;		// Offset in a global struct
+
+  // strlits.c
+  Strlit *Strhead;		// Linked list of literals
+  Strlit *Strtail;		// Last literal in the list
+  Strlit *Strhash[STRHASHSIZE];	// The literals by value
+
+  // emit.c
+  char Outbuf[OUTBUFSIZE];	// The QBE code not yet written
+  int Outpos;			// Next free position in Outbuf
+  size_t Outbytes;		// Bytes output to this file so far
+  char *Holdbuf;		// With -U, the held back code of
+  size_t Holdpos;		// this function, the next free
+  size_t Holdsize;		// position and the buffer's size
+};
+
+extern _Thread_local Compstate State;
+extern FILE *Debugfh;		// The debugging file handle
+
+// The built-in types
+#define ty_void (&State.Builtins[0])
+#define ty_bool (&State.Builtins[1])
+#define ty_int8 (&State.Builtins[2])
+#define ty_int16 (&State.Builtins[3])
+#define ty_int32 (&State.Builtins[4])
+#define ty_int64 (&State.Builtins[5])
+#define ty_uint8 (&State.Builtins[6])
+#define ty_uint16 (&State.Builtins[7])
+#define ty_uint32 (&State.Builtins[8])
+#define ty_uint64 (&State.Builtins[9])
+#define ty_flt32 (&State.Builtins[10])
+#define ty_flt64 (&State.Builtins[11])
+#define ty_voidptr (&State.Builtins[12])
+#define ty_string (&State.Builtins[13])
 
 extern int64_t typemin[8];	// Minimum values per type
 extern int64_t typemax[8];	// Maximum values per type
 
-extern Type *ty_void;		// The built-in types
-extern Type *ty_bool;
-extern Type *ty_int8;
-extern Type *ty_int16;
-extern Type *ty_int32;
-extern Type *ty_int64;
-extern Type *ty_uint8;
-extern Type *ty_uint16;
-extern Type *ty_uint32;
-extern Type *ty_uint64;
-extern Type *ty_flt32;
-extern Type *ty_flt64;
-extern Type *ty_voidptr;
-extern Type *ty_string;
-extern Type *Typehead;		// Head of the type list
-
-extern int Linestart;		// In lexer, we are at start of the line
-extern int Putback;		// The token that was put back
-
 extern bool O_dumptokens;	// Dump the input file's tokens
 extern bool O_dumpsyms;		// Dump the symbol table
 extern bool O_dumpast;		// Dump each function's AST tree
 extern bool O_logmisc;		// Log miscellaneous things
+extern bool O_logtime;		// Log the time spent in each phase
 extern bool O_boundscheck;	// Do array bounds checking
+extern bool O_verbose;		// Describe the compiler's steps
@@ -8,15 +8,15 @@
 ASTnode *mkastnode(int op, ASTnode * left, ASTnode * mid, ASTnode * right) {
   ASTnode *n;
 
-  // Malloc a new ASTnode
-  n = (ASTnode *) Calloc(sizeof(ASTnode));
+  // Allocate a new ASTnode
+  n = (ASTnode *) Aalloc(State.Thisarena, sizeof(ASTnode));
 
   // Copy in the field values and return it
   n->op = op;
   n->left = left;
   n->mid = mid;
   n->right = right;
-  n->line = Line;
+  n->line = State.Line;
   return (n);
 }
 
@@ -29,10 +29,47 @@ ASTnode *mkastleaf(int op, Type * type, bool rvalue,
   n->rvalue = rvalue;
   n->sym = sym;
   n->litval.intval = intval;
-  n->line = Line;
+  n->line = State.Line;
   return (n);
 }
 
+// Is this node linked to the next one in a chain?
+// Statements are glued into a left-deep chain of A_GLUE
+// nodes, and declarations are A_LOCAL nodes linked
+// by their mid child
+static bool is_chained(ASTnode * n) {
+  if (n->op == A_GLUE && n->is_short_assign == false)
+    return (n->left != NULL && n->left->op == A_GLUE &&
+	    n->left->is_short_assign == false);
+  if (n->op == A_LOCAL)
+    return (n->mid != NULL && n->mid->op == A_LOCAL);
+  return (false);
+}
+
+// A generated function can have a huge list of statements
+// or declarations. So that the tree walkers don't recurse
+// once per statement, return the nodes in the chain starting
+// at n, n first, in an array and set *count. Free it after use
+ASTnode **ast_chain(ASTnode * n, int *count) {
+  ASTnode **list = NULL;
+  int size = 0;
+
+  *count = 0;
+  while (1) {
+    if (*count == size) {
+      size = (size == 0) ? 64 : size * 2;
+      list = (ASTnode **) realloc(list, size * sizeof(ASTnode *));
+      if (list == NULL)
+	fatal("Malloc failure\n");
+    }
+    list[(*count)++] = n;
+    if (is_chained(n) == false)
+      break;
+    n = (n->op == A_LOCAL) ? n->mid : n->left;
+  }
+  return (list);
+}
+
 // List of AST node names
 static char *astname[] = { NULL,
   "ASSIGN", "WIDEN",
@@ -48,14 +85,12 @@ static char *astname[] = { NULL,
   "VASTART", "VAARG", "VAEND", "CAST",
   "AARRAY", "EXISTS", "UNDEF", "AAFREE",
   "AAITERSTART", "AANEXT", "FUNCITER", "STRINGITER",
-  "ARRAYITER"
+  "ARRAYITER", "STRLEN"
 };
 
-// Given an AST tree, print it out and follow the
-// traversal of the tree that genAST() follows
-void dumpAST(ASTnode * n, int level) {
-  if (n == NULL)
-    fatal("NULL AST node\n");
+// Print out the line for one AST node. Return
+// false if its children have already been printed
+static bool dump_node(ASTnode * n, int level) {
 
   // General AST node handling
   for (int i = 0; i < level; i++)
@@ -90,7 +125,7 @@ void dumpAST(ASTnode * n, int level) {
     fprintf(Debugfh, "\"%s\"\n", n->left->strlit);
     if (n->right)
       dumpAST(n->right, level + 2);
-    return;
+    return (false);
   }
 
   if (n->is_const == true)
@@ -103,10 +138,56 @@ void dumpAST(ASTnode * n, int level) {
     fprintf(Debugfh, " count %d", n->count);
 
   fprintf(Debugfh, "\n");
+  return (true);
+}
 
-  // Reset the level if an A_LOCAL node
-  if (n->op == A_LOCAL)
-    level -= 2;
+// Given an AST tree, print it out and follow the
+// traversal of the tree that genAST() follows
+void dumpAST(ASTnode * n, int level) {
+  ASTnode **chain;
+  int count, i;
+
+  if (n == NULL)
+    fatal("NULL AST node\n");
+
+  // A chain of declarations. Each one and its
+  // children are printed at the same level
+  if (n->op == A_LOCAL) {
+    chain = ast_chain(n, &count);
+    for (i = 0; i < count; i++) {
+      dump_node(chain[i], level);
+      if (chain[i]->left)
+	dumpAST(chain[i]->left, level);
+    }
+    if (chain[count - 1]->mid)
+      dumpAST(chain[count - 1]->mid, level);
+    for (i = count - 1; i >= 0; i--)
+      if (chain[i]->right)
+	dumpAST(chain[i]->right, level);
+    free(chain);
+    return;
+  }
+
+  // A chain of statements. Each A_GLUE node
+  // is indented more than the one above it
+  if (n->op == A_GLUE) {
+    chain = ast_chain(n, &count);
+    for (i = 0; i < count; i++)
+      dump_node(chain[i], level + 2 * i);
+    if (chain[count - 1]->left)
+      dumpAST(chain[count - 1]->left, level + 2 * count);
+    for (i = count - 1; i >= 0; i--) {
+      if (chain[i]->mid)
+	dumpAST(chain[i]->mid, level + 2 * i + 2);
+      if (chain[i]->right)
+	dumpAST(chain[i]->right, level + 2 * i + 2);
+    }
+    free(chain);
+    return;
+  }
+
+  if (dump_node(n, level) == false)
+    return;
 
   // General AST node handling
   if (n->left)
@@ -117,62 +198,294 @@ void dumpAST(ASTnode * n, int level) {
     dumpAST(n->right, level + 2);
 }
 
-// Is this an integer NUMLIT?
-static bool is_intlit(ASTnode * n) {
-  if (n == NULL)
+// Is this a NUMLIT that we can fold: an
+// integer, a float or a boolean value?
+static bool is_lit(ASTnode * n) {
+  if (n == NULL || n->op != A_NUMLIT)
     return (false);
-  if (n->op == A_NUMLIT && is_integer(n->type))
-    return (true);
-  return (false);
+  return (is_numeric(n->type) || n->type == ty_bool);
+}
+
+// Make a NUMLIT of the given type with an integer value
+static ASTnode *mkintlit(Type * type, int64_t val) {
+  return (mkastleaf(A_NUMLIT, type, true, NULL, val));
+}
+
+// The run-time code does integer sums in 32-bit words
+// for types smaller than 64 bits. Wrap the value to
+// the word, sign or zero extended as the type is
+static int64_t wrap_int(int64_t val, Type * type) {
+  if (type->size == 8)
+    return (val);
+  return ((type->is_unsigned) ? (int64_t) (uint32_t) val :
+	  (int64_t) (int32_t) val);
+}
+
+// Make a NUMLIT of the given type with a float value
+static ASTnode *mkfltlit(Type * type, double val) {
+  ASTnode *n = mkastleaf(A_NUMLIT, type, true, NULL, 0);
+  n->litval.dblval = val;
+  return (n);
+}
+
+// Float literals are output with "%f". Return true if
+// the value survives that, so that folding doesn't
+// lose any precision that the run-time code would keep
+static bool flt_exact(double val, Type * type) {
+  char buf[TEXTLEN];
+
+  if (val != val || val - val != 0)
+    return (false);
+  snprintf(buf, sizeof(buf), "%f", val);
+  if (type->kind == TY_FLT32)
+    return ((float) strtod(buf, NULL) == (float) val);
+  return (strtod(buf, NULL) == val);
+}
+
+// Return true if the integer value of a literal
+// fits into the type, including any range on it.
+// An unsigned 64-bit value above INT64_MAX only
+// fits into an unsigned 64-bit type
+static bool int_in(int64_t val, bool big, Type * type) {
+  int bits = type->size * 8;
+
+  if (big)
+    return (type->is_unsigned && bits == 64 && !has_range(type));
+
+  if (type->is_unsigned) {
+    if (val < 0 || (bits < 64 && val > ((int64_t) 1 << bits) - 1))
+      return (false);
+  } else if (bits < 64 && (val < -((int64_t) 1 << (bits - 1)) ||
+			   val > ((int64_t) 1 << (bits - 1)) - 1))
+    return (false);
+
+  if (has_range(type) && (val < type->lower || val > type->upper))
+    return (false);
+  return (true);
+}
+
+// Return true if the integer value of a literal of type
+// from fits into the type to. Folding does its sums in
+// 64 bits, so the value must also fit the type from:
+// if not, the run-time conversion would see it trimmed
+static bool int_fits(int64_t val, Type * from, Type * to) {
+  bool big = (from->is_unsigned && from->size == 8 && val < 0);
+
+  return (int_in(val, big, from) && int_in(val, big, to));
+}
+
+// Convert a literal to the given type. Return a new
+// literal, or NULL if the value won't fit exactly
+// and so the conversion has to be done at run-time
+static ASTnode *convert_lit(ASTnode * n, Type * type) {
+  double val;
+
+  if (n->type == type)
+    return (n);
+  if (n->type == ty_bool || type == ty_bool)
+    return (NULL);
+
+  if (is_integer(n->type) && is_integer(type)) {
+    if (!int_fits(n->litval.intval, n->type, type))
+      return (NULL);
+    return (mkintlit(type, n->litval.intval));
+  }
+
+  if (!is_flonum(type))
+    return (NULL);
+  if (is_integer(n->type))
+    val = (n->type->is_unsigned) ? (double) (uint64_t) n->litval.intval :
+      (double) n->litval.intval;
+  else
+    val = n->litval.dblval;
+  if (type->kind == TY_FLT32)
+    val = (float) val;
+  if (!flt_exact(val, type))
+    return (NULL);
+  return (mkfltlit(type, val));
 }
 
-// Fold an AST tree with a binary operator
-// and two integer A_NUMLIT children. Return either 
+// Fold an AST tree with a binary operator and two
+// float NUMLIT children. Return either the original
+// tree or a new leaf node.
+static ASTnode *fold2flt(ASTnode * n) {
+  double val, leftval, rightval;
+
+  leftval = n->left->litval.dblval;
+  rightval = n->right->litval.dblval;
+
+  switch (n->op) {
+  case A_ADD:
+    val = leftval + rightval;
+    break;
+  case A_SUBTRACT:
+    val = leftval - rightval;
+    break;
+  case A_MULTIPLY:
+    val = leftval * rightval;
+    break;
+  case A_DIVIDE:
+    if (rightval == 0)
+      return (n);
+    val = leftval / rightval;
+    break;
+  case A_EQ:
+    return (mkintlit(ty_bool, leftval == rightval));
+  case A_NE:
+    return (mkintlit(ty_bool, leftval != rightval));
+  case A_LT:
+    return (mkintlit(ty_bool, leftval < rightval));
+  case A_GT:
+    return (mkintlit(ty_bool, leftval > rightval));
+  case A_LE:
+    return (mkintlit(ty_bool, leftval <= rightval));
+  case A_GE:
+    return (mkintlit(ty_bool, leftval >= rightval));
+  default:
+    return (n);
+  }
+
+  if (n->type->kind == TY_FLT32)
+    val = (float) val;
+  if (!flt_exact(val, n->type))
+    return (n);
+  return (mkfltlit(n->type, val));
+}
+
+// Fold an AST tree with a binary operator and two
+// integer or boolean NUMLIT children. Return either
 // the original tree or a new leaf node.
 static ASTnode *fold2(ASTnode * n) {
+  Type *ty = n->left->type;
   int64_t val, leftval, rightval;
+  uint64_t uleft, uright;
 
-  // Get the values from each child
+  if (is_flonum(ty) || is_flonum(n->right->type)) {
+    if (is_flonum(ty) && is_flonum(n->right->type))
+      return (fold2flt(n));
+    return (n);
+  }
+
+  // Get the values from each child. The
+  // sums are done in 64 bits, whatever
+  // the size of the literals' type
   leftval = n->left->litval.intval;
   rightval = n->right->litval.intval;
+  uleft = leftval;
+  uright = rightval;
 
-  // Perform some of the binary operations.
-  // For any AST op we can't do, return
-  // the original tree.
+  // A sum of two literals can take the type of
+  // the right one, so its value may not fit the
+  // type. The run-time code would trim such a
+  // value, so only fold the other operations
+  // when the values fit in their words
+  if (n->op != A_ADD && n->op != A_SUBTRACT && n->op != A_MULTIPLY &&
+      n->op != A_DIVIDE && (wrap_int(leftval, ty) != leftval ||
+			    wrap_int(rightval, n->right->type) != rightval))
+    return (n);
+
+  // Perform the binary operations. For any
+  // AST op we can't do, return the original tree.
   switch (n->op) {
   case A_ADD:
-    val = leftval + rightval;
+    val = (uint64_t) leftval + (uint64_t) rightval;
     break;
   case A_SUBTRACT:
-    val = leftval - rightval;
+    val = (uint64_t) leftval - (uint64_t) rightval;
     break;
   case A_MULTIPLY:
-    val = leftval * rightval;
+    val = (uint64_t) leftval * (uint64_t) rightval;
     break;
   case A_DIVIDE:
-    // Don't try to divide by zero.
+  case A_MOD:
+    // Don't try to divide by zero, or
+    // overflow when dividing by -1
     if (rightval == 0)
       return (n);
-    val = leftval / rightval;
+    if (ty->is_unsigned)
+      val = (n->op == A_DIVIDE) ? uleft / uright : uleft % uright;
+    else {
+      if (rightval == -1)
+	return (n);
+      val = (n->op == A_DIVIDE) ? leftval / rightval : leftval % rightval;
+    }
+    break;
+  case A_AND:
+    val = leftval & rightval;
+    break;
+  case A_OR:
+    val = leftval | rightval;
     break;
+  case A_XOR:
+    val = leftval ^ rightval;
+    break;
+  case A_LSHIFT:
+  case A_RSHIFT:
+    // The run-time shifts are done in 32-bit
+    // words for types smaller than 64 bits
+    if (ty->size == 8) {
+      if (rightval < 0 || rightval >= 64)
+	return (n);
+      val = (n->op == A_LSHIFT) ? uleft << rightval : uleft >> rightval;
+      break;
+    }
+    if (rightval < 0 || rightval >= 32)
+      return (n);
+    val = (n->op == A_LSHIFT) ? (uint32_t) uleft << rightval :
+      (uint32_t) uleft >> rightval;
+    val = wrap_int(val, ty);
+    break;
+  case A_EQ:
+    return (mkintlit(ty_bool, leftval == rightval));
+  case A_NE:
+    return (mkintlit(ty_bool, leftval != rightval));
+  case A_LT:
+    return (mkintlit(ty_bool, (ty->is_unsigned) ? uleft < uright :
+		     leftval < rightval));
+  case A_GT:
+    return (mkintlit(ty_bool, (ty->is_unsigned) ? uleft > uright :
+		     leftval > rightval));
+  case A_LE:
+    return (mkintlit(ty_bool, (ty->is_unsigned) ? uleft <= uright :
+		     leftval <= rightval));
+  case A_GE:
+    return (mkintlit(ty_bool, (ty->is_unsigned) ? uleft >= uright :
+		     leftval >= rightval));
+  case A_LOGAND:
+    return (mkintlit(ty_bool, leftval && rightval));
+  case A_LOGOR:
+    return (mkintlit(ty_bool, leftval || rightval));
   default:
     return (n);
   }
 
   // Return a leaf node with the new value
-  return (mkastleaf(A_NUMLIT, n->type, true, NULL, val));
+  if (ty == ty_bool)
+    return (n);
+  return (mkintlit(n->type, val));
 }
 
 // Fold an AST tree with a unary operator
-// and one integer NUMLIT children. Return either 
+// and one NUMLIT child. Return either
 // the original tree or a new leaf node.
 static ASTnode *fold1(ASTnode * n) {
+  ASTnode *c = n->left;
   int64_t val;
 
+  // Conversions keep the value if it fits
+  if (n->op == A_WIDEN || n->op == A_CAST)
+    return ((c = convert_lit(c, n->type)) == NULL ? n : c);
+
+  if (is_flonum(c->type)) {
+    if (n->op != A_NEGATE)
+      return (n);
+    return (mkfltlit(n->type, -c->litval.dblval));
+  }
+
   // Get the child value. Do the
   // operation if recognised.
   // Return the new leaf node.
-  val = n->left->litval.intval;
+  val = c->litval.intval;
   switch (n->op) {
   case A_INVERT:
     val = ~val;
@@ -180,42 +493,228 @@ static ASTnode *fold1(ASTnode * n) {
   case A_NOT:
     val = !val;
     break;
+  case A_NEGATE:
+    // The run-time code would trim a value
+    // which doesn't fit in its word
+    if (wrap_int(val, c->type) != val)
+      return (n);
+    val = wrap_int(-(uint64_t) val, n->type);
+    break;
+  case A_SCALE:
+    val = (uint64_t) val * n->litval.intval;
+    return (mkintlit(n->type, val));
   default:
     return (n);
   }
 
   // Return a leaf node with the new value
-  return (mkastleaf(A_NUMLIT, n->type, true, NULL, val));
+  if (n->type != ty_bool && !is_integer(n->type))
+    return (n);
+  return (mkintlit(n->type, val));
+}
+
+// Remember the value of a const scalar variable
+// which is initialised with a literal, so that
+// the folding can use it
+void const_initval(Sym * sym, ASTnode * e) {
+  if (!sym->is_const || e == NULL || sym->dimensions != 0 ||
+      sym->keytype != NULL)
+    return;
+  if (!is_numeric(sym->type) && sym->type != ty_bool)
+    return;
+  e = optAST(e);
+  if (is_lit(e))
+    sym->constval = convert_lit(e, sym->type);
+}
+
+// If n is a const variable with a known
+// value, return the value as a NUMLIT
+static ASTnode *const_operand(ASTnode * n) {
+  ASTnode *c;
+
+  if (n == NULL || n->op != A_IDENT || n->rvalue == false ||
+      n->sym == NULL || n->sym->constval == NULL ||
+      n->type != n->sym->type)
+    return (n);
+
+  c = (ASTnode *) Aalloc(State.Thisarena, sizeof(ASTnode));
+  memcpy(c, n->sym->constval, sizeof(ASTnode));
+  c->line = n->line;
+  return (c);
+}
+
+// Is this an operator whose operands can
+// be replaced by the values of const variables?
+static bool takes_values(int op) {
+  switch (op) {
+  case A_WIDEN:
+  case A_ADD:
+  case A_SUBTRACT:
+  case A_MULTIPLY:
+  case A_DIVIDE:
+  case A_NEGATE:
+  case A_EQ:
+  case A_NE:
+  case A_LT:
+  case A_GT:
+  case A_LE:
+  case A_GE:
+  case A_NOT:
+  case A_AND:
+  case A_OR:
+  case A_XOR:
+  case A_INVERT:
+  case A_LSHIFT:
+  case A_RSHIFT:
+  case A_MOD:
+  case A_LOGAND:
+  case A_LOGOR:
+  case A_SCALE:
+  case A_BOUNDS:
+  case A_CAST:
+    return (true);
+  }
+  return (false);
+}
+
+// Fold a statement or an expression whose children
+// have been folded. Return the replacement tree
+static ASTnode *fold_node(ASTnode * n) {
+  // Use the values of const variables
+  if (takes_values(n->op)) {
+    n->left = const_operand(n->left);
+    n->right = const_operand(n->right);
+  }
+  if (n->op == A_IF || n->op == A_WHILE || n->op == A_FOR ||
+      n->op == A_TERNARY)
+    n->left = const_operand(n->left);
+
+  switch (n->op) {
+  case A_IF:
+    // Keep only the branch that will run
+    if (is_lit(n->left))
+      return ((n->left->litval.intval) ? n->mid : n->right);
+    return (n);
+  case A_WHILE:
+    // Lose a loop which never runs
+    if (is_lit(n->left) && n->left->litval.intval == 0)
+      return (NULL);
+    return (n);
+  case A_FOR:
+    // Only the initial code runs
+    if (is_lit(n->left) && n->left->litval.intval == 0)
+      return (n->right);
+    return (n);
+  case A_TERNARY:
+    if (is_lit(n->left)) {
+      if (n->left->litval.intval)
+	return (n->mid);
+      if (n->right->type == n->type)
+	return (n->right);
+    }
+    return (n);
+  case A_LOGAND:
+  case A_LOGOR:
+    // A literal on the left decides the result
+    // or leaves just the right-hand side
+    if (is_lit(n->left) && !is_lit(n->right)) {
+      if ((n->left->litval.intval != 0) == (n->op == A_LOGOR))
+	return (n->left);
+      return (n->right);
+    }
+    break;
+  }
+
+  if (!is_lit(n->left))
+    return (n);
+
+  // A binary operator with two literal children
+  if (n->right != NULL) {
+    if (is_lit(n->right) && n->mid == NULL)
+      return (fold2(n));
+    return (n);
+  }
+
+  // A unary operator with one literal child
+  if (n->mid == NULL)
+    return (fold1(n));
+  return (n);
 }
 
 // Attempt to do constant folding on
 // the AST tree with the root node n
 static ASTnode *fold(ASTnode * n) {
+  ASTnode **chain;
+  int count, i;
 
   if (n == NULL)
     return (NULL);
 
-  // Fold on the left child, then
-  // do the same on the right child
-  n->left = fold(n->left);
-  n->right = fold(n->right);
+  // Fold each statement in a chain of statements.
+  // The A_GLUE nodes themselves don't change
+  if (n->op == A_GLUE && n->is_short_assign == false) {
+    chain = ast_chain(n, &count);
+    chain[count - 1]->left = fold(chain[count - 1]->left);
+    for (i = count - 1; i >= 0; i--)
+      chain[i]->right = fold(chain[i]->right);
+    free(chain);
+    return (n);
+  }
 
-  // If both children are integer NUMLITS, do a fold2()
-  if (is_intlit(n->left)) {
-    if (is_intlit(n->right))
-      n = fold2(n);
-    else
-      // If only the left is an integer NUMLIT, do a fold1()
-      n = fold1(n);
+  // Likewise for a chain of declarations
+  if (n->op == A_LOCAL) {
+    chain = ast_chain(n, &count);
+    chain[count - 1]->mid = fold(chain[count - 1]->mid);
+    for (i = count - 1; i >= 0; i--) {
+      chain[i]->left = fold(chain[i]->left);
+      chain[i]->right = fold(chain[i]->right);
+    }
+    free(chain);
+    return (n);
   }
 
-  // Return the possibly modified tree
-  return (n);
+  // The values in a list were folded when parsed
+  if (n->op == A_BEL)
+    return (n);
+
+  // Fold the children, then this node
+  n->left = fold(n->left);
+  n->mid = fold(n->mid);
+  n->right = fold(n->right);
+  return (fold_node(n));
 }
 
 // Optimise an AST tree by
 // constant folding in all sub-trees
 ASTnode *optAST(ASTnode * n) {
+  int oldphase = time_phase(PH_OPTIMISE);
+
   n = fold(n);
+  time_phase(oldphase);
   return (n);
 }
+
+// Return the number of nodes in an AST tree
+int count_AST(ASTnode * n) {
+  ASTnode **chain, *next;
+  int count, total, i;
+
+  if (n == NULL)
+    return (0);
+
+  // Count the nodes in any chain, then
+  // the children which are not in the chain
+  chain = ast_chain(n, &count);
+  total = count;
+  for (i = 0; i < count; i++) {
+    next = (i < count - 1) ? chain[i + 1] : NULL;
+    if (chain[i]->left != next)
+      total += count_AST(chain[i]->left);
+    if (chain[i]->mid != next)
+      total += count_AST(chain[i]->mid);
+    if (chain[i]->right != next)
+      total += count_AST(chain[i]->right);
+  }
+  free(chain);
+  return (total);
+}
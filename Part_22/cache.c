@@ -0,0 +1,271 @@
+// Compilation cache for the alic compiler
+// (c) 2025 Warren Toomey, GPL3
+
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include "alic.h"
+#include "proto.h"
+
+// The output of each compilation is kept in the cache
+// directory. The file's name is a hash of the pre-processed
+// source code, the compiler binary, the CPU and the flags
+// which change the output, with the output's suffix.
+// The "stats" file holds the hit and miss counts.
+// When the cache grows beyond its size limit, the least
+// recently used files are removed until it is down to
+// nine tenths of the limit. The limit is CACHEMAXSIZE,
+// or ALIC_CACHESIZE kilobytes if that is set.
+#define CACHEMAXSIZE (512 * 1024 * 1024)
+
+// The CPU that we generate code for
+#if defined(CPU_aarch64)
+#define CACHECPU "aarch64"
+#elif defined(CPU_riscv64)
+#define CACHECPU "riscv64"
+#else
+#define CACHECPU "x86_64"
+#endif
+
+static char *Cachedir = NULL;
+static off_t Cachemax = CACHEMAXSIZE;
+
+// Use the given directory for the cache,
+// creating it if needed
+void cache_init(char *dir) {
+  char *size;
+
+  if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+    fprintf(stderr, "Unable to create cache directory %s: %s\n",
+	    dir, strerror(errno));
+    exit(1);
+  }
+  Cachedir = dir;
+
+  size = getenv("ALIC_CACHESIZE");
+  if (size != NULL && *size != '\0') {
+    Cachemax = (off_t) atol(size) * 1024;
+    if (Cachemax <= 0) {
+      fprintf(stderr, "Bad ALIC_CACHESIZE %s\n", size);
+      exit(1);
+    }
+  }
+}
+
+// Return true if the cache is in use
+bool cache_enabled(void) {
+  return (Cachedir != NULL);
+}
+
+// Add len bytes to a 128-bit FNV-1a hash
+static void fnv128(unsigned __int128 *hash, void *data, size_t len) {
+  const unsigned __int128 prime =
+    ((unsigned __int128) 1 << 88) + 0x13B;
+  uint8_t *s = data;
+
+  for (; len > 0; len--, s++) {
+    *hash ^= *s;
+    *hash *= prime;
+  }
+}
+
+// Given the pre-processed text of a file, return
+// the cache key for it as a string of hex digits
+char *cache_key(char *text, size_t len) {
+  unsigned __int128 hash;
+  char buf[TEXTLEN];
+  char key[33];
+
+  // The FNV-1a 128-bit offset basis
+  hash = ((unsigned __int128) 0x6c62272e07bb0142ULL << 64) +
+    0x62b821756295c58dULL;
+
+  fnv128(&hash, compiler_id(), strlen(compiler_id()) + 1);
+  snprintf(buf, sizeof(buf), "%s B%d", CACHECPU, O_boundscheck);
+  fnv128(&hash, buf, strlen(buf) + 1);
+  fnv128(&hash, text, len);
+
+  snprintf(key, sizeof(key), "%016llx%016llx",
+	   (unsigned long long) (hash >> 64), (unsigned long long) hash);
+  return (strdup(key));
+}
+
+// Copy one file to another. Return true if successful
+static bool copy_file(char *from, char *to) {
+  char buf[65536];
+  FILE *in, *out;
+  size_t n;
+  bool ok = true;
+
+  if ((in = fopen(from, "r")) == NULL)
+    return (false);
+  if ((out = fopen(to, "w")) == NULL) {
+    fclose(in);
+    return (false);
+  }
+
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    if (fwrite(buf, 1, n, out) != n)
+      ok = false;
+  if (ferror(in))
+    ok = false;
+  fclose(in);
+  if (fclose(out) != 0)
+    ok = false;
+  return (ok);
+}
+
+// Get the cached file's name for the key and suffix
+static void cache_name(char *buf, size_t size, char *key, char suffix) {
+  snprintf(buf, size, "%s/%s.%c", Cachedir, key, suffix);
+}
+
+// Add one to the hit or miss count in the stats file.
+// The file is locked as other compilers may be using it
+void cache_count(bool hit) {
+  char name[TEXTLEN];
+  long hits = 0, misses = 0;
+  FILE *fh;
+  int fd;
+
+  snprintf(name, sizeof(name), "%s/stats", Cachedir);
+  if ((fd = open(name, O_RDWR | O_CREAT, 0644)) == -1)
+    return;
+  flock(fd, LOCK_EX);
+
+  if ((fh = fdopen(fd, "r+")) == NULL) {
+    close(fd);
+    return;
+  }
+  if (fscanf(fh, "%ld hits %ld misses", &hits, &misses) != 2)
+    hits = misses = 0;
+  if (hit)
+    hits++;
+  else
+    misses++;
+
+  rewind(fh);
+  fprintf(fh, "%ld hits %ld misses\n", hits, misses);
+  fclose(fh);
+}
+
+// Print out the hit and miss counts
+void cache_stats(FILE * fh) {
+  char name[TEXTLEN];
+  long hits = 0, misses = 0;
+  FILE *in;
+
+  snprintf(name, sizeof(name), "%s/stats", Cachedir);
+  if ((in = fopen(name, "r")) != NULL) {
+    if (fscanf(in, "%ld hits %ld misses", &hits, &misses) != 2)
+      hits = misses = 0;
+    fclose(in);
+  }
+  fprintf(fh, "cache: %ld hits, %ld misses\n", hits, misses);
+}
+
+// If the key's file with the given suffix is in
+// the cache, copy it to outfile and return true
+bool cache_fetch(char *key, char suffix, char *outfile) {
+  char name[TEXTLEN];
+  bool found;
+
+  cache_name(name, sizeof(name), key, suffix);
+  found = copy_file(name, outfile);
+
+  // Mark the file as recently used
+  if (found)
+    utime(name, NULL);
+  else
+    unlink(outfile);
+  return (found);
+}
+
+// A file in the cache directory and its details
+typedef struct Cachefile Cachefile;
+struct Cachefile {
+  char *name;
+  struct timespec mtime;
+  off_t size;
+};
+
+// Sort cache files by last use, oldest first
+static int cmp_cachefile(const void *a, const void *b) {
+  const Cachefile *x = a, *y = b;
+
+  if (x->mtime.tv_sec != y->mtime.tv_sec)
+    return (x->mtime.tv_sec < y->mtime.tv_sec) ? -1 : 1;
+  if (x->mtime.tv_nsec != y->mtime.tv_nsec)
+    return (x->mtime.tv_nsec < y->mtime.tv_nsec) ? -1 : 1;
+  return (strcmp(x->name, y->name));
+}
+
+// If the cache is too big, remove the
+// least recently used files from it
+static void cache_trim(void) {
+  Cachefile *list = NULL;
+  int cnt = 0, size = 0, i;
+  off_t total = 0;
+  char name[TEXTLEN];
+  struct dirent *d;
+  struct stat sb;
+  DIR *dir;
+
+  if ((dir = opendir(Cachedir)) == NULL)
+    return;
+
+  // Get the details of all the cached files
+  while ((d = readdir(dir)) != NULL) {
+    if (d->d_name[0] == '.' || !strcmp(d->d_name, "stats"))
+      continue;
+    snprintf(name, sizeof(name), "%s/%s", Cachedir, d->d_name);
+    if (stat(name, &sb) == -1)
+      continue;
+
+    if (cnt == size) {
+      size = (size == 0) ? 256 : size * 2;
+      list = (Cachefile *) realloc(list, size * sizeof(Cachefile));
+      if (list == NULL)
+	fatal("Malloc failure\n");
+    }
+    list[cnt].name = strdup(name);
+    list[cnt].mtime = sb.st_mtim;
+    list[cnt].size = sb.st_size;
+    total += sb.st_size;
+    cnt++;
+  }
+  closedir(dir);
+
+  // Remove the oldest files until the cache is small enough
+  if (total > Cachemax) {
+    qsort(list, cnt, sizeof(Cachefile), cmp_cachefile);
+    for (i = 0; i < cnt && total > Cachemax / 10 * 9; i++) {
+      unlink(list[i].name);
+      total -= list[i].size;
+    }
+  }
+
+  for (i = 0; i < cnt; i++)
+    free(list[i].name);
+  free(list);
+}
+
+// Put a copy of the file into the cache
+// with the given key and suffix
+void cache_store(char *key, char suffix, char *file) {
+  char name[TEXTLEN], tmpname[TEXTLEN + 32];
+
+  // Copy to a temporary name and rename it, so that another
+  // compiler or thread never sees a partly-written file
+  cache_name(name, sizeof(name), key, suffix);
+  snprintf(tmpname, sizeof(tmpname), "%s.%d.%lx", name, (int) getpid(),
+	   (unsigned long) pthread_self());
+  if (copy_file(file, tmpname) && rename(tmpname, name) == 0)
+    cache_trim();
+  else
+    unlink(tmpname);
+}
@@ -6,16 +6,27 @@
 #include "alic.h"
 #include "proto.h"
 
-static int nexttemp = 1;	// Incrementing temporary number
-
 // Allocate a QBE temporary
 int cgalloctemp(void) {
-  return (++nexttemp);
+  return (++State.nexttemp);
+}
+
+// Return the number of temporaries allocated so far
+int cgnumtemps(void) {
+  return (State.nexttemp);
+}
+
+// Return the name of a symbol in the QBE code.
+// With -U, note each use of a function's name
+static char *qbename(Sym * sym) {
+  if (sym->symtype == ST_FUNCTION)
+    note_funcref(sym);
+  return ((sym->qbename != NULL) ? sym->qbename : sym->name);
 }
 
 // Generate a label
 void cglabel(int l) {
-  fprintf(Outfh, "@L%d\n", l);
+  emitf("@L%d\n", l);
 }
 
 // Generate a string literal
@@ -24,20 +35,24 @@ void cgstrlit(int label, char *val, bool is_const) {
 
   // Put constant string literals in the rodata section
   if (is_const)
-    fprintf(Outfh, "section \".rodata\"\n");
+    emitf("section \".rodata\"\n");
 
-  fprintf(Outfh, "data $L%d = { ", label);
+  emitstr("data $L");
+  emitint(label);
+  emitstr(" = { ");
 
   for (cptr = val; *cptr; cptr++) {
-    fprintf(Outfh, "b %d, ", *cptr);
+    emitstr("b ");
+    emitint(*cptr);
+    emitstr(", ");
   }
 
-  fprintf(Outfh,  "b 0 }\n");
+  emitstr("b 0 }\n");
 }
 
 // Generate a jump to a label
 void cgjump(int l) {
-  fprintf(Outfh, "  jmp @L%d\n", l);
+  emitf("  jmp @L%d\n", l);
 }
 
 // Table of QBE type names used
@@ -165,104 +180,100 @@ int cgalign(Type * ty, int offset) {
   return (offset);
 }
 
-// Print out the file preamble
+// Print out the file preamble. The temporaries
+// in each output file are numbered from the start
 void cg_file_preamble(void) {
+  State.nexttemp = 1;
+
   // Output a copy of the function that emits
   // an error message and exit()s
 #ifdef CPU_aarch64
-  fputs("type :va_list.1 = align 8 { 32 }\n", Outfh);
+  emitstr("type :va_list.1 = align 8 { 32 }\n");
 #endif
-  fputs("function $.fatal(l %.t1, ...) {\n", Outfh);
-  fputs("@L1\n", Outfh);
+  emitstr("function $.fatal(l %.t1, ...) {\n");
+  emitstr("@L1\n");
 #ifdef CPU_x86_64
-  fputs("  %.t2 =l alloc8 24\n", Outfh);
-  fputs("  vastart %.t2\n", Outfh);
-  fputs("  %.t3 =l loadl $stderr\n", Outfh);
-  fputs("  call $vfprintf(l %.t3, l %.t1, l %.t2)\n", Outfh);
+  emitstr("  %.t2 =l alloc8 24\n");
+  emitstr("  vastart %.t2\n");
+  emitstr("  %.t3 =l loadl $stderr\n");
+  emitstr("  call $vfprintf(l %.t3, l %.t1, l %.t2)\n");
 #endif
 #ifdef CPU_riscv64
-  fputs("  %.t2 =l alloc8 32\n", Outfh);
-  fputs("  vastart %.t2\n", Outfh);
-  fputs("  %.t6 =l loadl %.t2\n", Outfh);
-  fputs("  %.t3 =l loadl $stderr\n", Outfh);
-  fputs("  call $vfprintf(l %.t3, l %.t1, l %.t6)\n", Outfh);
+  emitstr("  %.t2 =l alloc8 32\n");
+  emitstr("  vastart %.t2\n");
+  emitstr("  %.t6 =l loadl %.t2\n");
+  emitstr("  %.t3 =l loadl $stderr\n");
+  emitstr("  call $vfprintf(l %.t3, l %.t1, l %.t6)\n");
 #endif
 #ifdef CPU_aarch64
-  fputs("  %.t3 =l alloc8 32\n", Outfh);
-  fputs("  vastart %.t3\n", Outfh);
-  fputs("  %.t4 =l loadl $stderr\n", Outfh);
-  fputs("  %.t6 =w call $vfprintf(l %.t4, l %.t1, :va_list.1 %.t3)\n", Outfh);
+  emitstr("  %.t3 =l alloc8 32\n");
+  emitstr("  vastart %.t3\n");
+  emitstr("  %.t4 =l loadl $stderr\n");
+  emitstr("  %.t6 =w call $vfprintf(l %.t4, l %.t1, :va_list.1 %.t3)\n");
 #endif
-  fputs("  call $exit(w 1)\n", Outfh);
-  fputs("  ret \n", Outfh);
-  fputs("}\n\n", Outfh);
+  emitstr("  call $exit(w 1)\n");
+  emitstr("  ret \n");
+  emitstr("}\n\n");
 
-  fputs("data $.bounderr = { b \"%s[%d] out of bounds in %s()\\n\", b 0 }\n\n", Outfh);
-  fputs("data $.casterr = { b \"cast() expression out of range in %s()\\n\", b 0 }\n\n", Outfh);
-  fputs("data $.rangeerr = { b \"expression out of range for type in %s()\\n\", b 0 }\n\n", Outfh);
-  fputs("data $.stridxerr = { b \"string index out of range in %s()\\n\", b 0 }\n\n", Outfh);
+  emitstr("data $.bounderr = { b \"%s[%d] out of bounds in %s()\\n\", b 0 }\n\n");
+  emitstr("data $.casterr = { b \"cast() expression out of range in %s()\\n\", b 0 }\n\n");
+  emitstr("data $.rangeerr = { b \"expression out of range for type in %s()\\n\", b 0 }\n\n");
+  emitstr("data $.stridxerr = { b \"string index out of range in %s()\\n\", b 0 }\n\n");
 }
 
-// Temporary which holds the vastart argument list
-static int va_ptr;
-
 // Print out the function preamble
 void cg_func_preamble(Sym * func) {
   Sym *this;
   char *qtype;
 
   // No va_ptr as yet
-  va_ptr= NOTEMP;
+  State.va_ptr= NOTEMP;
 
   // Get the function's return type
   qtype = qbetype(func->type);
 
   if (func->visibility == SV_PUBLIC)
-    fprintf(Outfh, "export ");
-  fprintf(Outfh, "function %s $%s(", qtype, func->name);
+    emitf("export ");
+  emitf("function %s $%s(", qtype, qbename(func));
 
   // If we have an exception variable, output it
   if (func->exceptvar != NULL) {
-    fprintf(Outfh, "l %%%s", func->exceptvar->name);
+    emitf("l %%%s", func->exceptvar->name);
     if (func->paramlist != NULL)
-      fprintf(Outfh, ", ");
+      emitf(", ");
   }
 
   // Output the list of parameters
   for (this = func->paramlist; this != NULL; this = this->next) {
     // Get the parameter's type
     qtype = qbetype(this->type);
-    fprintf(Outfh, "%s %%%s", qtype, this->name);
+    emitf("%s %%%s", qtype, this->name);
 
     // Print out any comma separator
     if (this->next != NULL)
-      fprintf(Outfh, ", ");
+      emitf(", ");
   }
 
   // Print ... if the function is variadic
   if (func->is_variadic == true)
-    fprintf(Outfh, ", ...");
+    emitf(", ...");
 
-  fprintf(Outfh, ") {\n");
-  fprintf(Outfh, "@START\n");
+  emitf(") {\n");
+  emitf("@START\n");
 }
 
 // Print out the function postamble
 void cg_func_postamble(Type * type) {
-  fprintf(Outfh, "@END\n");
+  emitf("@END\n");
 
   // Return a value if the function's type isn't void
   if (type != ty_void)
-    fprintf(Outfh, "  ret %%.ret\n");
+    emitf("  ret %%.ret\n");
   else
-    fprintf(Outfh, "  ret\n");
-  fprintf(Outfh, "}\n\n");
+    emitf("  ret\n");
+  emitf("}\n\n");
 }
 
-// Used when outputting storage
-// for global structs
-static int globoffset;
-
 // Start a global symbol.
 void cgglobsym(Sym * sym, bool make_zero) {
   int align;
@@ -270,7 +281,7 @@ void cgglobsym(Sym * sym, bool make_zero) {
   Type *type = sym->type;
   int size;
 
-  globoffset = 0;
+  State.globoffset = 0;
 
   size= type->size;
 
@@ -284,12 +295,12 @@ void cgglobsym(Sym * sym, bool make_zero) {
 
   // Put constant symbols in the rodata section
   if (sym->is_const)
-    fprintf(Outfh, "section \".rodata\"\n");
+    emitf("section \".rodata\"\n");
 
   // Export the variable if public.
   // Private variables are not exported
   if (sym->visibility == SV_PUBLIC)
-    fprintf(Outfh, "export ");
+    emitf("export ");
 
 
   // If the data is 8 bytes or more,
@@ -304,11 +315,11 @@ void cgglobsym(Sym * sym, bool make_zero) {
     align = power;
   }
 
-  fprintf(Outfh, "data $%s = align %d { ", sym->name, align);
+  emitf("data $%s = align %d { ", qbename(sym), align);
 
   if (make_zero == true) {
     size= get_varsize(sym);
-    fprintf(Outfh, "z %d", size);
+    emitf("z %d", size);
   }
 }
 
@@ -319,25 +330,25 @@ void cgglobsymval(ASTnode * value, int offset) {
 
   // If the offset is bigger than the current offset,
   // output some zero padding
-  if (offset > globoffset) {
-    fprintf(Outfh, "z %d, ", offset - globoffset);
-    globoffset = offset;
+  if (offset > State.globoffset) {
+    emitf("z %d, ", offset - State.globoffset);
+    State.globoffset = offset;
   }
 
   qtype = qbe_storetype(value->type);
 
   // Update the globoffset to match the
   // amount of data we will output
-  globoffset = globoffset + value->type->size;
+  State.globoffset = State.globoffset + value->type->size;
 
   // No initial value, use 0
   if (value == NULL) {
     if (value->type->kind == TY_STRUCT)
-      fprintf(Outfh, "z %d, ", value->type->size);
+      emitf("z %d, ", value->type->size);
     else if (is_flonum(value->type))
-      fprintf(Outfh, "%s s_0.0, ", qtype);
+      emitf("%s s_0.0, ", qtype);
     else
-      fprintf(Outfh, "%s 0, ", qtype);
+      emitf("%s 0, ", qtype);
 
     return;
   }
@@ -345,23 +356,23 @@ void cgglobsymval(ASTnode * value, int offset) {
   // We have a value
   if (value->op == A_STRLIT) {
     label= add_strlit(value->strlit, value->is_const);
-    fprintf(Outfh, "%s $L%d, ", qtype, label);
+    emitf("%s $L%d, ", qtype, label);
   } else if (is_flonum(value->type))
-    fprintf(Outfh, "%s s_%f, ", qtype, value->litval.dblval);
+    emitf("%s s_%f, ", qtype, value->litval.dblval);
   else
-    fprintf(Outfh, "%s %ld, ", qtype, value->litval.intval);
+    emitf("%s %ld, ", qtype, value->litval.intval);
 }
 
 // End a global symbol
 void cgglobsymend(Sym * sym) {
-  fprintf(Outfh, " }\n");
+  emitf(" }\n");
 }
 
 // Load a boolean value (only 0 or 1)
 // into the given temporary
 void cgloadboolean(int t, int val, Type * type) {
   char *qtype = qbetype(type);
-  fprintf(Outfh, "  %%.t%d =%s copy %d\n", t, qtype, val);
+  emitf("  %%.t%d =%s copy %d\n", t, qtype, val);
 }
 
 // Load an integer literal value into a temporary.
@@ -372,7 +383,7 @@ int cgloadlit(Litval * value, Type * type) {
 
   // Deal with pointers
   if (is_pointer(type)) {
-    fprintf(Outfh, "  %%.t%d =l copy %ld\n", t, value->intval);
+    emitf("  %%.t%d =l copy %ld\n", t, value->intval);
     return (t);
   }
 
@@ -382,11 +393,11 @@ int cgloadlit(Litval * value, Type * type) {
   switch (type->kind) {
   case TY_FLT32:
   case TY_FLT64:
-    fprintf(Outfh, "  %%.t%d =%s copy %s_%f\n", t, qtype, qtype,
+    emitf("  %%.t%d =%s copy %s_%f\n", t, qtype, qtype,
 	    value->dblval);
     break;
   default:
-    fprintf(Outfh, "  %%.t%d =%s copy %ld\n", t, qtype, value->intval);
+    emitf("  %%.t%d =%s copy %ld\n", t, qtype, value->intval);
   }
 
   return (t);
@@ -398,7 +409,7 @@ static int cgbinop(int t1, int t2, char *op, Type * type) {
   // Get the matching QBE type
   char *qtype = qbetype(type);
 
-  fprintf(Outfh, "  %%.t%d =%s %s %%.t%d, %%.t%d\n", t1, qtype, op, t1, t2);
+  emitf("  %%.t%d =%s %s %%.t%d, %%.t%d\n", t1, qtype, op, t1, t2);
   return (t1);
 }
 
@@ -423,18 +434,214 @@ int cgmul(int t1, int t2, Type * type) {
 // Divide the first temporary by the second and
 // return the number of the temporary with the result
 int cgdiv(int t1, int t2, Type * type) {
-  return (cgbinop(t1, t2, "div", type));
+  return (cgbinop(t1, t2, (type->is_unsigned) ? "udiv" : "div", type));
 }
 
 // Get the modulo of the first temporary by the second and
 // return the number of the temporary with the result
 int cgmod(int t1, int t2, Type * type) {
-  return (cgbinop(t1, t2, "rem", type));
+  return (cgbinop(t1, t2, (type->is_unsigned) ? "urem" : "rem", type));
+}
+
+// Return the log base 2 of val if it
+// is a power of two, or -1 if not
+static int exact_log2(uint64_t val) {
+  int i;
+
+  if (val == 0 || (val & (val - 1)) != 0)
+    return (-1);
+  for (i = 0; val != 1; i++)
+    val >>= 1;
+  return (i);
+}
+
+// Return the smallest l where 2**l >= val
+static int ceil_log2(uint64_t val) {
+  int l;
+
+  for (l = 0; l < 64 && ((uint64_t) 1 << l) < val; l++);
+  return (l);
+}
+
+// Do a binary operation on a temporary and a constant
+// value, with the result in t. Return t
+static int cgbinconst(int t, char *op, int64_t val, Type * type) {
+  char *qtype = qbetype(type);
+
+  emitf("  %%.t%d =%s %s %%.t%d, %ld\n", t, qtype, op, t, val);
+  return (t);
+}
+
+// Multiply a temporary by a constant value and return
+// the number of the temporary with the result.
+// Use a shift if the value is a power of two
+int cgmulconst(int t, int64_t val, Type * type) {
+  int shift = exact_log2(val);
+
+  if (shift == 0)
+    return (t);
+  if (shift > 0)
+    return (cgbinconst(t, "shl", shift, type));
+  return (cgbinconst(t, "mul", val, type));
+}
+
+// Given the quotient q of t divided by val,
+// put t modulo val in t and return t
+static int cgremainder(int t, int q, int64_t val, Type * type) {
+  char *qtype = qbetype(type);
+
+  cgbinconst(q, "mul", val, type);
+  emitf("  %%.t%d =%s sub %%.t%d, %%.t%d\n", t, qtype, t, q);
+  return (t);
+}
+
+// Divide an unsigned temporary by a constant value, or
+// get the modulo if is_mod. Return the temporary with
+// the result, or NOTEMP if we need a div instruction
+static int cgudivconst(int t, uint64_t val, Type * type, bool is_mod) {
+  char *qtype = qbetype(type);
+  int k = exact_log2(val);
+  int l, shift, q, q2;
+  uint64_t m;
+
+  // Powers of two are a shift or a mask
+  if (k == 0)
+    return ((is_mod) ? cgbinconst(t, "and", 0, type) : t);
+  if (k > 0)
+    return ((is_mod) ? cgbinconst(t, "and", val - 1, type) :
+	    cgbinconst(t, "shr", k, type));
+
+  // Otherwise we can only do 32-bit values. We multiply
+  // by m, about 2**(32+shift)/val, in 64 bits and keep
+  // the top bits. Try for an m below 2**32 first
+  if (qtype[0] != 'w' || val >= ((uint64_t) 1 << 31))
+    return (NOTEMP);
+  l = ceil_log2(val);
+  shift = l - 1;
+  m = (((uint64_t) 1 << (32 + shift)) / val) + 1;
+  if (m * val - ((uint64_t) 1 << (32 + shift)) > ((uint64_t) 1 << shift)) {
+    shift = l;
+    m = (((uint64_t) 1 << (32 + shift)) / val) + 1;
+  }
+
+  q = cgalloctemp();
+  emitf("  %%.t%d =l extuw %%.t%d\n", q, t);
+  if (m < ((uint64_t) 1 << 32)) {
+    emitf("  %%.t%d =l mul %%.t%d, %ld\n", q, q, m);
+    emitf("  %%.t%d =l shr %%.t%d, %d\n", q, q, 32 + shift);
+  } else {
+    // m has 33 bits: multiply by the low 32 bits
+    // and add the value back in for the top bit
+    q2 = cgalloctemp();
+    emitf("  %%.t%d =l mul %%.t%d, %ld\n", q2, q, m - ((uint64_t) 1 << 32));
+    emitf("  %%.t%d =l shr %%.t%d, 32\n", q2, q2);
+    emitf("  %%.t%d =l add %%.t%d, %%.t%d\n", q, q, q2);
+    emitf("  %%.t%d =l shr %%.t%d, %d\n", q, q, shift);
+  }
+  q2 = cgalloctemp();
+  emitf("  %%.t%d =w copy %%.t%d\n", q2, q);
+
+  if (is_mod)
+    return (cgremainder(t, q2, val, type));
+  return (q2);
+}
+
+// Divide a signed temporary by a constant value, or
+// get the modulo if is_mod. Return the temporary with
+// the result, or NOTEMP if we need a div instruction
+static int cgsdivconst(int t, int64_t val, Type * type, bool is_mod) {
+  char *qtype = qbetype(type);
+  int bits = (qtype[0] == 'w') ? 32 : 64;
+  uint64_t d = (val < 0) ? -(uint64_t) val : val;
+  int k = exact_log2(d);
+  int l, q, q2;
+  uint64_t m;
+
+  if (val == 1 || val == -1) {
+    if (is_mod)
+      return (cgbinconst(t, "and", 0, type));
+    return ((val == 1) ? t : cgnegate(t, type));
+  }
+
+  // For powers of two, round towards zero by adding
+  // 2**k - 1 to negative values before the shift
+  if (k > 0) {
+    if (k >= bits)
+      return (NOTEMP);
+    q = cgalloctemp();
+    emitf("  %%.t%d =%s sar %%.t%d, %d\n", q, qtype, t, bits - 1);
+    cgbinconst(q, "shr", bits - k, type);
+    emitf("  %%.t%d =%s add %%.t%d, %%.t%d\n", q, qtype, q, t);
+    if (is_mod) {
+      cgbinconst(q, "and", -(int64_t) d, type);
+      emitf("  %%.t%d =%s sub %%.t%d, %%.t%d\n", t, qtype, t, q);
+      return (t);
+    }
+    cgbinconst(q, "sar", k, type);
+    return ((val < 0) ? cgnegate(q, type) : q);
+  }
+
+  // Otherwise we can only do 32-bit values. Multiply by
+  // m, just above 2**(31+l)/d, in 64 bits and keep the
+  // top bits. This rounds down, so add one if negative
+  if (bits != 32 || d >= ((uint64_t) 1 << 31))
+    return (NOTEMP);
+  l = ceil_log2(d);
+  m = (((uint64_t) 1 << (31 + l)) / d) + 1;
+
+  q = cgalloctemp();
+  emitf("  %%.t%d =l extsw %%.t%d\n", q, t);
+  emitf("  %%.t%d =l mul %%.t%d, %ld\n", q, q, m);
+  emitf("  %%.t%d =l sar %%.t%d, %d\n", q, q, 31 + l);
+  q2 = cgalloctemp();
+  emitf("  %%.t%d =w shr %%.t%d, 31\n", q2, t);
+  emitf("  %%.t%d =w add %%.t%d, %%.t%d\n", q2, q2, q);
+  if (val < 0)
+    cgnegate(q2, type);
+
+  if (is_mod)
+    return (cgremainder(t, q2, val, type));
+  return (q2);
+}
+
+// Divide a temporary by a constant value, or get the
+// modulo if is_mod, using shifts or a multiply where
+// we can. Return the number of the temporary with the result
+static int cgdivmodconst(int t, int64_t val, Type * type, bool is_mod) {
+  Litval lit;
+  int result = NOTEMP;
+
+  // Division by zero is left to the div instruction
+  if (val != 0) {
+    if (type->is_unsigned)
+      result = cgudivconst(t, val, type, is_mod);
+    else
+      result = cgsdivconst(t, val, type, is_mod);
+  }
+  if (result != NOTEMP)
+    return (result);
+
+  lit.intval = val;
+  if (is_mod)
+    return (cgmod(t, cgloadlit(&lit, type), type));
+  return (cgdiv(t, cgloadlit(&lit, type), type));
+}
+
+// Divide a temporary by a constant value and return
+// the number of the temporary with the result
+int cgdivconst(int t, int64_t val, Type * type) {
+  return (cgdivmodconst(t, val, type, false));
+}
+
+// Get the modulo of a temporary by a constant value and
+// return the number of the temporary with the result
+int cgmodconst(int t, int64_t val, Type * type) {
+  return (cgdivmodconst(t, val, type, true));
 }
 
 // Negate a temporary's value
 int cgnegate(int t, Type * type) {
-  fprintf(Outfh, "  %%.t%d =%s sub 0, %%.t%d\n", t, qbetype(type), t);
+  emitf("  %%.t%d =%s sub 0, %%.t%d\n", t, qbetype(type), t);
   return (t);
 }
 
@@ -460,7 +667,7 @@ int cgcompare(int op, int t1, int t2, Type * type) {
   // Get a new temporary
   int t = cgalloctemp();
 
-  fprintf(Outfh, "  %%.t%d =w c%s%s %%.t%d, %%.t%d\n",
+  emitf("  %%.t%d =w c%s%s %%.t%d, %%.t%d\n",
 	  t, cmpstr, qtype, t1, t2);
   return (t);
 }
@@ -470,7 +677,7 @@ void cgjump_if_false(int t1, int label) {
   // Get a label for the next instruction
   int label2 = genlabel();
 
-  fprintf(Outfh, "  jnz %%.t%d, @L%d, @L%d\n", t1, label2, label);
+  emitf("  jnz %%.t%d, @L%d, @L%d\n", t1, label2, label);
   cglabel(label2);
 }
 
@@ -479,13 +686,13 @@ int cgnot(int t, Type * type) {
   // Get the matching QBE type
   char *qtype = qbetype(type);
 
-  fprintf(Outfh, "  %%.t%d =%s ceq%s %%.t%d, 0\n", t, qtype, qtype, t);
+  emitf("  %%.t%d =%s ceq%s %%.t%d, 0\n", t, qtype, qtype, t);
   return (t);
 }
 
 // Invert a temporary's value
 int cginvert(int t, Type * type) {
-  fprintf(Outfh, "  %%.t%d =%s xor %%.t%d, -1\n", t, qbetype(type), t);
+  emitf("  %%.t%d =%s xor %%.t%d, -1\n", t, qbetype(type), t);
   return (t);
 }
 
@@ -528,22 +735,22 @@ int cgloadvar(Sym * sym) {
 
   // If it's an associative array, get the pointer
   if (sym->keytype != NULL) {
-    fprintf(Outfh, "  %%.t%d =l copy %c%s\n", t, qbeprefix, sym->name);
+    emitf("  %%.t%d =l copy %c%s\n", t, qbeprefix, qbename(sym));
     return(t);
   }
 
   // If it's a function, just copy it
   if (sym->symtype == ST_FUNCTION) {
-    fprintf(Outfh, "  %%.t%d =l copy $%s\n", t, sym->name);
+    emitf("  %%.t%d =l copy $%s\n", t, qbename(sym));
     return(t);
   }
 
   // If it's a function pointer, copy or load it
   if (sym->type->kind == TY_FUNCPTR) {
     if (sym->has_addr==true)
-      fprintf(Outfh, "  %%.t%d =l load %c%s\n", t, qbeprefix, sym->name);
+      emitf("  %%.t%d =l load %c%s\n", t, qbeprefix, qbename(sym));
     else
-      fprintf(Outfh, "  %%.t%d =l copy %c%s\n", t, qbeprefix, sym->name);
+      emitf("  %%.t%d =l copy %c%s\n", t, qbeprefix, qbename(sym));
     return(t);
   }
 
@@ -553,11 +760,11 @@ int cgloadvar(Sym * sym) {
 
   // If it has an address and isn't an array
   if ((sym->has_addr) && !is_array(sym))
-    fprintf(Outfh, "  %%.t%d =%s load%s %c%s\n",
-	    t, qtype, qloadtype, qbeprefix, sym->name);
+    emitf("  %%.t%d =%s load%s %c%s\n",
+	    t, qtype, qloadtype, qbeprefix, qbename(sym));
   else
-    fprintf(Outfh, "  %%.t%d =%s copy %c%s\n",
-	    t, qtype, qbeprefix, sym->name);
+    emitf("  %%.t%d =%s copy %c%s\n",
+	    t, qtype, qbeprefix, qbename(sym));
 
   return (t);
 }
@@ -573,19 +780,19 @@ void cgrangecheck(int t, Type *ty, int funcname) {
   int Lfail = genlabel();
 
   // Check t's value against the minimum
-  fprintf(Outfh, "  %%.t%d =%s copy %ld\n", t1, qtype, ty->lower);
+  emitf("  %%.t%d =%s copy %ld\n", t1, qtype, ty->lower);
   t2 = cgcompare(A_GE, t, t1, ty);
   cgjump_if_false(t2, Lfail);
 
   // Check t's value against the maximum
-  fprintf(Outfh, "  %%.t%d =%s copy %ld\n", t1, qtype, ty->upper);
+  emitf("  %%.t%d =%s copy %ld\n", t1, qtype, ty->upper);
   t2 = cgcompare(A_LE, t, t1, ty);
   cgjump_if_false(t2, Lfail);
   cgjump(Lgood);
 
   // Output the call to .fatal() if the range checks fail
   cglabel(Lfail);
-  fprintf(Outfh, "  call $.fatal(l $.rangeerr, l $L%d)\n", funcname);
+  emitf("  call $.fatal(l $.rangeerr, l $L%d)\n", funcname);
   cglabel(Lgood);
 }
 
@@ -602,11 +809,11 @@ int cgstorvar(int t, Type * exprtype, Sym * sym) {
   char *qtype = qbe_storetype(ty);
 
   if (sym->has_addr)
-    fprintf(Outfh, "  store%s %%.t%d, %c%s\n", qtype, t, qbeprefix,
-	    sym->name);
+    emitf("  store%s %%.t%d, %c%s\n", qtype, t, qbeprefix,
+	    qbename(sym));
   else
-    fprintf(Outfh, "  %c%s =%s copy %%.t%d\n",
-	    qbeprefix, sym->name, qtype, t);
+    emitf("  %c%s =%s copy %%.t%d\n",
+	    qbeprefix, qbename(sym), qtype, t);
 
   return (NOTEMP);
 }
@@ -617,7 +824,7 @@ int cgstore_element(int basetemp, int offset, int exprtemp, Type *ty) {
   int temp = cgalloctemp();
 
   // Add the base and the offset
-  fprintf(Outfh, "  %%.t%d =l add %%.t%d, %d\n", temp, basetemp, offset);
+  emitf("  %%.t%d =l add %%.t%d, %d\n", temp, basetemp, offset);
 
   // Store the expression value at that address
   return(cgstorderef(exprtemp, temp, ty));
@@ -633,8 +840,8 @@ void cgaddlocal(Type * type, Sym * sym, int size, bool makezero, bool isarray) {
   // If it's associative array, allocate room for a pointer
   // and construct the empty associative array
   if (sym->keytype != NULL) {
-    fprintf(Outfh, "  %%%s =l alloc8 8\n", name);
-    fprintf(Outfh, "  %%%s =l call $al_new_aarray()\n", name);
+    emitf("  %%%s =l alloc8 8\n", name);
+    emitf("  %%%s =l call $al_new_aarray()\n", name);
     return;
   }
 
@@ -642,7 +849,7 @@ void cgaddlocal(Type * type, Sym * sym, int size, bool makezero, bool isarray) {
   if (size < 8)
     align = 4;
 
-  fprintf(Outfh, "  %%%s =l alloc%d %d\n", sym->name, align, size);
+  emitf("  %%%s =l alloc%d %d\n", sym->name, align, size);
 
   // No need to zero the space
   if (makezero == false)
@@ -651,25 +858,25 @@ void cgaddlocal(Type * type, Sym * sym, int size, bool makezero, bool isarray) {
   // Yes, zero the space
   switch (size) {
   case 1:
-    fprintf(Outfh, "  %%.t%d =w copy 0\n", temp);
-    fprintf(Outfh, "  storeb %%.t%d, %%%s\n", temp, name);
+    emitf("  %%.t%d =w copy 0\n", temp);
+    emitf("  storeb %%.t%d, %%%s\n", temp, name);
     break;
   case 2:
-    fprintf(Outfh, "  %%.t%d =w copy 0\n", temp);
-    fprintf(Outfh, "  storeh %%.t%d, %%%s\n", temp, name);
+    emitf("  %%.t%d =w copy 0\n", temp);
+    emitf("  storeh %%.t%d, %%%s\n", temp, name);
     break;
   case 4:
-    fprintf(Outfh, "  %%.t%d =w copy 0\n", temp);
-    fprintf(Outfh, "  storew %%.t%d, %%%s\n", temp, name);
+    emitf("  %%.t%d =w copy 0\n", temp);
+    emitf("  storew %%.t%d, %%%s\n", temp, name);
     break;
   case 8:
-    fprintf(Outfh, "  %%.t%d =l copy 0\n", temp);
-    fprintf(Outfh, "  storel %%.t%d, %%%s\n", temp, name);
+    emitf("  %%.t%d =l copy 0\n", temp);
+    emitf("  storel %%.t%d, %%%s\n", temp, name);
     break;
   default:
-    fprintf(Outfh, "  %%.t%d =l copy 0\n", temp);
-    fprintf(Outfh, "  %%.t%d =l copy %d\n", t2, size);
-    fprintf(Outfh, "  call $memset(l %%%s, l %%.t%d, l %%.t%d)\n",
+    emitf("  %%.t%d =l copy 0\n", temp);
+    emitf("  %%.t%d =l copy %d\n", t2, size);
+    emitf("  call $memset(l %%%s, l %%.t%d, l %%.t%d)\n",
 	    name, temp, t2);
   }
 }
@@ -686,13 +893,13 @@ int cgcall(Sym * sym, int numargs, int excepttemp, int *arglist,
   if (sym->symtype == ST_FUNCTION) {
     // Call the function
     if (sym->type == ty_void)
-      fprintf(Outfh, "  call $%s(", sym->name);
+      emitf("  call $%s(", qbename(sym));
     else {
       // Get a new temporary for the return result
       rettemp = cgalloctemp();
 
-      fprintf(Outfh, "  %%.t%d =%s call $%s(",
-	    rettemp, qbetype(sym->type), sym->name);
+      emitf("  %%.t%d =%s call $%s(",
+	    rettemp, qbetype(sym->type), qbename(sym));
     }
   } else {
     // It's a function pointer. Get the pointer
@@ -701,12 +908,12 @@ int cgcall(Sym * sym, int numargs, int excepttemp, int *arglist,
 
     // Call the function pointer
     if (sym->type == ty_void)
-      fprintf(Outfh, "  call %%.t%d(", functemp);
+      emitf("  call %%.t%d(", functemp);
     else {
       // Get a new temporary for the return result
       rettemp = cgalloctemp();
 
-      fprintf(Outfh, "  %%.t%d =%s call %%.t%d(",
+      emitf("  %%.t%d =%s call %%.t%d(",
 	    rettemp, qbetype(sym->type), functemp);
     }
   }
@@ -714,26 +921,26 @@ int cgcall(Sym * sym, int numargs, int excepttemp, int *arglist,
   // If the function has an exception variable, output it
   // Use count as the id of the temporary holding its value
   if (sym->exceptvar != NULL) {
-    fprintf(Outfh, "l %%.t%d", excepttemp);
+    emitf("l %%.t%d", excepttemp);
     if (numargs != 0)
-      fprintf(Outfh, ", ");
+      emitf(", ");
   }
 
   // Output the list of arguments
   for (i = 0; i < numargs; i++) {
-    fprintf(Outfh, "%s %%.t%d", qbetype(typelist[i]), arglist[i]);
+    emitf("%s %%.t%d", qbetype(typelist[i]), arglist[i]);
 
     // If the function is variadic, QBE requires a '...'
     // after the last non-variadic argument
     if ((sym->is_variadic == true) && (i == sym->count -1))
-      fprintf(Outfh, ", ... ");
+      emitf(", ... ");
 
     // Output any separating comma
     if (i < numargs - 1)
-      fprintf(Outfh, ", ");
+      emitf(", ");
   }
 
-  fprintf(Outfh, ")\n");
+  emitf(")\n");
   return (rettemp);
 }
 
@@ -742,9 +949,9 @@ void cgreturn(int temp, Type * type) {
 
   // Only return a value if the function is not void
   if (type != ty_void)
-    fprintf(Outfh, "  %%.ret =%s copy %%.t%d\n", qbetype(type), temp);
+    emitf("  %%.ret =%s copy %%.t%d\n", qbetype(type), temp);
 
-  fprintf(Outfh, "  jmp @END\n");
+  emitf("  jmp @END\n");
 
   // QBE needs a label after a jump
   cglabel(genlabel());
@@ -754,7 +961,7 @@ void cgreturn(int temp, Type * type) {
 void cgabort(void) {
 
   // QBE needs a label after a jump
-  fprintf(Outfh, "  jmp @END\n");
+  emitf("  jmp @END\n");
   cglabel(genlabel());
 }
 
@@ -763,7 +970,7 @@ void cgabort(void) {
 int cgloadglobstr(int label) {
   // Get a new temporary
   int t = cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =l copy $L%d\n", t, label);
+  emitf("  %%.t%d =l copy $L%d\n", t, label);
   return (t);
 }
 
@@ -773,7 +980,7 @@ int cgaddress(Sym * sym) {
   int r = cgalloctemp();
   char qbeprefix = (sym->visibility == SV_LOCAL) ? '%' : '$';
 
-  fprintf(Outfh, "  %%.t%d =l copy %c%s\n", r, qbeprefix, sym->name);
+  emitf("  %%.t%d =l copy %c%s\n", r, qbeprefix, qbename(sym));
   return (r);
 }
 
@@ -788,7 +995,7 @@ int cgderef(int t, Type * ty) {
   // Get a temporary for the return result
   int ret = cgalloctemp();
 
-  fprintf(Outfh, "  %%.t%d =%s load%s %%.t%d\n", ret, qtype, qloadtype, t);
+  emitf("  %%.t%d =%s load%s %%.t%d\n", ret, qtype, qloadtype, t);
   return (ret);
 }
 
@@ -796,7 +1003,7 @@ int cgstorderef(int t1, int t2, Type * ty) {
   // Get the matching QBE type
   char *qtype = qbe_storetype(ty);
 
-  fprintf(Outfh, "  store%s %%.t%d, %%.t%d\n", qtype, t1, t2);
+  emitf("  store%s %%.t%d, %%.t%d\n", qtype, t1, t2);
   return (NOTEMP);
 }
 
@@ -815,7 +1022,7 @@ int cgboundscheck(int t1, int counttemp, int aryname, int funcname) {
   cgjump_if_false(comparetemp, Lfail);
 
   // Get zero into a temporary
-  fprintf(Outfh, "  %%.t%d =l copy 0\n", zerotemp);
+  emitf("  %%.t%d =l copy 0\n", zerotemp);
 
   // Compare against the index value
   // Jump if false to the failure label
@@ -826,7 +1033,7 @@ int cgboundscheck(int t1, int counttemp, int aryname, int funcname) {
 
   // Call the failure function
   cglabel(Lfail);
-  fprintf(Outfh, "  call $.fatal(l $.bounderr, l $L%d, l %%.t%d, l $L%d)\n",
+  emitf("  call $.fatal(l $.bounderr, l $L%d, l %%.t%d, l $L%d)\n",
 	  aryname, t1, funcname);
   cglabel(Lgood);
 
@@ -834,7 +1041,7 @@ int cgboundscheck(int t1, int counttemp, int aryname, int funcname) {
 }
 
 void cgmove(int t1, int t2, Type * ty) {
-  fprintf(Outfh, "  %%.t%d =%s copy %%.t%d\n", t2, qbetype(ty), t1);
+  emitf("  %%.t%d =%s copy %%.t%d\n", t2, qbetype(ty), t1);
 }
 
 // Allocate space for the variable argument list
@@ -844,23 +1051,23 @@ void cg_vastart(ASTnode *n) {
 #endif
 
   // It's already been done
-  if (va_ptr != NOTEMP)
+  if (State.va_ptr != NOTEMP)
     return;
 
-  va_ptr= cgalloctemp();
+  State.va_ptr= cgalloctemp();
 
   // Allocate the storage for the list
   // and get a pointer to it
-  fprintf(Outfh, "  %%.t%d =l alloc8 24\n", va_ptr);
-  fprintf(Outfh, "  vastart %%.t%d\n", va_ptr);
+  emitf("  %%.t%d =l alloc8 24\n", State.va_ptr);
+  emitf("  vastart %%.t%d\n", State.va_ptr);
 
   // Also save it in the program's pointer
 #ifdef CPU_riscv64
   temp= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =l loadl %%.t%d\n", temp, va_ptr);
+  emitf("  %%.t%d =l loadl %%.t%d\n", temp, State.va_ptr);
   cgstorvar(temp, n->type, n->sym);
 #else
-  cgstorvar(va_ptr, n->type, n->sym);
+  cgstorvar(State.va_ptr, n->type, n->sym);
 #endif
 }
 
@@ -873,10 +1080,10 @@ int cg_vaarg(ASTnode *n) {
   int t = cgalloctemp();
   char *qtype = qbetype(n->type);
 
-  if (va_ptr == NOTEMP)
+  if (State.va_ptr == NOTEMP)
     lfatal(n->line, "va_arg() with no preceding va_start()\n");
 
-  fprintf(Outfh, "  %%.t%d =%s vaarg %%.t%d\n", t, qtype, va_ptr);
+  emitf("  %%.t%d =%s vaarg %%.t%d\n", t, qtype, State.va_ptr);
   return(t);
 }
 
@@ -925,7 +1132,7 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
   char *qetype;
   char *qtype;
 
-  fprintf(Outfh, "# Casting %s to %s\n", get_typename(ety), get_typename(ty));
+  emitf("# Casting %s to %s\n", get_typename(ety), get_typename(ty));
 
   // If the two types are the same, return the temporary
   if (ety == ty)
@@ -933,13 +1140,13 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
 
   // flt64 to flt32
   if ((ety == ty_flt64) && (ty == ty_flt32)) {
-    fprintf(Outfh, "  %%.t%d =s truncd %%.t%d\n", t1, exprtemp);
+    emitf("  %%.t%d =s truncd %%.t%d\n", t1, exprtemp);
     return(t1);
   }
 
   // flt32 to flt64
   if ((ety == ty_flt32) && (ty == ty_flt64)) {
-    fprintf(Outfh, "  %%.t%d =d exts %%.t%d\n", t1, exprtemp);
+    emitf("  %%.t%d =d exts %%.t%d\n", t1, exprtemp);
     return(t1);
   }
 
@@ -950,7 +1157,7 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
   // int to float
   if (is_integer(ety) && is_flonum(ty)) {
     qetype= qbe_exttype(ety);
-    fprintf(Outfh, "  %%.t%d =%s %stof %%.t%d\n", t1, qtype, qetype, exprtemp);
+    emitf("  %%.t%d =%s %stof %%.t%d\n", t1, qtype, qetype, exprtemp);
     return (t1);
   }
 
@@ -961,21 +1168,21 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
     // float to (u)int64 is tricky as we can't do the bounds checks with 
     // int literals. So we do them with float literals instead.
     if (ty == ty_uint64) {
-      fprintf(Outfh, "  %%.t%d =%s copy %s_0.0\n", t1, qetype, qetype);
+      emitf("  %%.t%d =%s copy %s_0.0\n", t1, qetype, qetype);
       t2 = cgcompare(A_GE, exprtemp, t1, ety);
       cgjump_if_false(t2, Lfail);
-      fprintf(Outfh, "  %%.t%d =%s copy %s_18446744073709551615.0\n",
+      emitf("  %%.t%d =%s copy %s_18446744073709551615.0\n",
                                         t1, qetype, qetype);
       t2 = cgcompare(A_LE, exprtemp, t1, ety);
       cgjump_if_false(t2, Lfail);
     }
 
     if (ty == ty_int64) {
-      fprintf(Outfh, "  %%.t%d =%s copy %s_-9223372036854775808.0\n",
+      emitf("  %%.t%d =%s copy %s_-9223372036854775808.0\n",
                                         t1, qetype, qetype);
       t2 = cgcompare(A_GE, exprtemp, t1, ety);
       cgjump_if_false(t2, Lfail);
-      fprintf(Outfh, "  %%.t%d =%s copy %s_9223372036854775807.0\n",
+      emitf("  %%.t%d =%s copy %s_9223372036854775807.0\n",
                                         t1, qetype, qetype);
       t2 = cgcompare(A_LE, exprtemp, t1, ety);
       cgjump_if_false(t2, Lfail);
@@ -985,10 +1192,10 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
     // Get a new temp so it's QBE 'l' type
     t2 = cgalloctemp();
     if (ty->is_unsigned) {
-      fprintf(Outfh, "  %%.t%d =l %stoui %%.t%d\n", t2, qetype, exprtemp);
+      emitf("  %%.t%d =l %stoui %%.t%d\n", t2, qetype, exprtemp);
       ety= ty_uint64;
     } else {
-      fprintf(Outfh, "  %%.t%d =l %stosi %%.t%d\n", t2, qetype, exprtemp);
+      emitf("  %%.t%d =l %stosi %%.t%d\n", t2, qetype, exprtemp);
       ety= ty_int64;
     }
 
@@ -996,7 +1203,7 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
     qetype= "l";
     didjump= true; exprtemp= t2;
 
-// fprintf(Outfh, "# After flt conversion, ety is %s\n", get_typename(ety));
+// emitf("# After flt conversion, ety is %s\n", get_typename(ety));
 
     // If the destination is (u)int64 then jump to Lgood now
     if ((ty == ty_int64) || (ty == ty_uint64))
@@ -1024,11 +1231,11 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
   if (funcname == NOTEMP)
     mask= mask & C_NOCHECKMASK;
 
-// fprintf(Outfh, "# Int to int mask is 0x%x\n", mask);
+// emitf("# Int to int mask is 0x%x\n", mask);
 
   // Do a maximum check if needed
   if ((mask & C_X) != 0) {
-    fprintf(Outfh, "  %%.t%d =%s copy %ld\n", t1, qetype, max);
+    emitf("  %%.t%d =%s copy %ld\n", t1, qetype, max);
     t2 = cgcompare(A_LE, exprtemp, t1, ety);
     cgjump_if_false(t2, Lfail); didjump= true;
 
@@ -1038,7 +1245,7 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
 
   // Do a minimum check if needed
   if ((mask & C_M) != 0) {
-    fprintf(Outfh, "  %%.t%d =%s copy %ld\n", t1, qetype, min);
+    emitf("  %%.t%d =%s copy %ld\n", t1, qetype, min);
     t2 = cgcompare(A_GE, exprtemp, t1, ety);
     cgjump_if_false(t2, Lfail);
     cgjump(Lgood); didjump= true;
@@ -1047,7 +1254,7 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
   // Output the call to .fatal() if the above range tests failed
   if (didjump == true) {
     cglabel(Lfail);
-    fprintf(Outfh, "  call $.fatal(l $.casterr, l $L%d)\n", funcname);
+    emitf("  call $.fatal(l $.casterr, l $L%d)\n", funcname);
     cglabel(Lgood);
   }
 
@@ -1055,7 +1262,7 @@ int cgcast(int exprtemp, Type *ety, Type *ty, int funcname) {
   if ((mask & C_E) != 0) {
     qetype= qbe_exttype(ety);
     t2 = cgalloctemp();
-    fprintf(Outfh, "  %%.t%d =%s ext%s %%.t%d\n", t2, qtype, qetype, exprtemp);
+    emitf("  %%.t%d =%s ext%s %%.t%d\n", t2, qtype, qetype, exprtemp);
     exprtemp= t2;
   }
 
@@ -1068,12 +1275,12 @@ int cg_getaaval(int arytemp, int keytemp, Type *ty) {
   char *qtype = qbetype(ty);
 
   // Call the associative array lookup function
-  fprintf(Outfh, "  %%.t%d =l call $al_get_aavalue(l %%.t%d, l %%.t%d)\n",
+  emitf("  %%.t%d =l call $al_get_aavalue(l %%.t%d, l %%.t%d)\n",
 	t1, arytemp, keytemp);
 
   // If the type is smaller than 64 bits, narrow the result
   if (ty->size < 8) {
-    fprintf(Outfh, "  %%.t%d =%s copy %%.t%d\n", t2, qtype, t1);
+    emitf("  %%.t%d =%s copy %%.t%d\n", t2, qtype, t1);
     return(t2);
   } else
     return(t1);
@@ -1087,11 +1294,11 @@ void cg_setaaval(int arytemp, int keytemp, int valtemp, Type *ty) {
   if (ty->size < 8) {
     t = cgalloctemp();
     qtype = qbe_exttype(ty);
-    fprintf(Outfh, "  %%.t%d =l ext%s %%.t%d\n", t, qtype, valtemp);
+    emitf("  %%.t%d =l ext%s %%.t%d\n", t, qtype, valtemp);
   }
 
   // Call the associative array set function
-  fprintf(Outfh, "  call $al_add_aakeyval(l %%.t%d, l %%.t%d, l %%.t%d)\n",
+  emitf("  call $al_add_aakeyval(l %%.t%d, l %%.t%d, l %%.t%d)\n",
 	arytemp, keytemp, t);
 }
 
@@ -1099,7 +1306,7 @@ int cg_existsaaval(int arytemp, int keytemp) {
   int t = cgalloctemp();
 
   // Call the associative array lookup function
-  fprintf(Outfh, "  %%.t%d =w call $al_exists_aakey(l %%.t%d, l %%.t%d)\n",
+  emitf("  %%.t%d =w call $al_exists_aakey(l %%.t%d, l %%.t%d)\n",
 	t, arytemp, keytemp);
   return(t);
 }
@@ -1108,7 +1315,7 @@ int cg_delaaval(int arytemp, int keytemp) {
   int t = cgalloctemp();
 
   // Call the associative array lookup function
-  fprintf(Outfh, "  call $al_del_aakey(l %%.t%d, l %%.t%d)\n",
+  emitf("  call $al_del_aakey(l %%.t%d, l %%.t%d)\n",
 	arytemp, keytemp);
   return(t);
 }
@@ -1118,7 +1325,7 @@ int cg_delaaval(int arytemp, int keytemp) {
 int cg_strhash(int keytemp) {
   int t = cgalloctemp();
 
-  fprintf(Outfh, "  %%.t%d =l call $aa_djb2hash(l %%.t%d)\n",
+  emitf("  %%.t%d =l call $aa_djb2hash(l %%.t%d)\n",
 	t, keytemp);
   return(t);
 }
@@ -1127,14 +1334,14 @@ int cg_free_aarray(Sym * sym) {
   int arytemp;
 
   arytemp= cgloadvar(sym);
-  fprintf(Outfh, "  call $al_free_aarray(l %%.t%d)\n", arytemp);
+  emitf("  call $al_free_aarray(l %%.t%d)\n", arytemp);
   return(NOTEMP);
 }
 
 int cg_aaiterstart(int arytemp) {
   int t = cgalloctemp();
 
-  fprintf(Outfh, "  %%.t%d =l call $al_aa_iterstart(l %%.t%d)\n",
+  emitf("  %%.t%d =l call $al_aa_iterstart(l %%.t%d)\n",
 			t, arytemp);
   return(t);
 }
@@ -1142,7 +1349,7 @@ int cg_aaiterstart(int arytemp) {
 int cg_aanext(int arytemp) {
   int t = cgalloctemp();
 
-  fprintf(Outfh, "  %%.t%d =l call $al_getnext_aavalue(l %%.t%d)\n",
+  emitf("  %%.t%d =l call $al_getnext_aavalue(l %%.t%d)\n",
 			t, arytemp);
   return(t);
 }
@@ -1162,98 +1369,123 @@ int cg_funciterator(ASTnode * n, Breaklabel *this) {
 
   // Call the function and get the list pointer.
   // Copy the value to the element pointer
-  fprintf(Outfh, "# Start of a function iteration\n");
+  emitf("# Start of a function iteration\n");
   listptr= genAST(n->mid);
   elemptr= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =l copy %%.t%d\n", elemptr, listptr);
-  fprintf(Outfh, "# %%.t%d is listptr, %%.t%d is elemptr\n", listptr, elemptr);
+  emitf("  %%.t%d =l copy %%.t%d\n", elemptr, listptr);
+  emitf("# %%.t%d is listptr, %%.t%d is elemptr\n", listptr, elemptr);
 
   // Compare listptr against NULL and skip if it is
   zerotemp= cgalloctemp();
   t1= cgalloctemp();
   Lifend= genlabel();
-  fprintf(Outfh, "# Compare listptr against NULL and skip if it is\n");
-  fprintf(Outfh, "  %%.t%d =l copy 0\n", zerotemp);
-  fprintf(Outfh, "  %%.t%d =w cnel %%.t%d, %%.t%d\n", t1, listptr, zerotemp);
+  emitf("# Compare listptr against NULL and skip if it is\n");
+  emitf("  %%.t%d =l copy 0\n", zerotemp);
+  emitf("  %%.t%d =w cnel %%.t%d, %%.t%d\n", t1, listptr, zerotemp);
   cgjump_if_false(t1, Lifend);
 
   // Top of the foreach loop: is *element NULL?
-  fprintf(Outfh, "# Top of the foreach loop: is *element NULL?\n");
+  emitf("# Top of the foreach loop: is *element NULL?\n");
   Lfortop= genlabel(); cglabel(Lfortop);
   elemdref= cgalloctemp();
-  fprintf(Outfh, "# %%.t%d is elemdref\n", elemdref);
-  fprintf(Outfh, "  %%.t%d =l loadl %%.t%d\n", elemdref, elemptr);
+  emitf("# %%.t%d is elemdref\n", elemdref);
+  emitf("  %%.t%d =l loadl %%.t%d\n", elemdref, elemptr);
   t1= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =w cnel %%.t%d, %%.t%d\n", t1, elemdref, zerotemp);
+  emitf("  %%.t%d =w cnel %%.t%d, %%.t%d\n", t1, elemdref, zerotemp);
   cgjump_if_false(t1, this->break_label);
 
   // Dereference elemdref and store in the loop variable.
   // We do this by building a suitable ASSIGN ASTnode and call gen_assign()
-  fprintf(Outfh, "# Dereference elemdref and store in the loop variable\n");
+  emitf("# Dereference elemdref and store in the loop variable\n");
   t1= cgderef(elemdref, n->left->type);
 
   // Generate any code for the loop variable
-  fprintf(Outfh, "# Generate any code for the loop variable\n");
+  emitf("# Generate any code for the loop variable\n");
   t2= genAST(n->left);
 
   // Assign the deref'd elemdref to the loop variable
   assign= mkastnode(A_ASSIGN, NULL, NULL, n->left);
-  fprintf(Outfh, "# Assign the deref'd elemdref to the loop variable\n");
+  emitf("# Assign the deref'd elemdref to the loop variable\n");
   gen_assign(t1, t2, assign);
 
   // Loop body
-  fprintf(Outfh, "# Loop body\n");
+  emitf("# Loop body\n");
   genAST(n->right);
 
   // Free elemdref
-  fprintf(Outfh, "# Free elemdref\n");
-  fprintf(Outfh, "  call $free(l %%.t%d)\n", elemdref);
+  emitf("# Free elemdref\n");
+  emitf("  call $free(l %%.t%d)\n", elemdref);
 
   // Move elemptr up by sizeof(pointer)
-  fprintf(Outfh, "# Move elemptr up by sizeof(pointer)\n");
+  emitf("# Move elemptr up by sizeof(pointer)\n");
   t1= cgalloctemp();
   cglabel(this->continue_label);
-  fprintf(Outfh, "  %%.t%d =l copy 8\n", t1);
-  fprintf(Outfh, "  %%.t%d =l add %%.t%d, %%.t%d\n", elemptr, elemptr, t1);
+  emitf("  %%.t%d =l copy 8\n", t1);
+  emitf("  %%.t%d =l add %%.t%d, %%.t%d\n", elemptr, elemptr, t1);
 
   // Jump to the top of the for loop
-  fprintf(Outfh, "# Jump to the top of the for loop\n");
+  emitf("# Jump to the top of the for loop\n");
   cgjump(Lfortop);
 
   // End of the for statement
-  fprintf(Outfh, "# End of the for statement\n");
+  emitf("# End of the for statement\n");
   cglabel(this->break_label);
 
   // Free the list pointer
-  fprintf(Outfh, "# Free the list pointer\n");
-  fprintf(Outfh, "  call $free(l %%.t%d)\n", listptr);
+  emitf("# Free the list pointer\n");
+  emitf("  call $free(l %%.t%d)\n", listptr);
 
   // End of the if statement
-  fprintf(Outfh, "# End of the if statement\n");
+  emitf("# End of the if statement\n");
   cglabel(Lifend);
 
   return(NOTEMP);
 }
 
-// Runtime check that the offset into a string is OK
-void cg_stridxcheck(int idxtemp, int basetemp, int funcname) {
+// Get the length of a string into a temporary, or
+// zero if the string is NULL. Return the temporary
+int cg_strlen(int basetemp) {
   int t1;
-  int zerotemp = cgalloctemp();
   int lentemp = cgalloctemp();
-  int Lgood = genlabel();
-  int Lfail = genlabel();
+  int Lend = genlabel();
 
-  // Check that the base address isn't NULL
-  fprintf(Outfh, "  %%.t%d =l copy 0\n", zerotemp);
-  t1 = cgcompare(A_NE, basetemp, zerotemp, ty_int64);
-  cgjump_if_false(t1, Lfail);
+  emitf("  %%.t%d =l copy 0\n", lentemp);
+  t1 = cgcompare(A_NE, basetemp, lentemp, ty_int64);
+  cgjump_if_false(t1, Lend);
+  emitf("  %%.t%d =l call $strlen(l %%.t%d)\n", lentemp, basetemp);
+  cglabel(Lend);
+  return (lentemp);
+}
+
+// Runtime check that the offset into a string is OK.
+// If lentemp isn't NOTEMP, it holds the string's length
+// from cg_strlen(), which is zero for a NULL string
+void cg_stridxcheck(int idxtemp, int basetemp, int funcname, int lentemp) {
+  int t1;
+  int zerotemp = cgalloctemp();
+  bool knownlen = (lentemp != NOTEMP);
+  int Lgood, Lfail;
+
+  if (!knownlen)
+    lentemp = cgalloctemp();
+  Lgood = genlabel();
+  Lfail = genlabel();
+
+  // Check that the base address isn't NULL.
+  // A known length is zero if it is
+  emitf("  %%.t%d =l copy 0\n", zerotemp);
+  if (!knownlen) {
+    t1 = cgcompare(A_NE, basetemp, zerotemp, ty_int64);
+    cgjump_if_false(t1, Lfail);
+  }
 
   // Check that the index isn't negative
   t1 = cgcompare(A_GE, idxtemp, zerotemp, ty_int64);
   cgjump_if_false(t1, Lfail);
 
   // Get the string's length
-  fprintf(Outfh, "  %%.t%d =l call $strlen(l %%.t%d)\n", lentemp, basetemp);
+  if (!knownlen)
+    emitf("  %%.t%d =l call $strlen(l %%.t%d)\n", lentemp, basetemp);
 
   // Check that the index is below the length
   t1 = cgcompare(A_LT, idxtemp, lentemp, ty_int64);
@@ -1262,7 +1494,7 @@ void cg_stridxcheck(int idxtemp, int basetemp, int funcname) {
 
   // Output the call to .fatal() if the range checks fail
   cglabel(Lfail);
-  fprintf(Outfh, "  call $.fatal(l $.stridxerr, l $L%d)\n", funcname);
+  emitf("  call $.fatal(l $.stridxerr, l $L%d)\n", funcname);
   cglabel(Lgood);
 
   return;
@@ -1279,54 +1511,54 @@ int cg_stringiterator(ASTnode * n, Breaklabel *this) {
   ASTnode *assign;
 
   // Get a copy of the base of the string
-  fprintf(Outfh, "# Start of a string iteration\n");
+  emitf("# Start of a string iteration\n");
   listptr= genAST(n->mid);
 
   // Check if this is NULL
   zerotemp = cgalloctemp();
   t1= cgalloctemp();
   Lifend= genlabel();
-  fprintf(Outfh, "# Compare listptr against NULL and skip if it is\n");
-  fprintf(Outfh, "  %%.t%d =l copy 0\n", zerotemp);
-  fprintf(Outfh, "  %%.t%d =w cnel %%.t%d, %%.t%d\n", t1, listptr, zerotemp);
+  emitf("# Compare listptr against NULL and skip if it is\n");
+  emitf("  %%.t%d =l copy 0\n", zerotemp);
+  emitf("  %%.t%d =w cnel %%.t%d, %%.t%d\n", t1, listptr, zerotemp);
   cgjump_if_false(t1, Lifend);
 
   // Top of the foreach loop: is *listptr zero?
-  fprintf(Outfh, "# Top of the foreach loop: is *listptr zero?\n");
+  emitf("# Top of the foreach loop: is *listptr zero?\n");
   Lfortop= genlabel(); cglabel(Lfortop);
-  fprintf(Outfh, "# Dereference the listptr\n");
+  emitf("# Dereference the listptr\n");
   t1= cgderef(listptr, n->left->type);
   t2= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =w cnew %%.t%d, %%.t%d\n", t2, t1, zerotemp);
+  emitf("  %%.t%d =w cnew %%.t%d, %%.t%d\n", t2, t1, zerotemp);
   cgjump_if_false(t2, this->break_label);
 
   // Assign the deref'd listptr to the loop variable
-  fprintf(Outfh, "# Assign the deref'd listptr to the loop variable\n");
+  emitf("# Assign the deref'd listptr to the loop variable\n");
   assign= mkastnode(A_ASSIGN, NULL, NULL, n->left);
   t2= genAST(n->left);
   gen_assign(t1, t2, assign);
 
   // Loop body
-  fprintf(Outfh, "# Loop body\n");
+  emitf("# Loop body\n");
   genAST(n->right);
 
   // Move listptr up by one
-  fprintf(Outfh, "# Loop increment\n");
+  emitf("# Loop increment\n");
   cglabel(this->continue_label);
   t1= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =l copy 1\n", t1);
-  fprintf(Outfh, "  %%.t%d =l add %%.t%d, %%.t%d\n", listptr, listptr, t1);
+  emitf("  %%.t%d =l copy 1\n", t1);
+  emitf("  %%.t%d =l add %%.t%d, %%.t%d\n", listptr, listptr, t1);
 
   // Jump to the top of the for loop
-  fprintf(Outfh, "# Jump to the top of the for loop\n");
+  emitf("# Jump to the top of the for loop\n");
   cgjump(Lfortop);
 
   // End of the for statement
-  fprintf(Outfh, "# End of the for statement\n");
+  emitf("# End of the for statement\n");
   cglabel(this->break_label);
 
   // End of the if statement
-  fprintf(Outfh, "# End of the if statement\n");
+  emitf("# End of the if statement\n");
   cglabel(Lifend);
   return(NOTEMP);
 }
@@ -1343,52 +1575,52 @@ int cg_arrayiterator(ASTnode * n, Breaklabel *this) {
   int t3;
 
   // Get the base address of the array
-  fprintf(Outfh, "# Start of an array iteration\n");
+  emitf("# Start of an array iteration\n");
   aryptr= genAST(n->mid);
 
   // Set the hiddex index to zero
   idx= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =l copy 0\n", idx);
+  emitf("  %%.t%d =l copy 0\n", idx);
 
   // Get the array's size
   arysize= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =l copy %d\n", arysize, n->mid->count);
+  emitf("  %%.t%d =l copy %d\n", arysize, n->mid->count);
   
   // Top of the loop: is idx < the array's size
-  fprintf(Outfh, "# Top of the loop: is idx < the array's size\n");
+  emitf("# Top of the loop: is idx < the array's size\n");
   Lfortop= genlabel(); cglabel(Lfortop);
   t1= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =w csltl %%.t%d, %%.t%d\n", t1, idx, arysize);
+  emitf("  %%.t%d =w csltl %%.t%d, %%.t%d\n", t1, idx, arysize);
   cgjump_if_false(t1, this->break_label);
 
   // Get the element's value from the list
-  fprintf(Outfh, "# Get the element's value from the list\n");
+  emitf("# Get the element's value from the list\n");
   t2= cgderef(aryptr, n->left->type);
   assign= mkastnode(A_ASSIGN, NULL, NULL, n->left);
   t3= genAST(n->left);
   gen_assign(t2, t3, assign);
 
   // Loop body
-  fprintf(Outfh, "# Loop body\n");
+  emitf("# Loop body\n");
   genAST(n->right);
 
   // Increment idx
-  fprintf(Outfh, "# Loop increment\n");
+  emitf("# Loop increment\n");
   cglabel(this->continue_label);
 
   t1= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =l copy 1\n", t1);
-  fprintf(Outfh, "  %%.t%d =l add %%.t%d, %%.t%d\n", idx, idx, t1);
+  emitf("  %%.t%d =l copy 1\n", t1);
+  emitf("  %%.t%d =l add %%.t%d, %%.t%d\n", idx, idx, t1);
   t2= cgalloctemp();
-  fprintf(Outfh, "  %%.t%d =l copy %d\n", t2, n->left->type->size);
-  fprintf(Outfh, "  %%.t%d =l add %%.t%d, %%.t%d\n", aryptr, aryptr, t2);
+  emitf("  %%.t%d =l copy %d\n", t2, n->left->type->size);
+  emitf("  %%.t%d =l add %%.t%d, %%.t%d\n", aryptr, aryptr, t2);
 
   // Jump to the top of the for loop
-  fprintf(Outfh, "# Jump to the top of the for loop\n");
+  emitf("# Jump to the top of the for loop\n");
   cgjump(Lfortop);
 
   // End of the for statement
-  fprintf(Outfh, "# End of the for statement\n");
+  emitf("# End of the for statement\n");
   cglabel(this->break_label); 
   return(NOTEMP);
 }
@@ -1398,8 +1630,8 @@ int cg_arrayiterator(ASTnode * n, Breaklabel *this) {
 int cg_copystruct(int srctemp, int desttemp, int size) {
   int t= cgalloctemp();
 
-  fprintf(Outfh, "  %%.t%d =l copy %d\n", t, size);
-  fprintf(Outfh, "  call $memcpy(l %%.t%d, l %%.t%d, l %%.t%d)\n",
+  emitf("  %%.t%d =l copy %d\n", t, size);
+  emitf("  call $memcpy(l %%.t%d, l %%.t%d, l %%.t%d)\n",
 			desttemp, srctemp, t);
   return(NOTEMP);
 }
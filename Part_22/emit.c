@@ -0,0 +1,157 @@
+// Buffered output of the QBE code for the alic compiler
+// (c) 2025 Warren Toomey, GPL3
+
+#include "alic.h"
+#include "proto.h"
+
+// All the QBE code is written into a buffer,
+// which is written out to Outfh when it fills up.
+
+// Write out the buffer contents, if
+// we have an open output file
+void emit_flush(void) {
+  int len = State.Outpos;
+
+  State.Outpos = 0;
+  State.Outbytes += len;
+  if (State.Outfh != NULL && len > 0 &&
+      fwrite(State.Outbuf, 1, len, State.Outfh) != len)
+    fatal("Unable to write the QBE output\n");
+}
+
+// Return the number of bytes output to this file
+size_t emit_bytes(void) {
+  return (State.Outbytes + State.Outpos);
+}
+
+// Output a single character
+static void emitch(int c) {
+  if (State.Holdbuf != NULL) {
+    if (State.Holdpos == State.Holdsize) {
+      State.Holdsize *= 2;
+      State.Holdbuf = (char *) realloc(State.Holdbuf, State.Holdsize);
+      if (State.Holdbuf == NULL)
+	fatal("Malloc failure\n");
+    }
+    State.Holdbuf[State.Holdpos++] = c;
+    return;
+  }
+  if (State.Outpos == OUTBUFSIZE)
+    emit_flush();
+  State.Outbuf[State.Outpos++] = c;
+}
+
+// With -U, a function's code is held back until we
+// know if the function is used. Start holding the output
+void emit_hold(void) {
+  State.Holdsize = OUTBUFSIZE;
+  State.Holdbuf = (char *) Malloc(State.Holdsize);
+  State.Holdpos = 0;
+}
+
+// Stop holding the output. Return
+// the held text and set its length
+char *emit_release(size_t *len) {
+  char *text = State.Holdbuf;
+
+  *len = State.Holdpos;
+  State.Holdbuf = NULL;
+  return (text);
+}
+
+// Output some text that was held back
+void emit_text(char *text, size_t len) {
+  emit_flush();
+  State.Outbytes += len;
+  if (State.Outfh != NULL && len > 0 &&
+      fwrite(text, 1, len, State.Outfh) != len)
+    fatal("Unable to write the QBE output\n");
+}
+
+// Output a string
+void emitstr(char *s) {
+  while (*s)
+    emitch(*s++);
+}
+
+// Output an unsigned integer in the given radix
+static void emituint(uint64_t n, int radix) {
+  char buf[24];
+  int i = 0;
+
+  // Build the digits in reverse order
+  do {
+    buf[i++] = "0123456789abcdef"[n % radix];
+    n = n / radix;
+  } while (n != 0);
+
+  while (i > 0)
+    emitch(buf[--i]);
+}
+
+// Output a signed decimal integer
+void emitint(int64_t n) {
+  if (n < 0) {
+    emitch('-');
+    emituint(-(uint64_t) n, 10);
+  } else
+    emituint(n, 10);
+}
+
+// A cut-down fprintf() which outputs to the buffer.
+// Only %c, %s, %d, %ld, %x and %f are supported
+void emitf(const char *fmt, ...) {
+  va_list ap;
+  char buf[TEXTLEN];
+  bool islong;
+  char *s;
+
+  va_start(ap, fmt);
+  for (; *fmt; fmt++) {
+    if (*fmt != '%') {
+      emitch(*fmt);
+      continue;
+    }
+
+    // Look for an 'l' modifier
+    fmt++;
+    islong = false;
+    if (*fmt == 'l') {
+      islong = true;
+      fmt++;
+    }
+
+    switch (*fmt) {
+    case '%':
+      emitch('%');
+      break;
+    case 'c':
+      emitch(va_arg(ap, int));
+      break;
+    case 's':
+      s = va_arg(ap, char *);
+      emitstr(s != NULL ? s : "(null)");
+      break;
+    case 'd':
+      if (islong)
+	emitint(va_arg(ap, int64_t));
+      else
+	emitint(va_arg(ap, int));
+      break;
+    case 'x':
+      if (islong)
+	emituint(va_arg(ap, uint64_t), 16);
+      else
+	emituint(va_arg(ap, unsigned), 16);
+      break;
+    case 'f':
+      // Floats are rare, so let snprintf() do the work
+      snprintf(buf, sizeof(buf), "%f", va_arg(ap, double));
+      emitstr(buf);
+      break;
+    default:
+      fatal("Unknown emitf() format %%%c\n", *fmt);
+    }
+  }
+  va_end(ap);
+}
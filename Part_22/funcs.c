@@ -4,6 +4,22 @@
 #include "alic.h"
 #include "proto.h"
 
+// With -U, the code of each function is held back
+// until the whole program is parsed, along with a
+// list of the functions that the code refers to
+struct Heldfunc {
+  Sym *sym;			// The function's symbol
+  char *text;			// The function's QBE code
+  size_t len;			// and its length
+  Sym **refs;			// The functions it refers to,
+  int numrefs;			// how many there are
+  int maxrefs;			// and the size of the list
+  bool is_live;			// Is the function used?
+  Heldfunc *next;		// The next function
+};
+
+static void hold_function(Sym * func);
+
 // Given an ASTnode representing a function's name & type
 // and a second ASTnode holding a list of parameters, add
 // the function to the symbol table. Die if the function
@@ -50,7 +66,7 @@ bool add_function(ASTnode * func, ASTnode * paramlist, int visibility) {
 	      func->strlit);
 
       // Parameter names differ
-      if (strcmp(this->name, paramlist->strlit))
+      if (this->name != paramlist->strlit)
 	fatal("%s() declaration: param name mismatch %s vs %s\n",
 	      func->strlit, this->name, paramlist->strlit);
 
@@ -138,16 +154,123 @@ void declare_function(ASTnode * f, int visibility) {
   this = find_symbol(f->strlit);
   this->has_block = true;
 
+  // Note the temporaries and labels used so far
+  // so that we can report those used by the function
+  State.Functemps = cgnumtemps();
+  State.Funclabels = gennumlabels();
+
+  // With -U, hold back the function's code
+  if (State.Unitfile != NULL)
+    hold_function(this);
   gen_func_preamble(this);
 }
 
 // Generate a function's statement block
 void gen_func_statement_block(ASTnode * s) {
+  int oldphase;
+
   if (O_dumpast) {
     dumpAST(s, 0);
     fflush(Debugfh);
   }
 
+  oldphase = time_phase(PH_GENAST);
   genAST(s);
-  gen_func_postamble(Thisfunction->type);
+  gen_func_postamble(State.Thisfunction->type);
+  if (State.Thisheld != NULL) {
+    State.Thisheld->text = emit_release(&State.Thisheld->len);
+    State.Thisheld = NULL;
+  }
+  time_phase(oldphase);
+
+  if (O_logtime)
+    fprintf(time_fh(), "%s %s(): %d AST nodes, %d temps, %d labels\n",
+	    State.Infilename, State.Thisfunction->name, count_AST(s),
+	    cgnumtemps() - State.Functemps, gennumlabels() - State.Funclabels);
+}
+
+// With -U, start holding back the code
+// of the function that we are about to generate
+static void hold_function(Sym * func) {
+  Heldfunc *h;
+
+  h = (Heldfunc *) Calloc(sizeof(Heldfunc));
+  h->sym = func;
+  func->heldcode = h;
+  if (State.Heldhead == NULL)
+    State.Heldhead = h;
+  else
+    State.Heldtail->next = h;
+  State.Heldtail = h;
+  State.Thisheld = h;
+  emit_hold();
+}
+
+// With -U, note that the function
+// being generated refers to the given one
+void note_funcref(Sym * func) {
+  Heldfunc *h = State.Thisheld;
+
+  if (h == NULL)
+    return;
+  if (h->numrefs == h->maxrefs) {
+    h->maxrefs = (h->maxrefs == 0) ? 16 : h->maxrefs * 2;
+    h->refs = (Sym **) realloc(h->refs, h->maxrefs * sizeof(Sym *));
+    if (h->refs == NULL)
+      fatal("Malloc failure\n");
+  }
+  h->refs[h->numrefs++] = func;
+}
+
+// Mark a held function and the
+// ones it refers to as being used
+static void mark_live(Heldfunc * h) {
+  int i;
+
+  if (h == NULL || h->is_live)
+    return;
+  h->is_live = true;
+  for (i = 0; i < h->numrefs; i++)
+    mark_live(h->refs[i]->heldcode);
+}
+
+// With -U, output the code of the functions that
+// are used: the public ones and those that they
+// refer to in turn. Drop the code of the others
+void gen_held_funcs(void) {
+  Heldfunc *h;
+
+  for (h = State.Heldhead; h != NULL; h = h->next)
+    if (h->sym->visibility == SV_PUBLIC)
+      mark_live(h);
+
+  for (h = State.Heldhead; h != NULL; h = h->next) {
+    if (h->is_live)
+      emit_text(h->text, h->len);
+    else
+      State.Funcsremoved++;
+  }
+  free_heldfuncs();
+}
+
+// Free the held functions and any
+// code that is still being held
+void free_heldfuncs(void) {
+  Heldfunc *h, *next;
+  size_t len;
+
+  for (h = State.Heldhead; h != NULL; h = next) {
+    next = h->next;
+    h->sym->heldcode = NULL;
+    free(h->text);
+    free(h->refs);
+    free(h);
+  }
+  State.Heldhead = State.Heldtail = State.Thisheld = NULL;
+  free(emit_release(&len));
+}
+
+// Return the number of unused functions removed
+int funcs_removed(void) {
+  return (State.Funcsremoved);
 }
@@ -8,8 +8,6 @@
 // keep this node which holds the needed information.
 // There is a stack of these as try/catch statement
 // can be nested.
-typedef struct Edetails Edetails;
-
 struct Edetails {
   Sym *sym;			// The variable that catches the exception
   int Lcatch;			// The label starting the catch clause
@@ -17,20 +15,13 @@ struct Edetails {
   Edetails *prev;		// The previous node on the stack
 };
 
-static Edetails *Ehead = NULL;	// The stack of Edetail nodes
-
-static Breaklabel *Breakhead = NULL;	// The stack of Breaklabel nodes
-
 // We keep a stack of "next case"
 // labels for switch statements
-typedef struct Switchlabel Switchlabel;
 struct Switchlabel {
   int next_label;
   Switchlabel *prev;
 };
 
-static Switchlabel *Switchhead = NULL;	// The stack of Switchlabel nodes
-
 static void gen_IF(ASTnode * n);
 static void gen_WHILE(ASTnode * n, int forlabel);
 static void gen_SWITCH(ASTnode * n);
@@ -47,10 +38,14 @@ static int gen_aaiterstart(ASTnode * n);
 static int gen_aanext(ASTnode * n);
 
 // Generate and return a new label number
-static int labelid = 1;
 int genlabel(void) {
-  labelid++;
-  return (labelid);
+  State.labelid++;
+  return (State.labelid);
+}
+
+// Return the number of labels generated so far
+int gennumlabels(void) {
+  return (State.labelid);
 }
 
 // Given an AST, generate assembly code recursively.
@@ -60,6 +55,8 @@ int genAST(ASTnode * n) {
   int functemp;
   int temp;
   int label;
+  int count, i;
+  ASTnode **chain;
   Breaklabel *this;
 
   // Empty tree, do nothing
@@ -83,7 +80,27 @@ int genAST(ASTnode * n) {
       n->right->sym->exceptvar= n->left->sym->exceptvar;
     break;
   case A_LOCAL:
-    gen_local(n);
+    // Declare each local in the chain, then generate
+    // the code for the children in the same order
+    // as if we had recursed down the chain
+    chain = ast_chain(n, &count);
+    for (i = 0; i < count; i++)
+      gen_local(chain[i]);
+    genAST(chain[count - 1]->mid);
+    for (i = count - 1; i >= 0; i--)
+      genAST(chain[i]->right);
+    free(chain);
+    return (NOTEMP);
+  case A_GLUE:
+    // Generate the statements in a chain
+    // without recursing down the chain
+    if (n->is_short_assign == true)
+      break;
+    chain = ast_chain(n, &count);
+    genAST(chain[count - 1]->left);
+    for (i = count - 1; i >= 0; i--)
+      genAST(chain[i]->right);
+    free(chain);
     return (NOTEMP);
   case A_FUNCCALL:
     return (gen_funccall(n));
@@ -106,6 +123,28 @@ int genAST(ASTnode * n) {
     return (gen_ternary(n));
   case A_CAST:
     return (gen_cast(n));
+  case A_MULTIPLY:
+  case A_DIVIDE:
+  case A_MOD:
+    // Multiply, divide and modulo by an integer literal
+    // can mostly be done with shifts, masks and multiplies.
+    // The multiplies of an index by an element size have
+    // a pointer type, so allow those as well
+    if (is_flonum(n->type) || (n->op != A_MULTIPLY && !is_integer(n->type)))
+      break;
+    if (n->right->op == A_NUMLIT) {
+      lefttemp = genAST(n->left);
+      if (n->op == A_MULTIPLY)
+	return (cgmulconst(lefttemp, n->right->litval.intval, n->type));
+      if (n->op == A_DIVIDE)
+	return (cgdivconst(lefttemp, n->right->litval.intval, n->type));
+      return (cgmodconst(lefttemp, n->right->litval.intval, n->type));
+    }
+    if (n->op == A_MULTIPLY && n->left->op == A_NUMLIT) {
+      righttemp = genAST(n->right);
+      return (cgmulconst(righttemp, n->left->litval.intval, n->type));
+    }
+    break;
   case A_AARRAY:
     return (gen_aarray(n, NOTEMP, NULL));
   case A_UNDEF:
@@ -119,32 +158,32 @@ int genAST(ASTnode * n) {
     this = (Breaklabel *) Malloc(sizeof(Breaklabel));
     this->continue_label= genlabel();
     this->break_label= genlabel();
-    this->prev = Breakhead;
-    Breakhead = this;
+    this->prev = State.Breakhead;
+    State.Breakhead = this;
     cg_funciterator(n, this);
-    Breakhead = this->prev;
+    State.Breakhead = this->prev;
     return(NOTEMP);
   case A_STRINGITER:
     // Add a Breaklabel node
     this = (Breaklabel *) Malloc(sizeof(Breaklabel));
     this->continue_label= genlabel();
     this->break_label= genlabel();
-    this->prev = Breakhead;
-    Breakhead = this;
+    this->prev = State.Breakhead;
+    State.Breakhead = this;
     cg_stringiterator(n, this);
     // Remove the Breaklabel node
-    Breakhead = this->prev;
+    State.Breakhead = this->prev;
     return(NOTEMP);
   case A_ARRAYITER:
     // Add a Breaklabel node
     this = (Breaklabel *) Malloc(sizeof(Breaklabel));
     this->continue_label= genlabel();
     this->break_label= genlabel();
-    this->prev = Breakhead;
-    Breakhead = this;
+    this->prev = State.Breakhead;
+    State.Breakhead = this;
     cg_arrayiterator(n, this);
     // Remove the Breaklabel node
-    Breakhead = this->prev;
+    State.Breakhead = this->prev;
     return(NOTEMP);
   case A_FOR:
     // Generate the initial code
@@ -167,9 +206,9 @@ int genAST(ASTnode * n) {
     lefttemp = genAST(n->left);
 
   if ((n->op == A_GLUE) && (n->is_short_assign == true)) {
-    if (Breakhead == NULL)
+    if (State.Breakhead == NULL)
       fatal("NULL Breakhead trying to generate FOR continue label\n");
-    cglabel(Breakhead->continue_label);
+    cglabel(State.Breakhead->continue_label);
   }
 
   if (n->right)
@@ -184,8 +223,9 @@ int genAST(ASTnode * n) {
   case A_ADDOFFSET:
     // Do a runtime check on a string's length
     if (n->type == ty_string) {
-      functemp = add_strlit(Thisfunction->name, true);
-      cg_stridxcheck(lefttemp, righttemp, functemp);
+      functemp = add_strlit(State.Thisfunction->name, true);
+      cg_stridxcheck(lefttemp, righttemp, functemp,
+		     (n->count != 0) ? State.Strlentemps[n->count] : NOTEMP);
     }
     return (cgadd(lefttemp, righttemp, n->type));
   case A_SUBTRACT:
@@ -206,7 +246,9 @@ int genAST(ASTnode * n) {
   case A_ASSIGN:
     return(gen_assign(lefttemp, righttemp, n));
   case A_WIDEN:
-    functemp = add_strlit(Thisfunction->name, true);
+    // No function name means no range checks
+    functemp = (n->in_range) ? NOTEMP :
+      add_strlit(State.Thisfunction->name, true);
     return (cgcast(lefttemp, n->left->type, n->type, functemp));
   case A_EQ:
   case A_NE:
@@ -233,11 +275,11 @@ int genAST(ASTnode * n) {
     return (NOTEMP);
   case A_RETURN:
     // If the return type has a range, check the value
-    if (has_range(Thisfunction->type)) {
-      functemp = add_strlit(Thisfunction->name, true);
-      cgrangecheck(lefttemp, Thisfunction->type, functemp);
+    if (has_range(State.Thisfunction->type) && !n->in_range) {
+      functemp = add_strlit(State.Thisfunction->name, true);
+      cgrangecheck(lefttemp, State.Thisfunction->type, functemp);
     }
-    cgreturn(lefttemp, Thisfunction->type);
+    cgreturn(lefttemp, State.Thisfunction->type);
     return (NOTEMP);
   case A_ABORT:
     cgabort();
@@ -256,38 +298,33 @@ int genAST(ASTnode * n) {
       return (lefttemp);
   case A_BREAK:
     // Make sure we have a label to jump to
-    if (Breakhead == NULL)
+    if (State.Breakhead == NULL)
       lfatal(n->line, "Can only break within a loop\n");
-    cgjump(Breakhead->break_label);
+    cgjump(State.Breakhead->break_label);
     // QBE needs a label after a jump
     cglabel(genlabel());
     return (NOTEMP);
   case A_CONTINUE:
     // Make sure we have a label to jump to
-    if (Breakhead == NULL)
+    if (State.Breakhead == NULL)
       lfatal(n->line, "Can only continue within a loop\n");
-    cgjump(Breakhead->continue_label);
+    cgjump(State.Breakhead->continue_label);
     // QBE needs a label after a jump
     cglabel(genlabel());
     return (NOTEMP);
   case A_SCALE:
-    // At some point, add an optimisation
-    // to use shifts instead of multiply when
-    // the scale size is 2, 4 or 8.
-    //
-    // Get a temp with the size to scale
-    temp = cgloadlit(&(n->litval), ty_int64);
-    return (cgmul(lefttemp, temp, n->type));
+    // Multiply by the size to scale
+    return (cgmulconst(lefttemp, n->litval.intval, n->type));
   case A_FALLTHRU:
-    if (Switchhead == NULL)
+    if (State.Switchhead == NULL)
       lfatal(n->line, "Cannot fallthru when not in a switch statement\n");
-    cgjump(Switchhead->next_label);
+    cgjump(State.Switchhead->next_label);
     // QBE needs a label after a jump
     cglabel(genlabel());
     return (NOTEMP);
   case A_BOUNDS:
     label = add_strlit(n->strlit, n->is_const);
-    temp = add_strlit(Thisfunction->name, true);
+    temp = add_strlit(State.Thisfunction->name, true);
     return (cgboundscheck(lefttemp, righttemp, label, temp));
   case A_VASTART:
     cg_vastart(n);
@@ -301,6 +338,18 @@ int genAST(ASTnode * n) {
     return(gen_aaiterstart(n));
   case A_AANEXT:
     return(gen_aanext(n));
+  case A_STRLEN:
+    // Keep the string's length for the
+    // index checks which use this slot
+    if (n->count >= State.Maxstrlens) {
+      State.Maxstrlens = n->count + 16;
+      State.Strlentemps = (int *) realloc(State.Strlentemps,
+					  State.Maxstrlens * sizeof(int));
+      if (State.Strlentemps == NULL)
+	fatal("Malloc failure\n");
+    }
+    State.Strlentemps[n->count] = cg_strlen(lefttemp);
+    return (NOTEMP);
   }
 
   // Error
@@ -373,8 +422,8 @@ static void gen_WHILE(ASTnode * n, int for_label) {
   else
     this->continue_label = Lstart;
   this->break_label = Lend;
-  this->prev = Breakhead;
-  Breakhead = this;
+  this->prev = State.Breakhead;
+  State.Breakhead = this;
 
   // Generate the condition code but only
   // if the condition isn't a TRUE node
@@ -394,7 +443,7 @@ static void gen_WHILE(ASTnode * n, int for_label) {
   cglabel(Lend);
 
   // And pop the Breaklabel node from the stack
-  Breakhead = this->prev;
+  State.Breakhead = this->prev;
 }
 
 // Generate space for a local variable
@@ -436,8 +485,8 @@ void gen_local(ASTnode * n) {
       lefttemp = genAST(n->left);
 
       // Check the expression's range if required
-      if (has_range(n->type)) {
-        functemp = add_strlit(Thisfunction->name, true);
+      if (has_range(n->type) && !n->in_range) {
+        functemp = add_strlit(State.Thisfunction->name, true);
         cgrangecheck(lefttemp, n->type, functemp);
       }
 
@@ -445,10 +494,6 @@ void gen_local(ASTnode * n) {
       cgstorvar(lefttemp, n->type, n->sym);
     }
   }
-
-  // Generate any code for the other children
-  genAST(n->mid);
-  genAST(n->right);
 }
 
 // Given a parameter's type and inout flag,
@@ -527,7 +572,7 @@ static int gen_funccall(ASTnode * n) {
 
   // If the function throws an exception, we had better
   // be in a try or catch clause
-  if (func_throws && (Ehead == NULL))
+  if (func_throws && (State.Ehead == NULL))
     lfatal(n->line, "Must call %s() in a try or catch clause\n",
 	n->left->strlit);
 
@@ -599,7 +644,7 @@ static int gen_funccall(ASTnode * n) {
 	   i++, param = param->next) {
 	// Find the named expression that matches the parameter name
 	for (this = n->right; this != NULL; this = this->right) {
-	  if (!strcmp(param->name, this->strlit)) {
+	  if (param->name == this->strlit) {
 
 	    // See if we have already used this parameter name.
 	    // Mark it as being used
@@ -652,7 +697,7 @@ static int gen_funccall(ASTnode * n) {
   // and the function throws an exception,
   // get its address into a temporary
   if (func_throws) {
-    excepttemp = cgaddress(Ehead->sym);
+    excepttemp = cgaddress(State.Ehead->sym);
 
     // Get a literal zero into a temporary
     zero.intval = 0;
@@ -668,7 +713,7 @@ static int gen_funccall(ASTnode * n) {
   // If we are in a try clause, test if the first
   // member of the exception variable is not zero.
   // If not, jump to the catch clause
-  if (func_throws && (Ehead != NULL) && (Ehead->in_try == true)) {
+  if (func_throws && (State.Ehead != NULL) && (State.Ehead->in_try == true)) {
 
     // Get the value of the first member in the exception variable
     excepttemp = cgderef(excepttemp, ty_int32);
@@ -677,7 +722,7 @@ static int gen_funccall(ASTnode * n) {
     excepttemp = cgcompare(A_EQ, excepttemp, zerotemp, ty_int32);
 
     // Jump if false to the catch label
-    cgjump_if_false(excepttemp, Ehead->Lcatch);
+    cgjump_if_false(excepttemp, State.Ehead->Lcatch);
   }
 
   // Otherwise, return any value from the function call
@@ -701,8 +746,8 @@ static void gen_try(ASTnode * n) {
   this->in_try = true;
 
   // Push the node on the stack
-  this->prev = Ehead;
-  Ehead = this;
+  this->prev = State.Ehead;
+  State.Ehead = this;
 
   // Generate the code for the try clause
   // and jump past the catch clause
@@ -717,7 +762,7 @@ static void gen_try(ASTnode * n) {
   cglabel(Lend);
 
   // Finally remove the Edetails node
-  Ehead = Ehead->prev;
+  State.Ehead = State.Ehead->prev;
 }
 
 // Generate the code for a SWITCH statement
@@ -733,8 +778,8 @@ static void gen_SWITCH(ASTnode * n) {
   // Build a Switchlabel node and push it on to
   // the stack of Switchlabels
   this = (Switchlabel *) Malloc(sizeof(Switchlabel));
-  this->prev = Switchhead;
-  Switchhead = this;
+  this->prev = State.Switchhead;
+  State.Switchhead = this;
 
   // Create an array for the case testing labels
   // and an array for the case code labels
@@ -796,7 +841,7 @@ static void gen_SWITCH(ASTnode * n) {
       // Before we generate the code, update the Switchlabel
       // to have the label for the next case code, in
       // case we do a fallthrough in the body
-      Switchhead->next_label = codelabel[i + 1];
+      State.Switchhead->next_label = codelabel[i + 1];
 
       // Generate the case code
       genAST(c->left);
@@ -808,7 +853,7 @@ static void gen_SWITCH(ASTnode * n) {
 
   // Now output the end label and pull the Switchlabel from the stack
   cglabel(Lend);
-  Switchhead = Switchhead->prev;
+  State.Switchhead = State.Switchhead->prev;
   return;
 }
 
@@ -891,7 +936,10 @@ int genalign(Type * ty, int offset) {
   return (cgalign(ty, offset));
 }
 
+// The labels in each output file
+// are numbered from the start
 void gen_file_preamble(void) {
+  State.labelid = 1;
   cg_file_preamble();
 }
 
@@ -905,7 +953,8 @@ void gen_func_postamble(Type * type) {
 
 static int gen_cast(ASTnode * n) {
   int exprtemp = genAST(n->left);
-  int functemp = add_strlit(Thisfunction->name, true);
+  int functemp = (n->in_range) ? NOTEMP :
+    add_strlit(State.Thisfunction->name, true);
   return(cgcast(exprtemp, n->left->type, n->type, functemp));
 }
 
@@ -1038,8 +1087,8 @@ int gen_assign(int ltemp, int rtemp, ASTnode *n) {
     // We are assigning to an identifier.
 
     // If the type has a range, check it
-    if (has_range(n->right->type)) {
-      functemp = add_strlit(Thisfunction->name, true);
+    if (has_range(n->right->type) && !n->in_range) {
+      functemp = add_strlit(State.Thisfunction->name, true);
       cgrangecheck(ltemp, n->right->type, functemp);
     }
 
@@ -1047,8 +1096,8 @@ int gen_assign(int ltemp, int rtemp, ASTnode *n) {
   case A_DEREF:
     // We are assigning though a pointer.
     // If the type has a range, check it
-    if (has_range(n->right->type)) {
-      functemp = add_strlit(Thisfunction->name, true);
+    if (has_range(n->right->type) && !n->in_range) {
+      functemp = add_strlit(State.Thisfunction->name, true);
       cgrangecheck(ltemp, n->right->type, functemp);
     }
 
@@ -1155,7 +1204,7 @@ ASTnode *check_bel(Sym * sym, ASTnode * list,
 
     // Check the expression's range if required
     if (has_range(ty)) {
-      functemp = add_strlit(Thisfunction->name, true);
+      functemp = add_strlit(State.Thisfunction->name, true);
       cgrangecheck(exprtemp, ty, functemp);
     }
 
@@ -4,53 +4,218 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "alic.h"
 #include "proto.h"
 
-int Linestart = 0;
-int Putback = 0;
-char Text[TEXTLEN + 1];		// Text of the last token scanned
-Token Peektoken;		// A look-ahead token
-Token Thistoken;		// The last token scanned
+// Identifiers and string literals are interned: each
+// distinct string is stored once along with its hash
+// value. Interned strings can be compared by pointer,
+// and their hash value found without rehashing them.
+typedef struct Internstr Internstr;
+struct Internstr {
+  uint64_t hash;		// The string's hash value
+  Internstr *next;		// Next string in the same bucket
+  char str[];			// The string itself
+};
+
+#define INTERNSIZE 4096		// Must be a power of two
+
+// The interned strings are shared by all the threads.
+// New strings are added to the front of a bucket under
+// a lock, and each bucket's head is read and written
+// atomically, so a bucket can be searched without the lock
+static Internstr *Internhash[INTERNSIZE];
+static pthread_mutex_t Internlock = PTHREAD_MUTEX_INITIALIZER;
+
+// Search a bucket for a string. Return its copy or NULL
+static char *find_intern(char *s, uint64_t hash, int bucket) {
+  Internstr *this;
+
+  this = __atomic_load_n(&Internhash[bucket], __ATOMIC_ACQUIRE);
+  for (; this != NULL; this = this->next)
+    if (this->str == s ||
+	(this->hash == hash && !strcmp(this->str, s)))
+      return (this->str);
+  return (NULL);
+}
+
+// Given a string, return the interned copy of it
+char *intern(char *s) {
+  Internstr *this;
+  uint64_t hash = djb2hash((uint8_t *) s);
+  int bucket = hash & (INTERNSIZE - 1);
+  char *str;
+
+  // Return any existing copy
+  if ((str = find_intern(s, hash, bucket)) != NULL)
+    return (str);
+
+  // Otherwise make a new one and add it to the bucket,
+  // unless another thread has just done so
+  pthread_mutex_lock(&Internlock);
+  if ((str = find_intern(s, hash, bucket)) == NULL) {
+    this = (Internstr *) Malloc(sizeof(Internstr) + strlen(s) + 1);
+    this->hash = hash;
+    strcpy(this->str, s);
+    this->next = Internhash[bucket];
+    __atomic_store_n(&Internhash[bucket], this, __ATOMIC_RELEASE);
+    str = this->str;
+  }
+  pthread_mutex_unlock(&Internlock);
+  return (str);
+}
+
+// Given an interned string, return its hash value
+uint64_t namehash(char *s) {
+  Internstr *this = (Internstr *) (s - offsetof(Internstr, str));
+  return (this->hash);
+}
+
+// The pre-processed input is held in memory and
+// we scan it directly. Inptr points at the next
+// character to read, Inend just past the last one
+
+// Character classes, used instead of the
+// <ctype.h> functions when scanning the input
+#define CC_SPACE	0x01	// Whitespace
+#define CC_DIGIT	0x02	// Decimal digit
+#define CC_IDENT	0x04	// Letter, digit or underscore
+#define CC_HEX		0x08	// Hexadecimal digit
+#define CC_NUM		0x10	// Can be in a numeric literal
+
+static uint8_t Charclass[256];
 
-// Get the next character from the input file.
+// Is c (which may be EOF) in the given class(es)?
+#define inclass(c, f)	((c) != EOF && (Charclass[(uint8_t) (c)] & (f)))
+
+static void init_keywords(void);
+
+// Build the character class table
+static void init_charclass(void) {
+  int c;
+
+  for (c = 0; c < 256; c++) {
+    Charclass[c] = 0;
+    if (isspace(c))
+      Charclass[c] |= CC_SPACE;
+    if (isdigit(c))
+      Charclass[c] |= CC_DIGIT;
+    if (isalnum(c) || c == '_')
+      Charclass[c] |= CC_IDENT;
+    if (isxdigit(c))
+      Charclass[c] |= CC_HEX;
+    if (c != 0 && strchr("0123456789ABCDEFabcdef.x", c) != NULL)
+      Charclass[c] |= CC_NUM;
+  }
+}
+
+// Set up the scanner's tables, which the threads share
+static void init_lexer(void) {
+  init_charclass();
+  init_keywords();
+}
+
+// Start scanning the len characters in buf
+// and reset the scanner's state
+void lex_input(char *buf, size_t len) {
+  static pthread_once_t done_init = PTHREAD_ONCE_INIT;
+
+  pthread_once(&done_init, init_lexer);
+
+  State.Inptr = buf;
+  State.Inend = buf + len;
+  State.Line = 1;
+  State.Linestart = 1;
+  State.Putback = 0;
+  State.Peektoken.token = 0;
+}
+
+// Get the next character from the input buffer,
+// or EOF if there are no characters left
+static int getch(void) {
+  if (State.Inptr < State.Inend)
+    return ((uint8_t) * State.Inptr++);
+  return (EOF);
+}
+
+// Get the next character from the input.
 static int next(void) {
   int c, l;
 
-  if (Putback) {		// Use the character put
-    c = Putback;		// back if there is one
-    Putback = 0;
+  if (State.Putback) {		// Use the character put
+    c = State.Putback;		// back if there is one
+    State.Putback = 0;
     return (c);
   }
 
-  c = fgetc(Infh);			// Read from input file
+  // The common case: an ordinary character
+  // which isn't a newline or a pre-processor line
+  if (State.Inptr < State.Inend) {
+    c = (uint8_t) * State.Inptr;
+    if (c != '\n' && !(State.Linestart && c == '#')) {
+      State.Inptr++;
+      State.Linestart = 0;
+      return (c);
+    }
+  }
+
+  c = getch();			// Read from the input buffer
+
+  while (State.Linestart && c == '#') {	// We've hit a pre-processor statement
+    State.Linestart = 0;			// No longer at the start of the line
+    scan(&State.Thistoken);			// Get the line number into l
+
+    // A precompiled header to load
+    if (State.Thistoken.token == T_IDENT && !strcmp(State.Text, "pch")) {
+      scan(&State.Thistoken);
+      if (State.Thistoken.token != T_STRLIT)
+	fatal("Expecting precompiled header name, got %s\n", State.Text);
+      pch_load(State.Text);
+      while ((c = getch()) != '\n' && c != EOF);
+      c = getch();
+      State.Linestart = 1;
+      continue;
+    }
+
+    // With -U, the start of the next file. The parser
+    // deals with this before the next declaration
+    if (State.Thistoken.token == T_IDENT && !strcmp(State.Text, "unit")) {
+      scan(&State.Thistoken);
+      if (State.Thistoken.token != T_STRLIT)
+	fatal("Expecting unit file name, got %s\n", State.Text);
+      State.Nextunit = strdup(State.Text);
+      while ((c = getch()) != '\n' && c != EOF);
+      c = getch();
+      State.Linestart = 1;
+      continue;
+    }
 
-  while (Linestart && c == '#') {	// We've hit a pre-processor statement
-    Linestart = 0;			// No longer at the start of the line
-    scan(&Thistoken);			// Get the line number into l
-    if (Thistoken.token != T_NUMLIT)
-      fatal("Expecting pre-processor line number, got %s\n", Text);
-    l = Thistoken.litval.intval;
+    if (State.Thistoken.token != T_NUMLIT)
+      fatal("Expecting pre-processor line number, got %s\n", State.Text);
+    l = State.Thistoken.litval.intval;
 
-    scan(&Thistoken);			// Get the filename in Text
-    if (Thistoken.token != T_STRLIT)
-      fatal("Expecting pre-processor file name, got %s\n", Text);
+    scan(&State.Thistoken);			// Get the filename in Text
+    if (State.Thistoken.token != T_STRLIT)
+      fatal("Expecting pre-processor file name, got %s\n", State.Text);
 
-    if (Text[0] != '<') {		// If this is a real filename
-      if (strcmp(Text, Infilename))	// and not the one we have now
-	Infilename = strdup(Text);	// save it. Then update the line num
-      Line = l;
+    if (State.Text[0] != '<') {		// If this is a real filename
+      if (strcmp(State.Text, State.Infilename))	// and not the one we have now
+	State.Infilename = strdup(State.Text);	// save it. Then update the line num
+      State.Line = l;
     }
 
-    while ((c = fgetc(Infh)) != '\n');	// Skip to the end of the line
-    c = fgetc(Infh);			// and get the next character
-    Linestart = 1;			// Now back at the start of the line
+    // Skip to the end of the line
+    // and get the next character
+    while ((c = getch()) != '\n' && c != EOF);
+    c = getch();
+    State.Linestart = 1;			// Now back at the start of the line
   }
 
-  Linestart = 0;		// No longer at the start of the line
+  State.Linestart = 0;		// No longer at the start of the line
   if ('\n' == c) {
-    Line++;			// Increment line count
-    Linestart = 1;		// Now back at the start of the line
+    State.Line++;			// Increment line count
+    State.Linestart = 1;		// Now back at the start of the line
   }
 
   return (c);
@@ -58,7 +223,7 @@ static int next(void) {
 
 // Put back an unwanted character
 static void putback(int c) {
-  Putback = c;
+  State.Putback = c;
 }
 
 // Skip past input that we don't need to deal with, 
@@ -68,7 +233,7 @@ static int skip(void) {
   int c;
 
   c = next();
-  while (isspace(c))
+  while (inclass(c, CC_SPACE))
     c = next();
   return (c);
 }
@@ -88,7 +253,7 @@ static int hexchar(void) {
   int c, h, n = 0, f = 0;
 
   // Loop getting characters
-  while (isxdigit(c = next())) {
+  while (inclass(c = next(), CC_HEX)) {
     // Convert from char to int value
     h = chrpos("0123456789abcdef", tolower(c));
 
@@ -175,9 +340,6 @@ static int scanch(bool *was_escaped) {
   return (c);			// Just an ordinary old character!
 }
 
-// List of characters that can be found in a numeric literal
-char *numchar = "0123456789ABCDEFabcdef.x";
-
 // Scan a numeric literal value from the input file
 // and store it in the given token pointer
 static void scan_numlit(Token * t, int c, bool is_negative) {
@@ -190,35 +352,42 @@ static void scan_numlit(Token * t, int c, bool is_negative) {
 
   // Put the first character and negative sign in the buffer
   if (is_negative) {
-    Text[i++] = '-';
+    State.Text[i++] = '-';
     t->litval.numtype = NUM_INT;
   }
-  Text[i++] = c;
+  State.Text[i++] = c;
 
   // Loop while we have enough buffer space
   for (; i < TEXTLEN - 1; i++) {
+    // Copy plain numeric characters straight from the input
+    if (State.Putback == 0 && State.Inptr < State.Inend &&
+	(Charclass[(uint8_t) * State.Inptr] & CC_NUM)) {
+      State.Text[i] = *State.Inptr++;
+      continue;
+    }
+
     c = scanch(NULL);
 
     // Found a non-numeric character
-    if (strchr(numchar, c) == NULL) {
+    if (!inclass(c, CC_NUM)) {
       putback(c);
       break;
     }
     // Otherwise add it to the buffer
-    Text[i] = c;
+    State.Text[i] = c;
   }
 
   // NUL terminate the string
-  Text[i] = '\0';
+  State.Text[i] = '\0';
 
   // Determine either if it's a float
   // or any octal/hex radix
-  if (strchr(Text, '.') != NULL) {
+  if (strchr(State.Text, '.') != NULL) {
     isfloat = true;
     t->litval.numtype = NUM_FLT;
   } else {
-    if (Text[0] == '0') {
-      if (Text[1] == 'x')
+    if (State.Text[0] == '0') {
+      if (State.Text[1] == 'x')
 	radix = 16;
       else
 	radix = 8;
@@ -227,9 +396,9 @@ static void scan_numlit(Token * t, int c, bool is_negative) {
 
   // Do the conversion
   if (isfloat)
-    t->litval.dblval = strtod(Text, NULL);
+    t->litval.dblval = strtod(State.Text, NULL);
   else
-    t->litval.uintval = strtoull(Text, NULL, radix);
+    t->litval.uintval = strtoull(State.Text, NULL, radix);
 }
 
 // Scan in a string literal from the input file,
@@ -259,126 +428,144 @@ static int scanstr(char *buf) {
 // Scan an identifier from the input file and
 // store it in buf[]. Return the identifier's length
 static int scanident(int c, char *buf, int lim) {
-  int i = 0;
+  char *start;
+  int i;
 
-  // Allow digits, alpha and underscores
-  while (isalpha(c) || isdigit(c) || '_' == c) {
-    // Error if we hit the identifier length limit,
-    // else append to buf[] and get next character
-    if (lim - 1 == i) {
-      fatal("Identifier too long\n");
-    } else if (i < lim - 1) {
-      buf[i++] = (char) c;
-    }
-    c = next();
-  }
+  // We have the first character. The rest can only be
+  // digits, alpha and underscores, so there can't be
+  // a newline or a put back character to deal with.
+  // Find the end of the identifier in the input
+  for (start = State.Inptr; State.Inptr < State.Inend; State.Inptr++)
+    if (!(Charclass[(uint8_t) * State.Inptr] & CC_IDENT))
+      break;
 
-  // We hit a non-valid character, put it back.
-  // NUL-terminate the buf[] and return the length
-  putback(c);
+  // Error if we hit the identifier length limit
+  i = State.Inptr - start + 1;
+  if (i > lim - 1)
+    fatal("Identifier too long\n");
+
+  // Copy it into buf[] and NUL-terminate it
+  buf[0] = (char) c;
+  memcpy(buf + 1, start, i - 1);
   buf[i] = '\0';
+
+  // Read and put back the following character,
+  // so that a newline there is counted now
+  putback(next());
   return (i);
 }
 
 
-// A structure to hold a keyword, its first letter
-// and the token id associated with the keyword
+// A structure to hold a keyword
+// and the token id associated with it
 struct keynode {
-  char first;
   char *keyword;
   int token;
 };
 
 // List of keywords and matching tokens
 static struct keynode keylist[] = {
-  {'N', "NULL", T_NULL},
-  {'a', "abort", T_ABORT},
-  {'b', "bool", T_BOOL},
-  {'b', "break", T_BREAK},
-  {'c', "case", T_CASE},
-  {'c', "cast", T_CAST},
-  {'c', "catch", T_CATCH},
-  {'c', "const", T_CONST},
-  {'c', "continue", T_CONTINUE},
-  {'d', "default", T_DEFAULT},
-  {'e', "else", T_ELSE},
-  {'e', "enum", T_ENUM},
-  {'e', "exists", T_EXISTS},
-  {'e', "extern", T_EXTERN},
-  {'f', "fallthru", T_FALLTHRU},
-  {'f', "false", T_FALSE},
-  {'f', "flt32", T_FLT32},
-  {'f', "flt64", T_FLT64},
-  {'f', "for", T_FOR},
-  {'f', "foreach", T_FOREACH},
-  {'f', "funcptr", T_FUNCPTR},
-  {'i', "if", T_IF},
-  {'i', "inout", T_INOUT},
-  {'i', "int8", T_INT8},
-  {'i', "int16", T_INT16},
-  {'i', "int32", T_INT32},
-  {'i', "int64", T_INT64},
-  {'p', "public", T_PUBLIC},
-  {'r', "range", T_RANGE},
-  {'r', "return", T_RETURN},
-  {'s', "sizeof", T_SIZEOF},
-  {'s', "string", T_STRING},
-  {'s', "struct", T_STRUCT},
-  {'s', "switch", T_SWITCH},
-  {'t', "throws", T_THROWS},
-  {'t', "true", T_TRUE},
-  {'t', "try", T_TRY},
-  {'t', "type", T_TYPE},
-  {'u', "uint8", T_UINT8},
-  {'u', "uint16", T_UINT16},
-  {'u', "uint32", T_UINT32},
-  {'u', "uint64", T_UINT64},
-  {'u', "undef", T_UNDEF},
-  {'u', "union", T_UNION},
-  {'v', "va_arg", T_VAARG},
-  {'v', "va_start", T_VASTART},
-  {'v', "va_end", T_VAEND},
-  {'v', "void", T_VOID},
-  {'w', "while", T_WHILE},
-  {0, NULL, 0}
+  {"NULL", T_NULL},
+  {"abort", T_ABORT},
+  {"bool", T_BOOL},
+  {"break", T_BREAK},
+  {"case", T_CASE},
+  {"cast", T_CAST},
+  {"catch", T_CATCH},
+  {"const", T_CONST},
+  {"continue", T_CONTINUE},
+  {"default", T_DEFAULT},
+  {"else", T_ELSE},
+  {"enum", T_ENUM},
+  {"exists", T_EXISTS},
+  {"extern", T_EXTERN},
+  {"fallthru", T_FALLTHRU},
+  {"false", T_FALSE},
+  {"flt32", T_FLT32},
+  {"flt64", T_FLT64},
+  {"for", T_FOR},
+  {"foreach", T_FOREACH},
+  {"funcptr", T_FUNCPTR},
+  {"if", T_IF},
+  {"inout", T_INOUT},
+  {"int8", T_INT8},
+  {"int16", T_INT16},
+  {"int32", T_INT32},
+  {"int64", T_INT64},
+  {"public", T_PUBLIC},
+  {"range", T_RANGE},
+  {"return", T_RETURN},
+  {"sizeof", T_SIZEOF},
+  {"string", T_STRING},
+  {"struct", T_STRUCT},
+  {"switch", T_SWITCH},
+  {"throws", T_THROWS},
+  {"true", T_TRUE},
+  {"try", T_TRY},
+  {"type", T_TYPE},
+  {"uint8", T_UINT8},
+  {"uint16", T_UINT16},
+  {"uint32", T_UINT32},
+  {"uint64", T_UINT64},
+  {"undef", T_UNDEF},
+  {"union", T_UNION},
+  {"va_arg", T_VAARG},
+  {"va_start", T_VASTART},
+  {"va_end", T_VAEND},
+  {"void", T_VOID},
+  {"while", T_WHILE},
+  {NULL, 0}
 };
 
-// Given a word from the input, return the matching
-// keyword token number or 0 if it's not a keyword.
-// Switch on the first letter so that we don't have
-// to waste time strcmp()ing against all the keywords.
-static int keyword(char *s) {
-  int i;
-
-  for (i = 0; keylist[i].first != 0; i++) {
-    // Too early
-    if (keylist[i].first < *s)
-      continue;
-
-    // A match
-    if (!strcmp(s, keylist[i].keyword))
-      return (keylist[i].token);
-
-    // Too late
-    if (keylist[i].first > *s)
-      return (0);
+// The keywords are found with a perfect hash on the
+// first, second and last characters and the length.
+// The multipliers were chosen so that no two keywords
+// share a bucket: init_keywords() checks this.
+#define KEYHASHSIZE 256		// Must be a power of two
+
+#define keyhash(s, len) \
+  (((uint8_t) (s)[0] * 3 + (uint8_t) (s)[1] * 21 + \
+    (uint8_t) (s)[(len) - 1] + (len) * 3) & (KEYHASHSIZE - 1))
+
+static struct keynode *Keyhash[KEYHASHSIZE];
+
+// Build the keyword hash table
+static void init_keywords(void) {
+  struct keynode *k;
+  int h;
+
+  for (k = keylist; k->keyword != NULL; k++) {
+    h = keyhash(k->keyword, strlen(k->keyword));
+    if (Keyhash[h] != NULL)
+      fatal("Keywords %s and %s have the same hash\n",
+	    Keyhash[h]->keyword, k->keyword);
+    Keyhash[h] = k;
   }
+}
+
+// Given a word from the input and its length, return
+// the matching keyword token number or 0 if it's not
+// a keyword. Only one keyword can be in the word's bucket.
+static int keyword(char *s, int len) {
+  struct keynode *k = Keyhash[keyhash(s, len)];
 
+  if (k != NULL && k->keyword[0] == s[0] && !strcmp(s, k->keyword))
+    return (k->token);
   return (0);
 }
 
 // Scan and return the next token found in the input.
 // Return 1 if token valid, 0 if no tokens left.
 int scan(Token * t) {
-  int c, tokentype;
+  int c, len, tokentype;
 
   // If we have a lookahead token, return this token
-  if (Peektoken.token != 0) {
-    t->token = Peektoken.token;
-    t->tokstr = Peektoken.tokstr;
-    t->litval.intval = Peektoken.litval.intval;
-    t->litval.numtype = Peektoken.litval.numtype;
-    Peektoken.token = 0;
+  if (State.Peektoken.token != 0) {
+    t->token = State.Peektoken.token;
+    t->tokstr = State.Peektoken.tokstr;
+    t->litval.intval = State.Peektoken.litval.intval;
+    t->litval.numtype = State.Peektoken.litval.numtype;
+    State.Peektoken.token = 0;
     return (1);
   }
 
@@ -407,7 +594,7 @@ int scan(Token * t) {
       break;
     }
 
-    if (isdigit(c)) {		// Negative numeric literal
+    if (inclass(c, CC_DIGIT)) {	// Negative numeric literal
       scan_numlit(t, c, true);
       t->token = T_NUMLIT;
     } else {
@@ -534,29 +721,29 @@ int scan(Token * t) {
     break;
   case '"':
     // Scan in a literal string
-    scanstr(Text);
+    scanstr(State.Text);
     t->token = T_STRLIT;
-    t->tokstr = strdup(Text);
+    t->tokstr = intern(State.Text);
     break;
   default:
     // If it's a digit, scan the
     // literal integer value in
-    if (isdigit(c)) {
+    if (inclass(c, CC_DIGIT)) {
       scan_numlit(t, c, false);
       t->token = T_NUMLIT;
       break;
-    } else if (isalpha(c) || '_' == c) {
+    } else if (inclass(c, CC_IDENT)) {
       // Read in a keyword or identifier
-      scanident(c, Text, TEXTLEN);
+      len = scanident(c, State.Text, TEXTLEN);
 
       // If it's a recognised keyword, return that token
-      if ((tokentype = keyword(Text)) != 0) {
+      if ((tokentype = keyword(State.Text, len)) != 0) {
 	t->token = tokentype;
 	break;
       }
       // Not a recognised keyword, so it must be an identifier
       t->token = T_IDENT;
-      t->tokstr = strdup(Text);
+      t->tokstr = intern(State.Text);
       break;
     }
     // The character isn't part of any recognised token, error
@@ -614,7 +801,7 @@ void dumptokens(void) {
     fprintf(Debugfh, "%s", tokstr[t.token]);
     switch (t.token) {
     case T_STRLIT:
-      fprintf(Debugfh, " \"%s\"", Text);
+      fprintf(Debugfh, " \"%s\"", State.Text);
       break;
     case T_NUMLIT:
       if (t.litval.numtype == NUM_CHAR) {
@@ -623,7 +810,7 @@ void dumptokens(void) {
       }
       // fallthrough
     case T_IDENT:
-      fprintf(Debugfh, " %s", Text);
+      fprintf(Debugfh, " %s", State.Text);
     }
     fprintf(Debugfh, "\n");
   }
@@ -633,11 +820,11 @@ void dumptokens(void) {
 // and psossibly fetch the next token.
 // Otherwise throw an error
 void match(int t, bool getnext) {
-  if (Thistoken.token != t)
-    fatal("Expected %s, got %s\n", tokstr[t], tokstr[Thistoken.token]);
+  if (State.Thistoken.token != t)
+    fatal("Expected %s, got %s\n", tokstr[t], tokstr[State.Thistoken.token]);
 
   if (getnext)
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 }
 
 // Match a semicolon and fetch the next token
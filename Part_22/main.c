@@ -1,37 +1,43 @@
 // The front-end for the alic compiler.
 // (c) 2019, 2025 Warren Toomey, GPL3
 
+#define _GNU_SOURCE		// For pipe2()
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
 #include "alic.h"
 #include "proto.h"
 
 // Commands and default filenames
 #define AOUT "a.out"
 #define ASCMD "as -g -o "
-#define QBECMD "qbe -o "
+#define QBEPIPECMD "qbe"
 #define LDCMD "cc -g -no-pie -o "
-#define CPPCMD "cpp -nostdinc -isystem "
+#define THREADSTACK (8 * 1024 * 1024)	// Stack size of a compiler thread
 
 // Global variables
-char *Infilename;		// Name of file we are parsing
-FILE *Infh;			// The input file
-FILE *Outfh;			// The output file
+_Thread_local Compstate State;	// This thread's compiler state
 FILE *Debugfh = NULL;		// The debugging file
-int Line = 1;			// Current line number
 bool O_dumptokens = false;	// Dump the input file's tokens
 bool O_dumpsyms = false;	// Dump the symbol table
 bool O_dumpast = false;		// Dump each function's AST tree
 bool O_logmisc = false;		// Log miscellaneous things
+bool O_logtime = false;		// Log the time spent in each phase
 bool O_boundscheck = true;	// Do array bounds checking
 bool O_verbose = false;		// Describe the compiler's steps
 bool O_dolink = true;		// Link to produce an executable
 bool O_keepasm = false;		// Keep the intermediate QBE & asm code
 bool O_assemble = false;	// Assemble the assembly code to .o
-
-// Local variables
-static char *Outfilename;	// Name of our output file
+int O_jobs = 1;			// Number of threads compiling files
+int O_qbeshards = 1;		// Number of qbe processes per file
+bool O_pipe = false;		// Pipe the QBE code through qbe and as
+bool O_precompile = false;	// Precompile header files
+bool O_qbeonly = false;		// Stop after making the QBE code
+bool O_unity = false;		// Compile all the files as one program
 
 // Given a string with a '.' and at least a 1-character suffix
 // after the '.', change the suffix to be the given character.
@@ -61,57 +67,147 @@ char *alter_suffix(char *str, char suffix) {
   return (newstr);
 }
 
-// Given an input filename, compile that file
-// down to assembly code. Return the new file's name
-static char *do_compile(char *filename) {
+// Run the command with the shell, with its standard
+// input coming from infd and its standard output
+// going to outfd if that isn't -1. Return its pid
+pid_t run_cmd(char *cmd, int infd, int outfd) {
+  pid_t pid;
+
+  if ((pid = fork()) == -1) {
+    fprintf(stderr, "Unable to fork: %s\n", strerror(errno));
+    exit(1);
+  }
+
+  if (pid == 0) {
+    dup2(infd, 0);
+    if (outfd != -1)
+      dup2(outfd, 1);
+    signal(SIGPIPE, SIG_DFL);
+    execl("/bin/sh", "sh", "-c", cmd, (char *) NULL);
+    _exit(127);
+  }
+  return (pid);
+}
+
+// Start qbe and as running, connected by pipes, so
+// that the QBE code written to Outfh is assembled
+// into the given object file without any temporary files
+static void open_pipeline(char *objfile) {
+  int qbepipe[2], aspipe[2];
   char cmd[TEXTLEN];
 
-  // Change the input file's suffix to .q
-  Outfilename = alter_suffix(filename, 'q');
-  if (Outfilename == NULL) {
-    fprintf(stderr, "Error: %s has no suffix, try .al on the end\n", filename);
+  // The pipes are closed on exec, so that the commands
+  // only have the ends that they need. They are made that
+  // way, as another thread may be starting its commands
+  if (pipe2(qbepipe, O_CLOEXEC) == -1 || pipe2(aspipe, O_CLOEXEC) == -1) {
+    fprintf(stderr, "Unable to make a pipe: %s\n", strerror(errno));
     exit(1);
   }
 
-  // Generate the pre-processor command
-  snprintf(cmd, TEXTLEN, "%s %s %s", CPPCMD, INCDIR, filename);
+  // as reads its standard input when given no input file
+  snprintf(cmd, TEXTLEN, "%s%s", ASCMD, objfile);
+  if (O_verbose)
+    fprintf(stderr, "%s | %s\n", QBEPIPECMD, cmd);
+  State.Aspid = run_cmd(cmd, aspipe[0], -1);
+  State.Qbepid = run_cmd(QBEPIPECMD, qbepipe[0], aspipe[1]);
+  close(qbepipe[0]);
+  close(aspipe[0]);
+  close(aspipe[1]);
+
+  // If qbe dies, we want an error from fwrite(), not a signal
+  signal(SIGPIPE, SIG_IGN);
+  if ((State.Outfh = fdopen(qbepipe[1], "w")) == NULL) {
+    fprintf(stderr, "Unable to open a pipe to qbe: %s\n", strerror(errno));
+    exit(1);
+  }
+}
 
-  // Open up the pre-processor pipe
-  if ((Infh = popen(cmd, "r")) == NULL) {
-    fprintf(stderr, "Unable to open %s: %s\n", filename, strerror(errno));
+// Wait for the command with the given pid and
+// return true if it exited successfully
+bool cmd_succeeded(pid_t pid) {
+  int status;
+
+  if (waitpid(pid, &status, 0) == -1)
+    return (false);
+  return (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+// Close the pipe to qbe and wait for qbe and as
+// to finish. Exit if either of them failed
+static void close_pipeline(char *filename) {
+  bool qbe_ok, as_ok;
+
+  fclose(State.Outfh);
+  State.Outfh = NULL;
+  qbe_ok = cmd_succeeded(State.Qbepid);
+  as_ok = cmd_succeeded(State.Aspid);
+  State.Qbepid = State.Aspid = 0;
+
+  if (!qbe_ok) {
+    fprintf(stderr, "QBE translation of %s failed\n", filename);
+    unlink(State.Outfilename);
+    exit(1);
+  }
+  if (!as_ok) {
+    fprintf(stderr, "Assembly of %s failed\n", filename);
+    unlink(State.Outfilename);
     exit(1);
   }
+}
+
+// We are stopping because of an error. If we are
+// piping the QBE code, stop qbe and as before they
+// see the incomplete code, and remove the object file
+void stop_pipeline(void) {
+  if (State.Qbepid == 0)
+    return;
+  kill(State.Qbepid, SIGTERM);
+  kill(State.Aspid, SIGTERM);
+  State.Qbepid = State.Aspid = 0;
+  State.Outfh = NULL;
+  unlink(State.Outfilename);
+}
 
-  Infilename = filename;
+// Given an input filename and its pre-processed text,
+// compile the text down to QBE code and return the new
+// file's name. If piped is true, pass the QBE code through
+// qbe and as and return the object file's name instead
+static char *do_compile(char *filename, char *text, size_t len, bool piped) {
 
-  // Create the output file
-  if ((Outfh = fopen(Outfilename, "w")) == NULL) {
-    fprintf(stderr, "Unable to create %s: %s\n", Outfilename,
-	    strerror(errno));
+  // Change the input file's suffix to .q, or .o
+  State.Outfilename = alter_suffix(filename, piped ? 'o' : 'q');
+  if (State.Outfilename == NULL) {
+    fprintf(stderr, "Error: %s has no suffix, try .al on the end\n", filename);
     exit(1);
   }
+  State.Infilename = filename;
 
-  // Reset the symbol table and the list of types
-  init_symtable();
-  init_typelist();
+  // Create the output file or the pipeline
+  if (piped)
+    open_pipeline(State.Outfilename);
+  else if ((State.Outfh = fopen(State.Outfilename, "w")) == NULL) {
+    fprintf(stderr, "Unable to create %s: %s\n", State.Outfilename,
+	    strerror(errno));
+    exit(1);
+  }
 
-  Line = 1;			// Reset the scanner
-  Linestart = 1;
-  Putback = 0;
+  // When timing, scan the input on its own first, as
+  // the scanning is otherwise mixed in with the parsing
+  if (O_logtime) {
+    time_phase(PH_SCAN);
+    lex_input(text, len);
+    while (scan(&State.Thistoken));
+  }
+  time_phase(PH_PARSE);
 
-  Peektoken.token = 0;		// Set there is no lookahead token
-  scan(&Thistoken);		// Get the first token from the input
+  lex_input(text, len);		// Reset the scanner
+  scan(&State.Thistoken);		// Get the first token from the input
 
-  // Dump the tokens and re-open the input file
+  // Dump the tokens and rescan the input
   if (O_dumptokens) {
     dumptokens();
-    fclose(Infh);
-    Infh = popen(cmd, "r");
-    Line = 1;
-    Linestart = 1;
-    Putback = 0;
-    Peektoken.token = 0;
-    scan(&Thistoken);
+    lex_input(text, len);
+    scan(&State.Thistoken);
   }
 
   if (O_verbose)
@@ -119,13 +215,35 @@ static char *do_compile(char *filename) {
 
   gen_file_preamble();		// Generate the output file preamble
   input_file();			// Parse the input file
+  time_phase(PH_GENAST);
+  if (O_unity)
+    gen_held_funcs();		// Output the used functions
   gen_strlits();		// Output any string literals
-  fclose(Outfh);		// Close the output file
+  emit_flush();			// Write out any buffered output
+  if (piped)
+    time_phase(PH_QBE);
+  if (piped)			// Close the output file
+    close_pipeline(filename);
+  else {
+    fclose(State.Outfh);
+    State.Outfh = NULL;
+  }
+  time_phase(PH_OTHER);
 
   if (O_dumpsyms)
     dumpsyms();
 
-  return (Outfilename);
+  if (O_logmisc) {
+    fprintf(Debugfh, "%zu bytes of QBE output\n", emit_bytes());
+    fprintf(Debugfh, "%d bounds checks removed\n", bounds_removed());
+    fprintf(Debugfh, "%d range checks removed\n", ranges_removed());
+    if (O_unity)
+      fprintf(Debugfh, "%d unused functions removed\n", funcs_removed());
+    arena_stats(State.Permarena);
+    arena_stats(State.Funcarena);
+  }
+
+  return (State.Outfilename);
 }
 
 // Given an input filename, run QBE on the file and
@@ -140,11 +258,18 @@ char *do_qbe(char *filename) {
     exit(1);
   }
 
+  // Split a file with many functions
+  // across several qbe processes
+  if (O_qbeshards > 1 && qbe_shards(filename, outfilename, O_qbeshards))
+    return (outfilename);
+
   // Build the QBE command and run it
   snprintf(cmd, TEXTLEN, "%s %s %s", QBECMD, outfilename, filename);
   if (O_verbose)
     fprintf(stderr, "%s\n", cmd);
+  time_phase(PH_QBE);
   err = system(cmd);
+  time_phase(PH_OTHER);
 
   if (err != 0) {
     fprintf(stderr, "QBE translation of %s failed\n", filename);
@@ -171,7 +296,9 @@ char *do_assemble(char *filename) {
   if (O_verbose)
     fprintf(stderr, "%s\n", cmd);
 
+  time_phase(PH_ASSEMBLE);
   err = system(cmd);
+  time_phase(PH_OTHER);
   if (err != 0) {
     fprintf(stderr, "Assembly of %s failed\n", filename);
     exit(1);
@@ -206,50 +333,389 @@ void do_link(char *outfilename, char **objlist) {
 
   if (O_verbose)
     fprintf(stderr, "%s\n", cmd);
+  time_phase(PH_LINK);
   err = system(cmd);
+  time_phase(PH_OTHER);
   if (err != 0) {
     fprintf(stderr, "Linking failed\n");
     exit(1);
   }
 }
 
+// Compile, translate and assemble the pre-processed
+// text of the given file as needed, then free the text.
+// Return the object file's name, or NULL if we are not
+// making an object file
+static char *compile_text(char *filename, char *text, size_t len) {
+  char *qbefile, *asmfile, *objfile = NULL;
+  char *key = NULL;
+  bool hit;
+
+  // See if we have the output in the cache. We don't
+  // use the cache when writing debug output, as that
+  // comes from the compilation
+  if (cache_enabled() && Debugfh == NULL) {
+    key = cache_key(text, len);
+    qbefile = alter_suffix(filename, 'q');
+    asmfile = alter_suffix(filename, 's');
+    objfile = alter_suffix(filename, 'o');
+    if (qbefile == NULL) {
+      fprintf(stderr, "Error: %s has no suffix, try .al on the end\n",
+	      filename);
+      exit(1);
+    }
+
+    if (O_qbeonly)
+      hit = cache_fetch(key, 'q', qbefile);
+    else if (O_keepasm)
+      hit = cache_fetch(key, 'q', qbefile) && cache_fetch(key, 's', asmfile);
+    else
+      hit = cache_fetch(key, 'o', objfile);
+    cache_count(hit);
+
+    if (hit) {
+      if (O_verbose)
+	fprintf(stderr, "cache hit for %s\n", filename);
+      free(text);
+      return ((O_keepasm || O_qbeonly) ? NULL : objfile);
+    }
+    objfile = NULL;
+  }
+
+  // Pipe the QBE code straight through to
+  // an object file if we don't need to keep it
+  if (O_pipe && !O_keepasm && !O_qbeonly) {
+    objfile = do_compile(filename, text, len, true);
+    if (key != NULL)
+      cache_store(key, 'o', objfile);
+    free(text);
+    return (objfile);
+  }
+
+  qbefile = do_compile(filename, text, len, false);	// Compile the source file
+  free(text);
+  if (O_qbeonly) {
+    if (key != NULL)
+      cache_store(key, 'q', qbefile);
+    return (NULL);
+  }
+  asmfile = do_qbe(qbefile);		// Create the assembly file
+
+  if (O_dolink || O_assemble)
+    objfile = do_assemble(asmfile);	// Assemble it to object form
+
+  // Save the results in the cache
+  if (key != NULL) {
+    if (O_keepasm) {
+      cache_store(key, 'q', qbefile);
+      cache_store(key, 's', asmfile);
+    } else
+      cache_store(key, 'o', objfile);
+  }
+
+  if (!O_keepasm) {		// Remove the QBE and assembly files
+    unlink(qbefile);		// if we don't need to keep them
+    unlink(asmfile);
+  }
+  return (objfile);
+}
+
+// Compile, translate and assemble the given file
+// as needed. Return the object file's name, or NULL
+// if we are not making an object file
+static char *compile_file(char *filename) {
+  char *text;
+  size_t len;
+
+  state_reset();
+
+  // Pre-process the input file. The
+  // lexer scans the result in memory
+  State.Infilename = filename;
+  time_phase(PH_PREPROC);
+  text = preprocess(filename, &len);
+  time_phase(PH_OTHER);
+  if (text == NULL) {
+    fprintf(stderr, "Unable to open %s: %s\n", filename, strerror(errno));
+    exit(1);
+  }
+  return (compile_text(filename, text, len));
+}
+
+// Compile all the files as one program into the
+// output file of the first one. The files are
+// pre-processed in turn, keeping the macros from
+// the earlier files' headers so that headers with
+// include guards are only parsed once. The parser
+// then sees one text with one symbol table and one
+// pool of string literals. A # unit "file" marker
+// starts each file, so that the parser can hide the
+// private globals of the file before it. Return the
+// object file's name, or NULL if we are not making
+// an object file
+static char *compile_unity(char **files, int nfiles) {
+  char *text = NULL, *ftext;
+  char marker[TEXTLEN + 16];
+  size_t len = 0, flen, mlen;
+  int i;
+
+  state_reset();
+  time_phase(PH_PREPROC);
+  for (i = 0; i < nfiles; i++) {
+    State.Infilename = files[i];
+    if (i == 0)
+      ftext = preprocess(files[i], &flen);
+    else
+      ftext = preprocess_more(files[i], &flen);
+    if (ftext == NULL) {
+      fprintf(stderr, "Unable to open %s: %s\n", files[i], strerror(errno));
+      exit(1);
+    }
+
+    // Each file's text starts with a line
+    // marker, so the line numbers stay right
+    snprintf(marker, sizeof(marker), "# unit \"%s\"\n", files[i]);
+    mlen = strlen(marker);
+    text = (char *) realloc(text, len + mlen + flen + 1);
+    if (text == NULL)
+      fatal("Malloc failure\n");
+    memcpy(text + len, marker, mlen);
+    memcpy(text + len + mlen, ftext, flen);
+    len += mlen + flen;
+    text[len] = '\0';
+    free(ftext);
+  }
+  time_phase(PH_OTHER);
+
+  return (compile_text(files[0], text, len));
+}
+
+// Set up this thread's compiler state
+void state_init(void) {
+  State.Line = 1;
+  State.nexttemp = 1;
+  State.labelid = 1;
+  State.Permarena = new_arena("global");
+  State.Funcarena = new_arena("function");
+  State.Thisarena = State.Permarena;
+  init_typelist();
+  init_symtable();
+}
+
+// Free everything that this thread's compiler state
+// holds and set it back to zero. The output file's
+// name is kept by whoever asked for the compile
+void state_free(void) {
+  pp_free();
+  free_symtable();
+  free_strlits();
+  free_heldfuncs();
+  free(State.Strlentemps);
+  free(State.Addrsyms);
+  free(State.Rtypes);
+  free_arena(State.Permarena);
+  free_arena(State.Funcarena);
+  memset(&State, 0, sizeof(State));
+}
+
+// Start this thread's compiler state afresh
+void state_reset(void) {
+  state_free();
+  state_init();
+}
+
+// Compile the given file in this thread, as compile_file()
+// does, but return false on a compile error instead of
+// exiting. Each thread has its own compiler state, so
+// several threads can call this at once
+bool alic_compile(char *filename) {
+  jmp_buf env;
+
+  // On an error, remove any partly-written output file
+  if (setjmp(env) != 0) {
+    fatal_jump(NULL);
+    if (State.Outfh != NULL) {
+      fclose(State.Outfh);
+      State.Outfh = NULL;
+      unlink(State.Outfilename);
+    }
+    return (false);
+  }
+
+  fatal_jump(&env);
+  compile_file(filename);
+  fatal_jump(NULL);
+  return (true);
+}
+
+// The files for the compiler threads, the next
+// one to compile, and if any of them have failed
+static char **Poolfiles;
+static int Poolcount;
+static int Poolnext;
+static bool Poolfailed;
+static pthread_mutex_t Poollock = PTHREAD_MUTEX_INITIALIZER;
+
+// A compiler thread: compile files until there
+// are none left or until one of them fails
+static void *compile_worker(void *arg) {
+  int i;
+
+  while (1) {
+    pthread_mutex_lock(&Poollock);
+    i = (Poolfailed || Poolnext == Poolcount) ? -1 : Poolnext++;
+    pthread_mutex_unlock(&Poollock);
+    if (i == -1)
+      break;
+
+    if (alic_compile(Poolfiles[i]) == false) {
+      pthread_mutex_lock(&Poollock);
+      Poolfailed = true;
+      pthread_mutex_unlock(&Poollock);
+    }
+  }
+  state_free();
+  return (NULL);
+}
+
+// Compile the files on up to nthreads threads. Once a
+// file fails, the threads finish the files they are on
+// and stop. Return true if all the files compiled
+bool alic_compile_all(char **files, int nfiles, int nthreads) {
+  pthread_t *threads;
+  pthread_attr_t attr;
+  int i;
+
+  Poolfiles = files;
+  Poolcount = nfiles;
+  Poolnext = 0;
+  Poolfailed = false;
+  if (nthreads > nfiles)
+    nthreads = nfiles;
+  threads = (pthread_t *) Calloc(nthreads * sizeof(pthread_t));
+
+  // The parser and the code generator recurse on deeply
+  // nested code, so the threads need a large stack
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, THREADSTACK);
+  for (i = 0; i < nthreads; i++)
+    if (pthread_create(&threads[i], &attr, compile_worker, NULL) != 0) {
+      fprintf(stderr, "Unable to start a compiler thread\n");
+      exit(1);
+    }
+  for (i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+
+  pthread_attr_destroy(&attr);
+  free(threads);
+  return (!Poolfailed);
+}
+
+// Precompile the named header file into a .ahc file.
+// The header must only have declarations
+static void do_precompile(char *filename) {
+  char *text;
+  size_t len, start;
+
+  state_reset();
+
+  // Pre-process the header, recording what it needs
+  State.Infilename = filename;
+  pp_record();
+  text = preprocess(filename, &len);
+  if (text == NULL) {
+    fprintf(stderr, "Unable to open %s: %s\n", filename, strerror(errno));
+    exit(1);
+  }
+
+  // Parse it with no output file, and
+  // check that it generates no code
+  State.Outfh = NULL;
+  lex_input(text, len);
+  scan(&State.Thistoken);
+  gen_file_preamble();
+  start = emit_bytes();
+  input_file();
+  gen_strlits();
+  if (emit_bytes() != start) {
+    fprintf(stderr, "Unable to precompile %s: it generates code\n",
+	    filename);
+    exit(1);
+  }
+
+  pch_write(filename);
+  free(text);
+}
+
 // Print out a usage if started incorrectly
 static void usage(char *prog) {
-  fprintf(stderr, "Usage: %s [-vcSB] [-o outfile] ", prog);
+  fprintf(stderr, "Usage: %s [-vcqSBPHU] [-j jobs] [-Q shards] [-C cachedir] [-o outfile] ", prog);
   fprintf(stderr, "[-D debugfile] [-L logflags] file [file ...]\n");
   fprintf(stderr,
 	  "       -v give verbose output of the compilation stages\n");
   fprintf(stderr, "       -c generate object files but don't link them\n");
+  fprintf(stderr, "       -q generate QBE files but don't translate them\n");
   fprintf(stderr, "       -S generate assembly files but don't link them\n");
   fprintf(stderr, "       -B disable array bounds checking\n");
+  fprintf(stderr,
+	  "       -P pipe the QBE code through qbe and as, with no .q/.s files\n");
+  fprintf(stderr,
+	  "       -H precompile the header files, making .ahc files\n");
+  fprintf(stderr,
+	  "       -U compile all the files as one program, named after the first\n");
+  fprintf(stderr, "       -j jobs, compile this many files at once\n");
+  fprintf(stderr,
+	  "       -Q shards, split each file over this many qbe processes\n");
+  fprintf(stderr, "       -C cachedir, keep compiled files in this cache,\n");
+  fprintf(stderr,
+	  "          up to ALIC_CACHESIZE kilobytes (default 524288)\n");
   fprintf(stderr, "       -o outfile, produce the outfile executable file\n");
   fprintf(stderr, "       -D debugfile, write debug info to this file\n");
   fprintf(stderr, "       -L logflags, set the log flags for debugging:\n");
-  fprintf(stderr, "          one or more of tok,sym,ast,misc\n");
+  fprintf(stderr, "          one or more of tok,sym,ast,misc,time\n");
   fprintf(stderr, "          comma separated\n");
+  fprintf(stderr, "   or: %s --server socket [megabytes]\n", prog);
+  fprintf(stderr,
+	  "       run a compiler server, used when ALIC_SERVER=socket,\n");
+  fprintf(stderr,
+	  "       which forks a process for each compile with a memory\n");
+  fprintf(stderr,
+	  "       limit (default 1024). It only reads the .ahc files\n");
+  fprintf(stderr,
+	  "       once: each compile still loads the headers it includes\n");
   exit(1);
 }
 
-// Main program: check arguments and print a usage
-// if we don't have an argument.
+// The compiler proper: check arguments and print a
+// usage if we don't have an argument.
 // Then do the compilation actions.
 #define MAXOBJ 100
 
-int main(int argc, char *argv[]) {
+int alic_main(int argc, char *argv[]) {
   char *outfilename = AOUT;
-  char *qbefile, *asmfile, *objfile;
+  char *objfile;
   char *objlist[MAXOBJ];
   int i, objcnt = 0;
   int opt;
 
   // Get any flag values
-  while ((opt = getopt(argc, argv, "vcSBD:L:o:")) != -1) {
+  while ((opt = getopt(argc, argv, "vcqSBPHUC:D:L:Q:j:o:")) != -1) {
     switch (opt) {
     case 'c':
       O_assemble = true;
       O_keepasm = false;
+      O_qbeonly = false;
+      O_dolink = false;
+      break;
+    case 'q':
+      O_qbeonly = true;
+      O_keepasm = false;
+      O_assemble = false;
       O_dolink = false;
       break;
+    case 'C':
+      cache_init(optarg);
+      break;
     case 'D':
       Debugfh = fopen(optarg, "w");
       if (Debugfh == NULL) {
@@ -266,15 +732,37 @@ int main(int argc, char *argv[]) {
 	O_dumpast = true;
       if (strstr(optarg, "misc"))
 	O_logmisc = true;
+      if (strstr(optarg, "time"))
+	O_logtime = true;
       break;
     case 'S':
       O_keepasm = true;
+      O_qbeonly = false;
       O_assemble = false;
       O_dolink = false;
       break;
     case 'B':
       O_boundscheck = false;
       break;
+    case 'P':
+      O_pipe = true;
+      break;
+    case 'H':
+      O_precompile = true;
+      break;
+    case 'U':
+      O_unity = true;
+      break;
+    case 'j':
+      O_jobs = atoi(optarg);
+      if (O_jobs < 1)
+	usage(argv[0]);
+      break;
+    case 'Q':
+      O_qbeshards = atoi(optarg);
+      if (O_qbeshards < 1)
+	usage(argv[0]);
+      break;
     case 'o':
       outfilename = strdup(optarg);	// Get the output filename
       break;
@@ -292,31 +780,54 @@ int main(int argc, char *argv[]) {
   }
 
   // Ensure we have at least one input file argument
-  if ((argc - optind) != 1)
+  if (optind >= argc)
     usage(argv[0]);
+  if (argc - optind > MAXOBJ - 2) {
+    fprintf(stderr, "Too many object files for the compiler\n");
+    exit(1);
+  }
 
-  // Work on each input file in turn
-  while (optind < argc) {
-    qbefile = do_compile(argv[optind]);	// Compile the source file
-    asmfile = do_qbe(qbefile);	// Create the assembly file
+  // Precompile header files instead of compiling
+  if (O_precompile) {
+    for (i = optind; i < argc; i++)
+      do_precompile(argv[i]);
+    exit(0);
+  }
 
-    if (O_dolink || O_assemble) {
-      objfile = do_assemble(asmfile);	// Assemble it to object form
-      if (objcnt == (MAXOBJ - 2)) {
-	fprintf(stderr, "Too many object files for the compiler\n");
+  // Work out the object files' names. They are linked
+  // in the order given, however the files are compiled
+  if (O_dolink || O_assemble) {
+    for (i = optind; i < argc; i++) {
+      if (O_unity && i > optind)
+	break;
+      objfile = alter_suffix(argv[i], 'o');
+      if (objfile == NULL) {
+	fprintf(stderr, "Error: %s has no suffix, try .al on the end\n",
+		argv[i]);
 	exit(1);
       }
-
-      objlist[objcnt++] = objfile;	// Add the object file's name
-      objlist[objcnt] = NULL;	// to the list of object files
-    }
-
-    if (!O_keepasm) {		// Remove the QBE and assembly files
-      unlink(qbefile);		// if we don't need to keep them
-      unlink(asmfile);
+      objlist[objcnt++] = objfile;
     }
-    optind++;
   }
+  objlist[objcnt] = NULL;
+
+  // Start the phase timing
+  time_phase(PH_OTHER);
+
+  // Work on each input file in turn, or in parallel.
+  // Keep the debug output in order, and the timing
+  // in this process, by doing one at a time
+  if (O_unity)
+    compile_unity(argv + optind, argc - optind);
+  else if (O_jobs > 1 && argc - optind > 1 && Debugfh == NULL && !O_logtime) {
+    if (alic_compile_all(argv + optind, argc - optind, O_jobs) == false)
+      exit(1);
+  } else
+    for (i = optind; i < argc; i++)
+      compile_file(argv[i]);
+
+  if (O_verbose && cache_enabled())
+    cache_stats(stderr);
 
   // Now link all the object files together
   if (O_dolink) {
@@ -330,5 +841,28 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (O_logtime)
+    time_report();
   exit(0);
 }
+
+// Main program. Run the compiler server, or pass the
+// command line to the server if ALIC_SERVER names one
+// that we can reach, or else compile here
+int main(int argc, char *argv[]) {
+  char *server;
+  int status;
+
+  if (argc >= 3 && !strcmp(argv[1], "--server")) {
+    if (argc > 4)
+      usage(argv[0]);
+    unsetenv("ALIC_SERVER");
+    run_server(argv[2], (argc == 4) ? atol(argv[3]) : 0);
+  }
+
+  server = getenv("ALIC_SERVER");
+  if (server != NULL && *server != '\0' &&
+      run_client(server, argc, argv, &status))
+    exit(status);
+  return (alic_main(argc, argv));
+}
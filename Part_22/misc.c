@@ -1,18 +1,40 @@
 // Miscellaneous functions for the alic compiler.
 // (c) 2025 Warren Toomey, GPL3
 
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include "alic.h"
 #include "proto.h"
 
+// If set, a fatal error in this thread
+// jumps back here instead of exiting
+static _Thread_local jmp_buf *Fatalenv = NULL;
+
+// Set where a fatal error in this thread jumps
+// back to, or exit on an error if env is NULL
+void fatal_jump(jmp_buf * env) {
+  Fatalenv = env;
+}
+
+// Stop compiling after a fatal error
+static void fatal_stop(void) {
+  stop_pipeline();
+  emit_flush();
+  if (Fatalenv != NULL)
+    longjmp(*Fatalenv, 1);
+  exit(1);
+}
+
 // Print out fatal messages
 void fatal(const char *fmt, ...) {
   va_list ptr;
 
   va_start(ptr, fmt);
-  fprintf(stderr, "%s line %d: ", Infilename, Line);
+  fprintf(stderr, "%s line %d: ", State.Infilename, State.Line);
   vfprintf(stderr, fmt, ptr);
   va_end(ptr);
-  exit(1);
+  fatal_stop();
 }
 
 // Print out fatal messages with a specific line numbner
@@ -20,10 +42,10 @@ void lfatal(int line, const char *fmt, ...) {
   va_list ptr;
 
   va_start(ptr, fmt);
-  fprintf(stderr, "%s line %d: ", Infilename, line);
+  fprintf(stderr, "%s line %d: ", State.Infilename, line);
   vfprintf(stderr, fmt, ptr);
   va_end(ptr);
-  exit(1);
+  fatal_stop();
 }
 
 // Print out a "cannot do" error based on an ASTnode's type
@@ -53,6 +75,90 @@ void *Calloc(size_t size) {
   return (ptr);
 }
 
+// Make a new, empty, arena
+Arena *new_arena(char *name) {
+  Arena *a = (Arena *) Calloc(sizeof(Arena));
+  a->name = name;
+  return (a);
+}
+
+// Allocate zeroed memory from an arena
+void *Aalloc(Arena * a, size_t size) {
+  Arenablk *blk;
+  size_t blksize;
+  void *ptr;
+
+  // Keep everything 8-byte aligned
+  size = (size + 7) & ~((size_t) 7);
+
+  // Find a block with enough space, starting
+  // with the one we are allocating from
+  for (blk = a->cur; blk != NULL; blk = blk->next)
+    if (blk->used + size <= blk->size)
+      break;
+
+  // None, so add a new block to the end of the arena
+  if (blk == NULL) {
+    blksize = (size > ARENABLKSIZE) ? size : ARENABLKSIZE;
+    blk = (Arenablk *) Malloc(sizeof(Arenablk) + blksize);
+    blk->size = blksize;
+    blk->used = 0;
+    blk->next = NULL;
+    if (a->head == NULL)
+      a->head = blk;
+    else
+      a->tail->next = blk;
+    a->tail = blk;
+  }
+
+  a->cur = blk;
+  ptr = blk->mem + blk->used;
+  blk->used += size;
+  memset(ptr, 0, size);
+
+  // Update the stats
+  a->inuse += size;
+  a->total += size;
+  if (a->inuse > a->peak)
+    a->peak = a->inuse;
+  return (ptr);
+}
+
+// Release everything allocated from an arena.
+// We keep the blocks to use them again
+void release_arena(Arena * a) {
+  Arenablk *blk;
+
+  for (blk = a->head; blk != NULL; blk = blk->next)
+    blk->used = 0;
+  a->cur = a->head;
+  a->inuse = 0;
+}
+
+// Free an arena and all of its blocks
+void free_arena(Arena * a) {
+  Arenablk *blk, *next;
+
+  if (a == NULL)
+    return;
+  for (blk = a->head; blk != NULL; blk = next) {
+    next = blk->next;
+    free(blk);
+  }
+  free(a);
+}
+
+// Print out the stats for an arena
+void arena_stats(Arena * a) {
+  Arenablk *blk;
+  size_t held = 0;
+
+  for (blk = a->head; blk != NULL; blk = blk->next)
+    held += blk->size;
+  fprintf(Debugfh, "%s arena: %zu bytes allocated, %zu peak, %zu held\n",
+	  a->name, a->total, a->peak, held);
+}
+
 // The djb2 hash function comes from
 // http://www.cse.yorku.ca/~oz/hash.html
 // No copyright is given for it.
@@ -71,3 +177,111 @@ uint64_t djb2hash(uint8_t * str) {
 
   return (hash);
 }
+
+// Return a string which identifies this build of the
+// compiler. We can't tell if the compiler has changed
+// by its version, so use the size and time of its binary
+char *compiler_id(void) {
+  static _Thread_local char id[TEXTLEN];
+  struct stat sb;
+
+  if (id[0] != '\0')
+    return (id);
+  if (stat("/proc/self/exe", &sb) == 0)
+    snprintf(id, sizeof(id), "%ld %ld", (long) sb.st_size,
+	     (long) sb.st_mtime);
+  else
+    snprintf(id, sizeof(id), "%s %s", __DATE__, __TIME__);
+  return (id);
+}
+
+// The wall and CPU time spent in each phase, for -L time.
+// The qbe, as and link phases also include the CPU time
+// of the child processes which they run
+static char *Phasename[PH_MAX] = {
+  "other", "preprocess", "scan", "parse", "optAST",
+  "genAST", "qbe", "as", "link"
+};
+
+static _Thread_local double Phasewall[PH_MAX];
+static _Thread_local double Phasecpu[PH_MAX];
+static _Thread_local int Thisphase = PH_OTHER;
+static _Thread_local double Lastwall = 0;	// Times when we entered this phase
+static _Thread_local double Lastcpu = 0;
+static _Thread_local double Lastchild = 0;
+
+// Return the time on the given clock in seconds
+static double get_time(clockid_t clock) {
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+  return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// Return the CPU time used by the child
+// processes that have finished, in seconds
+static double child_time(void) {
+  struct rusage ru;
+
+  getrusage(RUSAGE_CHILDREN, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	  (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6);
+}
+
+// Return true if the phase runs child processes
+static bool is_child_phase(int phase) {
+  return (phase == PH_QBE || phase == PH_ASSEMBLE || phase == PH_LINK);
+}
+
+// Move into the given phase, charging the time since the
+// last change to the old phase. Return the old phase
+int time_phase(int phase) {
+  double wall, cpu;
+  int old = Thisphase;
+
+  if (!O_logtime)
+    return (old);
+
+  wall = get_time(CLOCK_MONOTONIC);
+  cpu = get_time(CLOCK_PROCESS_CPUTIME_ID);
+  if (Lastwall != 0) {
+    Phasewall[old] += wall - Lastwall;
+    Phasecpu[old] += cpu - Lastcpu;
+    if (is_child_phase(old))
+      Phasecpu[old] += child_time() - Lastchild;
+  }
+  if (is_child_phase(phase))
+    Lastchild = child_time();
+
+  Lastwall = wall;
+  Lastcpu = cpu;
+  Thisphase = phase;
+  return (old);
+}
+
+// Return the file handle for the -L time output
+FILE *time_fh(void) {
+  return (Debugfh != NULL ? Debugfh : stderr);
+}
+
+// Print out the time spent in each phase
+// and the peak memory use
+void time_report(void) {
+  FILE *fh = time_fh();
+  double totwall = 0, totcpu = 0;
+  struct rusage ru;
+  int i;
+
+  time_phase(PH_OTHER);
+  fprintf(fh, "%-12s %10s %10s\n", "phase", "wall", "cpu");
+  for (i = 0; i < PH_MAX; i++) {
+    fprintf(fh, "%-12s %10.4f %10.4f\n", Phasename[i],
+	    Phasewall[i], Phasecpu[i]);
+    totwall += Phasewall[i];
+    totcpu += Phasecpu[i];
+  }
+  fprintf(fh, "%-12s %10.4f %10.4f\n", "total", totwall, totcpu);
+
+  getrusage(RUSAGE_SELF, &ru);
+  fprintf(fh, "peak RSS %ld KB\n", ru.ru_maxrss);
+}
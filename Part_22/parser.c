@@ -68,9 +68,6 @@ static ASTnode *cast_expression(void);
 static ASTnode *exists_expression(void);
 static ASTnode *postfix_variable(ASTnode * this);
 
-// Global variables
-Sym *Thisfunction;		// The function we are parsing
-
 // Parse the input file
 //
 //- input_file= ( type_declaration
@@ -84,8 +81,14 @@ void input_file(void) {
   int visibility;
 
   // Loop parsing global declarations until we hit the EOF
-  while (Thistoken.token != T_EOF) {
-    switch (Thistoken.token) {
+  while (State.Thistoken.token != T_EOF) {
+    // With -U, we may now be in the next file
+    if (State.Nextunit != NULL) {
+      new_unit(State.Nextunit);
+      State.Nextunit = NULL;
+    }
+
+    switch (State.Thistoken.token) {
     case T_TYPE:
       type_declaration();
       break;
@@ -104,7 +107,7 @@ void input_file(void) {
 
       // Look at the next token to determine
       // what sort of declaration this is
-      switch(Thistoken.token) {
+      switch(State.Thistoken.token) {
 	case T_LPAREN:					// A function
 	  // Functions cannot be declared const
 	  if (decl->is_const== true)
@@ -142,23 +145,23 @@ static int64_t integer_constant(void) {
   Sym *sym;
   int64_t val;
 
-  switch(Thistoken.token) {
+  switch(State.Thistoken.token) {
     case T_NUMLIT:
-      if (Thistoken.litval.numtype == NUM_FLT)
+      if (State.Thistoken.litval.numtype == NUM_FLT)
 	fatal("Cannot use a float literal here\n");
-      val= Thistoken.litval.intval;
+      val= State.Thistoken.litval.intval;
       break;
     case T_IDENT:
-      sym= find_symbol(Thistoken.tokstr);
+      sym= find_symbol(State.Thistoken.tokstr);
       if (sym == NULL || sym->symtype != ST_ENUM)
-	fatal("Unrecognised enum name %s\n", Thistoken.tokstr);
+	fatal("Unrecognised enum name %s\n", State.Thistoken.tokstr);
       val= sym->count;
       break;
     default:
       fatal("Need either an integer literal value or an enum name\n");
   }
 
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   return(val);
 }
 
@@ -170,26 +173,26 @@ static void type_declaration(void) {
   int64_t upper=0;
 
   // Skip the TYPE keyword
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
-  if (Thistoken.token != T_IDENT)
+  if (State.Thistoken.token != T_IDENT)
     fatal("Expecting a name after \"type\"\n");
 
   // Get the type's name
-  typename = Thistoken.tokstr;
+  typename = State.Thistoken.tokstr;
 
   // Skip the identifier
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // If the next token is an '='
-  if (Thistoken.token == T_ASSIGN) {
+  if (State.Thistoken.token == T_ASSIGN) {
     // Skip the '='
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 
     // We have a function pointer type
-    if (Thistoken.token == T_FUNCPTR) {
+    if (State.Thistoken.token == T_FUNCPTR) {
       funcptr_declaration(typename);
-    } else if (Thistoken.token == T_STRUCT) {
+    } else if (State.Thistoken.token == T_STRUCT) {
       // If the next token is STRUCT
       // Parse the struct list
       struct_declaration(typename);
@@ -203,8 +206,8 @@ static void type_declaration(void) {
 
       // Do we have a RANGE token? If so, parse
       // and get the lower and upper range
-      if (Thistoken.token == T_RANGE) {
-	scan(&Thistoken);
+      if (State.Thistoken.token == T_RANGE) {
+	scan(&State.Thistoken);
 	lower= integer_constant();
 	match(T_ELLIPSIS, true);
 	upper= integer_constant();
@@ -265,17 +268,17 @@ static Paramtype *type_list(void) {
     is_const= false; is_inout= false;
 
     // Stop if we see an ELLIPSIS
-    if (Thistoken.token == T_ELLIPSIS) break;
+    if (State.Thistoken.token == T_ELLIPSIS) break;
 
     // See if the declaration is marked const
-    if (Thistoken.token == T_CONST) {
-      scan(&Thistoken);
+    if (State.Thistoken.token == T_CONST) {
+      scan(&State.Thistoken);
       is_const= true;
     }
 
     // See if the declaration is marked inout
-    if (Thistoken.token == T_INOUT) {
-      scan(&Thistoken);
+    if (State.Thistoken.token == T_INOUT) {
+      scan(&State.Thistoken);
       is_inout= true;
     }
 
@@ -287,6 +290,7 @@ static Paramtype *type_list(void) {
     this->type= ty;
     this->is_const= is_const;
     this->is_inout= is_inout;
+    this->next= NULL;
 
     // Add it to the linked list
     if (head==NULL) {
@@ -296,8 +300,8 @@ static Paramtype *type_list(void) {
     }
 
     // Stop when the next token isn't a comma
-    if (Thistoken.token != T_COMMA) break;
-    scan(&Thistoken);
+    if (State.Thistoken.token != T_COMMA) break;
+    scan(&State.Thistoken);
   }
   
   return(head);
@@ -313,7 +317,7 @@ static void funcptr_declaration(char *typename) {
 
   // Skip the FUNCPTR keyword.
   // Get the return type and the '('
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   rettype = match_type(false);
   lparen();
 
@@ -322,9 +326,9 @@ static void funcptr_declaration(char *typename) {
 
   // If the next token is an ELLIPSIS,
   // the function pointer is variadic
-  if (Thistoken.token == T_ELLIPSIS) {
+  if (State.Thistoken.token == T_ELLIPSIS) {
     is_variadic= true;
-    scan(&Thistoken);
+    scan(&State.Thistoken);
   }
 
   // Get the ')'
@@ -332,8 +336,8 @@ static void funcptr_declaration(char *typename) {
 
   // If we have a "throws", skip it
   // and get the exception type
-  if (Thistoken.token == T_THROWS) {
-    scan(&Thistoken);
+  if (State.Thistoken.token == T_THROWS) {
+    scan(&State.Thistoken);
     excepttype = match_type(false);
 
     // The type must be a pointer to a struct which
@@ -374,7 +378,7 @@ static void enum_declaration(void) {
   char *name;
 
   // Skip the ENUM keyword and get the left brace
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lbrace();
 
   // Loop getting the next enum item
@@ -383,23 +387,23 @@ static void enum_declaration(void) {
   while (1) {
     // Make sure that we have an identifier
     match(T_IDENT, true);
-    name = Thistoken.tokstr;
+    name = State.Thistoken.tokstr;
 
     // If it's followed by an '='
-    if (Thistoken.token == T_ASSIGN) {
+    if (State.Thistoken.token == T_ASSIGN) {
       // Skip it and get the following numeric literal token
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       match(T_NUMLIT, false);
 
       // Check that the literal value isn't a float
-      if (Thistoken.litval.numtype == NUM_FLT)
+      if (State.Thistoken.litval.numtype == NUM_FLT)
 	fatal("Cannot use a float literal as an enumerated value\n");
 
       // Update val to hold this literal value
-      val.intval = Thistoken.litval.intval;
+      val.intval = State.Thistoken.litval.intval;
 
       // Skip the literal value
-      scan(&Thistoken);
+      scan(&State.Thistoken);
     }
 
     // Get a suitable type for the literal value
@@ -417,7 +421,7 @@ static void enum_declaration(void) {
 
     // If we have a right brace, stop looping.
     // Otherwise check for and absorb a comma
-    if (Thistoken.token == T_RBRACE)
+    if (State.Thistoken.token == T_RBRACE)
       break;
     match(T_COMMA, true);
   }
@@ -437,7 +441,7 @@ static void enum_declaration(void) {
 static int add_memb_to_struct(Type * strtype, ASTnode * asthead,
 			      int offset, bool isunion) {
   ASTnode *astmemb;
-  Sym *thismemb, *lastmemb;
+  Sym *thismemb;
   int biggest_memb = 0;
   ASTnode *astbiggest;
   int size;
@@ -471,15 +475,10 @@ static int add_memb_to_struct(Type * strtype, ASTnode * asthead,
       fatal("Member of type %s cannot be in a struct\n",
 	    get_typename(astmemb->type));
 
-    // Walk the existing members to a) check that we don't have
-    // duplicate member names, and b) get a pointer to the last
-    // member currently in the struct
-    for (lastmemb = thismemb = strtype->memb; thismemb != NULL;
-	 lastmemb = thismemb, thismemb = thismemb->next) {
-      if (!strcmp(thismemb->name, astmemb->strlit))
-	fatal("Duplicate member name %s in struct declaration\n",
-	      thismemb->name);
-    }
+    // Check that we don't have duplicate member names
+    if (find_member(strtype, astmemb->strlit) != NULL)
+      fatal("Duplicate member name %s in struct declaration\n",
+	    astmemb->strlit);
 
     // It's safe to add the astmemb to the struct.
     // Determine the size of the member. Deal with
@@ -499,7 +498,7 @@ static int add_memb_to_struct(Type * strtype, ASTnode * asthead,
     }
 
     // Create the Sym struct, add the name and type
-    thismemb = (Sym *) Calloc(sizeof(Sym));
+    thismemb = (Sym *) Aalloc(State.Permarena, sizeof(Sym));
     thismemb->name = astmemb->strlit;
     thismemb->type = astmemb->type;
     thismemb->is_const = astmemb->is_const;
@@ -516,7 +515,7 @@ static int add_memb_to_struct(Type * strtype, ASTnode * asthead,
     // Is this the first member?
     if (strtype->memb == NULL) {
       thismemb->offset = 0;
-      strtype->memb = thismemb;
+      add_member(strtype, thismemb, NULL);
       if (O_logmisc)
 	fprintf(Debugfh, "%s member %s: offset %d size %d\n",
 		get_typename(thismemb->type),
@@ -532,7 +531,7 @@ static int add_memb_to_struct(Type * strtype, ASTnode * asthead,
       if (isunion == false)
         offset = genalign(astmemb->type, offset);
       thismemb->offset = offset;
-      lastmemb->next = thismemb;
+      add_member(strtype, thismemb, State.lastmemb);
 
       // Update the offset if not a union
       if (isunion == false)
@@ -543,6 +542,7 @@ static int add_memb_to_struct(Type * strtype, ASTnode * asthead,
 	      get_typename(thismemb->type),
 	      thismemb->name, thismemb->offset, size);
     }
+    State.lastmemb = thismemb;
   }
 
   // Now return the possible offset of the next member
@@ -573,7 +573,7 @@ static void struct_declaration(char *typename) {
   int offset = 0;
 
   // Skip the STRUCT keyword and get the left brace
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lbrace();
 
   // Build a new STRUCT type
@@ -584,7 +584,7 @@ static void struct_declaration(char *typename) {
   // Loop getting members for the struct
   while (1) {
     // Is the next token a UNION?
-    if (Thistoken.token == T_UNION) {
+    if (State.Thistoken.token == T_UNION) {
       // Get the union declaration
       // and add the members to the struct
       astmemb = union_declaration();
@@ -597,11 +597,11 @@ static void struct_declaration(char *typename) {
     }
 
     // If no comma, stop now
-    if (Thistoken.token != T_COMMA)
+    if (State.Thistoken.token != T_COMMA)
       break;
 
     // Skip the comma
-    scan(&Thistoken);
+    scan(&State.Thistoken);
   }
 
   // Set the struct size in bytes
@@ -621,7 +621,7 @@ static ASTnode *union_declaration(void) {
   ASTnode *astmemb;
 
   // Skip the UNION keyword and get the left brace
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lbrace();
 
   astmemb = typed_declaration_list();
@@ -638,19 +638,34 @@ static ASTnode *union_declaration(void) {
 //-
 static int get_visibility(void) {
   int visibility = SV_PRIVATE;
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_PUBLIC:
     visibility = SV_PUBLIC;
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     break;
   case T_EXTERN:
     visibility = SV_EXTERN;
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     break;
   }
   return (visibility);
 }
 
+// Return true if an existing symbol has the same array
+// dimensions, or associative array key type, as a declaration
+static bool same_dimensions(Sym * sym, ASTnode * decl) {
+  int i;
+
+  if (decl->is_array == false)
+    return (sym->dimensions == 0 && sym->keytype == decl->keytype);
+  if (sym->dimensions != decl->dimensions)
+    return (false);
+  for (i = 0; i < sym->dimensions; i++)
+    if (sym->dimsize[i] != decl->dimsize[i])
+      return (false);
+  return (true);
+}
+
 // Parse a global variable declaration.
 // We receive the typed_declaration in decl
 //
@@ -661,12 +676,22 @@ void global_var_declaration(ASTnode * decl, int visibility) {
   ASTnode *init = NULL;
   Sym *sym;
 
-  // See if the variable's name already exists
-  if (find_symbol(decl->strlit) != NULL)
-    fatal("Symbol %s already exists\n", decl->strlit);
-
-  // Add the symbol and type as a global
-  sym = add_symbol(decl->strlit, ST_VARIABLE, decl->type, visibility);
+  // See if the variable's name already exists. An external
+  // variable can be defined later as a public one of the
+  // same type, e.g. when the files of a program are all
+  // compiled together and they share a header file. The
+  // header can declare it const for the other files
+  sym = find_symbol(decl->strlit);
+  if (sym != NULL) {
+    if (sym->symtype != ST_VARIABLE || sym->visibility != SV_EXTERN ||
+	visibility != SV_PUBLIC || sym->type != decl->type ||
+	(decl->is_const && !sym->is_const) || !same_dimensions(sym, decl))
+      fatal("Symbol %s already exists\n", decl->strlit);
+    sym->visibility = SV_PUBLIC;
+  } else {
+    // Add the symbol and type as a global
+    sym = add_symbol(decl->strlit, ST_VARIABLE, decl->type, visibility);
+  }
 
   // Add any const attribute
   sym->is_const= decl->is_const;
@@ -680,11 +705,12 @@ void global_var_declaration(ASTnode * decl, int visibility) {
     sym->dimsize = decl->dimsize;
   }
 
-  // Copy the key type from the declaration to the symbol
-  sym->keytype= decl->keytype;
+  // Copy any key type from the declaration to the symbol
+  if (decl->is_array == false)
+    sym->keytype= decl->keytype;
 
   // If we have an '=', we have an initialisation
-  if (Thistoken.token == T_ASSIGN) {
+  if (State.Thistoken.token == T_ASSIGN) {
     init = decl_initialisation();
     if (O_logmisc) {
       fprintf(Debugfh, "%s initialisation:\n", decl->strlit);
@@ -701,6 +727,7 @@ void global_var_declaration(ASTnode * decl, int visibility) {
 
     // Check the initialisation (list) against the symbol.
     // Also output the values in the list
+    const_initval(sym, init);
     init= check_bel(sym, init, 0, false, NOTEMP);
     if (init != NULL)
       fatal("Too many values in the expression list\n");
@@ -729,10 +756,10 @@ void global_var_declaration(ASTnode * decl, int visibility) {
 static ASTnode *decl_initialisation(void) {
 
   // Skip the '='
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // Get either an expression or a bracketed_expression_list
-  if (Thistoken.token == T_LBRACE)
+  if (State.Thistoken.token == T_LBRACE)
     return(bracketed_expression_list());
   else
     return (expression());
@@ -746,7 +773,6 @@ static ASTnode *decl_initialisation(void) {
 //
 // We also keep a state variable to see if
 // there was a vavle returned from the function
-static bool value_returned;
 //
 static void function_declaration(ASTnode * func, int visibility) {
   ASTnode *s;
@@ -755,12 +781,12 @@ static void function_declaration(ASTnode * func, int visibility) {
   func = function_prototype(func);
 
   // If the next token is a semicolon
-  if (Thistoken.token == T_SEMI) {
+  if (State.Thistoken.token == T_SEMI) {
     // Add the function prototype to the symbol table
     add_function(func, func->left, visibility);
 
     // Skip the semicolon and return
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     return;
   }
 
@@ -770,14 +796,23 @@ static void function_declaration(ASTnode * func, int visibility) {
   if (visibility == SV_EXTERN)
     fatal("Cannot declare an extern function with a body\n");
   declare_function(func, visibility);
-  Thisfunction = find_symbol(func->strlit);
-  value_returned= false;
-  s = statement_block(Thisfunction);
+  State.Thisfunction = find_symbol(func->strlit);
+  State.value_returned= false;
+
+  // Parse the body and generate its code using the
+  // function arena, then release the arena's memory
+  State.Thisarena = State.Funcarena;
+  s = statement_block(State.Thisfunction);
+  s = optAST(s);
+  s = elide_checks(s);
+  s = hoist_strlens(s);
   gen_func_statement_block(s);
+  State.Thisarena = State.Permarena;
+  release_arena(State.Funcarena);
 
   // If the function's return type isn't void, we had better
   // have returned a value
-  if (func->type != ty_void && value_returned==false)
+  if (func->type != ty_void && State.value_returned==false)
     fatal("Control reaches end of non-void function %s()\n", func->strlit);
 }
 
@@ -801,12 +836,12 @@ static ASTnode *function_prototype(ASTnode * func) {
 
   // If the next token is VOID,
   // see if it is followed by a ')'
-  if (Thistoken.token == T_VOID) {
-    scan(&Peektoken);
+  if (State.Thistoken.token == T_VOID) {
+    scan(&State.Peektoken);
     // It is, so we have no parameters
-    if (Peektoken.token == T_RPAREN) {
-      Peektoken.token= 0;
-      scan(&Thistoken);
+    if (State.Peektoken.token == T_RPAREN) {
+      State.Peektoken.token= 0;
+      scan(&State.Thistoken);
       func->left= NULL;
       is_void= true;
     }
@@ -818,8 +853,8 @@ static ASTnode *function_prototype(ASTnode * func) {
 
     // If the next token is an ELLIPSIS,
     // mark the function as variadic
-    if (Thistoken.token == T_ELLIPSIS) {
-      scan(&Thistoken);
+    if (State.Thistoken.token == T_ELLIPSIS) {
+      scan(&State.Thistoken);
       func->is_variadic = true;
     }
 
@@ -829,8 +864,8 @@ static ASTnode *function_prototype(ASTnode * func) {
   }
 
   // If we have a THROWS
-  if (Thistoken.token == T_THROWS) {
-    scan(&Thistoken);
+  if (State.Thistoken.token == T_THROWS) {
+    scan(&State.Thistoken);
 
     // Get the name and base type of the exception variable
     astexcept = typed_declaration();
@@ -866,14 +901,14 @@ static ASTnode *typed_declaration_list(void) {
 
   while (1) {
     // If no comma, stop now
-    if (Thistoken.token != T_COMMA)
+    if (State.Thistoken.token != T_COMMA)
       break;
 
     // Skip the comma
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 
     // Stop if we hit an ELLIPSIS
-    if (Thistoken.token == T_ELLIPSIS)
+    if (State.Thistoken.token == T_ELLIPSIS)
       break;
 
     // Get the next declaration and link it in
@@ -902,10 +937,10 @@ static ASTnode *array_typed_declaration(void) {
   this = typed_declaration();
 
   // If next token is an '['
-  if (Thistoken.token == T_LBRACKET) {
+  if (State.Thistoken.token == T_LBRACKET) {
 
     // Skip the left bracket
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 
     // If we have a type in the '[' ']'
     if (match_type(true) != NULL) {
@@ -959,10 +994,10 @@ static int *array_size(int *num) {
     match(T_RBRACKET, true);
 
     // Stop looping if the next token is not a '['
-    if (Thistoken.token != T_LBRACKET) break;
+    if (State.Thistoken.token != T_LBRACKET) break;
 
     // It is, so skip it and loop back
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     i++;
   }
 
@@ -997,14 +1032,14 @@ static ASTnode *typed_declaration(void) {
   bool is_inout= false;
 
   // See if the declaration is marked const
-  if (Thistoken.token == T_CONST) {
-    scan(&Thistoken);
+  if (State.Thistoken.token == T_CONST) {
+    scan(&State.Thistoken);
     is_const= true;
   }
 
   // See if the declaration is marked inout
-  if (Thistoken.token == T_INOUT) {
-    scan(&Thistoken);
+  if (State.Thistoken.token == T_INOUT) {
+    scan(&State.Thistoken);
     is_inout= true;
   }
 
@@ -1014,7 +1049,7 @@ static ASTnode *typed_declaration(void) {
   // Get the identifier, set its type
   match(T_IDENT, true);
   identifier = mkastleaf(A_IDENT, NULL, false, NULL, 0);
-  identifier->strlit = strdup(Text);
+  identifier->strlit = intern(State.Text);
   identifier->type = t;
   identifier->is_const= is_const;
   identifier->is_inout= is_inout;
@@ -1042,7 +1077,7 @@ static Type *match_type(bool checkonly) {
   char *typename = NULL;
 
   // See if this token is a built-in type
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_VOID:
     t = ty_void;
     break;
@@ -1083,7 +1118,7 @@ static Type *match_type(bool checkonly) {
     t = ty_flt64;
     break;
   case T_IDENT:
-    typename = strdup(Thistoken.tokstr);
+    typename = State.Thistoken.tokstr;
     t = find_type(typename, TY_USER, false, 0);
   }
 
@@ -1093,15 +1128,15 @@ static Type *match_type(bool checkonly) {
 
   // We don't recognise it as a type
   if (t == NULL)
-    fatal("Unknown type %s\n", Text);
+    fatal("Unknown type %s\n", State.Text);
 
   // Get the next token
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // Loop counting the number of STAR tokens
   // and getting a a pointer to the previous type
-  while (Thistoken.token == T_STAR) {
-    scan(&Thistoken);
+  while (State.Thistoken.token == T_STAR) {
+    scan(&State.Thistoken);
     t = pointer_to(t);
   }
 
@@ -1121,8 +1156,15 @@ static ASTnode *statement_block(Sym * func) {
   ASTnode *s = NULL, *d = NULL;
   ASTnode *dtor = NULL;
 
-  // See if we have a single procedural statement
-  s = procedural_stmt();
+  // See if we have a single procedural statement.
+  // If it's a function body, the parameters
+  // must be in scope for the statement
+  if (func != NULL && State.Thistoken.token != T_LBRACE) {
+    new_scope(func);
+    s = procedural_stmt();
+    end_scope();
+  } else
+    s = procedural_stmt();
   if (s != NULL)
     return (s);
 
@@ -1130,7 +1172,7 @@ static ASTnode *statement_block(Sym * func) {
   lbrace();
 
   // An empty statement body
-  if (Thistoken.token == T_RBRACE)
+  if (State.Thistoken.token == T_RBRACE)
     return (NULL);
 
   // Start a new scope
@@ -1138,7 +1180,7 @@ static ASTnode *statement_block(Sym * func) {
 
   // A declaration_stmt starts with a type or
   // the token T_CONST, so look for one.
-  if ((match_type(true) != NULL) || (Thistoken.token == T_CONST))
+  if ((match_type(true) != NULL) || (State.Thistoken.token == T_CONST))
     d = declaration_stmts();
 
   // Now get any procedural statements
@@ -1164,32 +1206,35 @@ static ASTnode *statement_block(Sym * func) {
 //-                    )*
 //-
 static ASTnode *declaration_stmts(void) {
-  ASTnode *d, *e = NULL;
-  ASTnode *this;
+  ASTnode *d, *e;
+  ASTnode *this, *first = NULL, *last = NULL;
 
-  // Get one declaration statement
-  d = array_typed_declaration();
+  // Loop while we see a type or the 'const' keyword
+  do {
+    // Get one declaration statement
+    d = array_typed_declaration();
 
-  if (d->is_inout== true)
-    fatal("Only function parameters can be declared inout\n");
-
-  // If there is an '=' next, we have an assignment
-  if (Thistoken.token == T_ASSIGN) {
-    e = decl_initialisation();
-  }
+    if (d->is_inout== true)
+      fatal("Only function parameters can be declared inout\n");
 
-  semi();
+    // If there is an '=' next, we have an assignment
+    e = NULL;
+    if (State.Thistoken.token == T_ASSIGN) {
+      e = decl_initialisation();
+    }
 
-  // Declare that variable
-  this = declaration_statement(d, e);
+    semi();
 
-  // Look for a type or the 'const' keyword.
-  // If so, we have another declaration statement
-  if ((match_type(true) != NULL) || (Thistoken.token == T_CONST)) {
-    this->mid = declaration_stmts();
-  }
+    // Declare that variable and link it to the previous one
+    this = declaration_statement(d, e);
+    if (first == NULL)
+      first = this;
+    else
+      last->mid = this;
+    last = this;
+  } while ((match_type(true) != NULL) || (State.Thistoken.token == T_CONST));
 
-  return (this);
+  return (first);
 }
 
 // Parse zero or more procedural statements and
@@ -1239,11 +1284,11 @@ static ASTnode *procedural_stmt(void) {
   ASTnode *left;
 
   // If we have a right brace, no statement
-  if (Thistoken.token == T_RBRACE)
+  if (State.Thistoken.token == T_RBRACE)
     return (NULL);
 
   // See if this token is a known keyword or identifier
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_IF:
     return (if_stmt());
   case T_WHILE:
@@ -1275,10 +1320,10 @@ static ASTnode *procedural_stmt(void) {
     return (undef_stmt());
   case T_IDENT:
     // Get the next token.
-    scan(&Peektoken);
+    scan(&State.Peektoken);
 
     // If it's a '(' then it's a function call.
-    if (Peektoken.token == T_LPAREN) {
+    if (State.Peektoken.token == T_LPAREN) {
       // Get the AST for the function and
       // absorb the trailing semicolon
       left = function_call();
@@ -1312,7 +1357,7 @@ static ASTnode *short_assign_stmt(void) {
 
   // If the next token is a '*' then
   // treat is a a unary expression
-  if (Thistoken.token == T_STAR) {
+  if (State.Thistoken.token == T_STAR) {
     v = unary_expression();
   } else {
     // Get the postfix variable
@@ -1326,16 +1371,16 @@ static ASTnode *short_assign_stmt(void) {
   // Do we have a '++' or '--' following?
   // If so, build an assignment statement
   // with either an ADD or a SUBTRACT
-  if (Thistoken.token == T_POSTINC) {
+  if (State.Thistoken.token == T_POSTINC) {
     // Cannot increment or decrement a string
     if (v->type == ty_string)
       fatal("Cannot modify a string or its contents\n");
 
     // Get the variable as an rvalue
-    e = (ASTnode *) Calloc(sizeof(ASTnode));
+    e = (ASTnode *) Aalloc(State.Thisarena, sizeof(ASTnode));
     memcpy(e, v, sizeof(ASTnode));
     e->rvalue = true;
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 
     // Build a NUMLIT node with 1 in it
     // and add it from the rval variable
@@ -1346,16 +1391,16 @@ static ASTnode *short_assign_stmt(void) {
     return(assignment_statement(v, e));
   }
 
-  if (Thistoken.token == T_POSTDEC) {
+  if (State.Thistoken.token == T_POSTDEC) {
     // Cannot increment or decrement a string
     if (v->type == ty_string)
       fatal("Cannot modify a string or its contents\n");
 
     // Get the variable as an rvalue
-    e = (ASTnode *) Calloc(sizeof(ASTnode));
+    e = (ASTnode *) Aalloc(State.Thisarena, sizeof(ASTnode));
     memcpy(e, v, sizeof(ASTnode));
     e->rvalue = true;
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 
     // Build a NUMLIT node with 1 in it,
     // and subtract it from the rval variable
@@ -1370,15 +1415,15 @@ static ASTnode *short_assign_stmt(void) {
   match(T_ASSIGN, true);
 
   // Do we have a const keyword?
-  if (Thistoken.token == T_CONST) {
+  if (State.Thistoken.token == T_CONST) {
     
     // Peek ahead because we might be followed by a
     // string literal or a semicolon
-    scan(&Peektoken);
+    scan(&State.Peektoken);
 
     // It's an "= const ;" statement
-    if (Peektoken.token == T_SEMI) {
-      scan(&Thistoken);
+    if (State.Peektoken.token == T_SEMI) {
+      scan(&State.Thistoken);
 
       // We can't do if it not an A_IDENT
       if (v->op != A_IDENT)
@@ -1407,7 +1452,7 @@ static ASTnode *if_stmt(void) {
   // Get the expression, right parenthesis
   // and the statement block. Make sure the
   // expression has boolean type
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
   e = expression();
   if (e->type != ty_bool)
@@ -1417,8 +1462,8 @@ static ASTnode *if_stmt(void) {
 
   // If we now have an ELSE
   // get the following statement block
-  if (Thistoken.token == T_ELSE) {
-    scan(&Thistoken);
+  if (State.Thistoken.token == T_ELSE) {
+    scan(&State.Thistoken);
     f = statement_block(NULL);
   }
 
@@ -1432,13 +1477,13 @@ static ASTnode *while_stmt(void) {
   ASTnode *e, *s;
 
   // Skip the WHILE, check for a left parenthesis.
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // If we have a TRUE token, build an ASTnode for it
-  if (Thistoken.token == T_TRUE) {
+  if (State.Thistoken.token == T_TRUE) {
     e = mkastleaf(A_NUMLIT, ty_bool, true, NULL, 1);
-    scan(&Thistoken);
+    scan(&State.Thistoken);
   } else {
     // Otherwise, get the expression. Ensure it is boolean
     e = expression();
@@ -1463,15 +1508,15 @@ static ASTnode *for_stmt(void) {
   ASTnode *i = NULL, *e, *send = NULL, *s;
 
   // Skip the FOR, check for a left parenthesis.
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // If we don't have a semicolon, get the initial statement(s).
   // Then get the semicolon
-  if (Thistoken.token != T_SEMI) {
+  if (State.Thistoken.token != T_SEMI) {
     // If we have a left brace, it's a set of procedural statements
-    if (Thistoken.token == T_LBRACE) {
-      scan(&Thistoken);
+    if (State.Thistoken.token == T_LBRACE) {
+      scan(&State.Thistoken);
       i= procedural_stmts();
       rbrace();
     } else
@@ -1482,7 +1527,7 @@ static ASTnode *for_stmt(void) {
 
   // If we don't have a semicolon, get the condition expression.
   // Otherwise, make a TRUE node instead
-  if (Thistoken.token != T_SEMI) {
+  if (State.Thistoken.token != T_SEMI) {
     e = expression();
     if (e->type != ty_bool)
       fatal("The condition in a for statement must be boolean\n");
@@ -1492,10 +1537,10 @@ static ASTnode *for_stmt(void) {
   semi();
 
   // If we don't have a right parentheses, get the change statement(s)
-  if (Thistoken.token != T_RPAREN) {
+  if (State.Thistoken.token != T_RPAREN) {
     // If we have a left brace, it's a set of procedural statements
-    if (Thistoken.token == T_LBRACE) {
-      scan(&Thistoken);
+    if (State.Thistoken.token == T_LBRACE) {
+      scan(&State.Thistoken);
       send= procedural_stmts();
       rbrace();
     } else
@@ -1531,12 +1576,11 @@ static bool is_postfixvar(ASTnode *n) {
 
 // Return the name of a new hidden index
 // variable to be used in a foreach loop
-static int hididx= 0;
 static char *new_idxvar(void) {
-  char *name= Malloc(20);
-  snprintf(name, 20, ".hididx%d", hididx);
-  hididx++;
-  return(name);
+  char name[20];
+  snprintf(name, 20, ".hididx%d", State.hididx);
+  State.hididx++;
+  return(intern(name));
 }
 
 //- foreach_stmt= FOREACH postfix_variable LPAREN
@@ -1561,7 +1605,7 @@ static ASTnode *foreach_stmt(void) {
   ASTnode *spre=NULL;		// Assigns array element to the var
 
   // Skip the 'foreach' keyword
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // Get the variable and the lparen
   var= postfix_variable(NULL);
@@ -1569,7 +1613,7 @@ static ASTnode *foreach_stmt(void) {
 
   // Make a copy of var because the assignment statements below
   // will make it an lvalue, and we also need it as an rvalue
-  rvar = (ASTnode *) Calloc(sizeof(ASTnode));
+  rvar = (ASTnode *) Aalloc(State.Thisarena, sizeof(ASTnode));
   memcpy(rvar, var, sizeof(ASTnode));
   rvar->rvalue= true;
 
@@ -1578,10 +1622,10 @@ static ASTnode *foreach_stmt(void) {
 
   // Look at the next token to determine what
   // flavour of 'foreach' we are doing
-  switch(Thistoken.token) {
+  switch(State.Thistoken.token) {
     case T_ELLIPSIS:
       // Skip the ellipsis and get the final expression
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       finalval= expression();
 
       // Build an assignment statement for the initial value
@@ -1597,7 +1641,7 @@ static ASTnode *foreach_stmt(void) {
       break;
 
     case T_COMMA:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       nextval= postfix_variable(NULL);
       // Check that the initval is a variable
       if (is_postfixvar(initval)==false)
@@ -1687,13 +1731,13 @@ static ASTnode *foreach_stmt(void) {
         initval= declaration_statement(initval, NULL);
 
         // Make an rvalue copy of the hidden pointer variable
-        ridx = (ASTnode *) Calloc(sizeof(ASTnode));
+        ridx = (ASTnode *) Aalloc(State.Thisarena, sizeof(ASTnode));
         memcpy(ridx, initval, sizeof(ASTnode));
         ridx->op= A_IDENT;
         ridx->rvalue= true;
 
         // Make an lvalue copy of the hidden pointer variable
-        idx = (ASTnode *) Calloc(sizeof(ASTnode));
+        idx = (ASTnode *) Aalloc(State.Thisarena, sizeof(ASTnode));
         memcpy(idx, initval, sizeof(ASTnode));
         idx->op= A_IDENT;
         idx->rvalue= false;
@@ -1751,13 +1795,13 @@ static ASTnode *return_stmt(void) {
   ASTnode *this, *e = NULL;
 
   // Skip the 'return' token
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // If we have a left parenthesis, we are returning a value
-  if (Thistoken.token == T_LPAREN) {
+  if (State.Thistoken.token == T_LPAREN) {
     // Can't return a value if the function returns void
-    if (Thisfunction->type == ty_void)
-      fatal("Can't return from void %s()\n", Thisfunction->name);
+    if (State.Thisfunction->type == ty_void)
+      fatal("Can't return from void %s()\n", State.Thisfunction->name);
 
     // Skip the left parenthesis
     lparen();
@@ -1766,7 +1810,7 @@ static ASTnode *return_stmt(void) {
     e = expression();
 
     // Widen the expression's type if required
-    e = widen_expression(e, Thisfunction->type);
+    e = widen_expression(e, State.Thisfunction->type);
 
     // Get the ')'
     rparen();
@@ -1774,13 +1818,13 @@ static ASTnode *return_stmt(void) {
 
   // Error if no expression but the function returns a value.
   // Ditto the other way around.
-  if (e == NULL && Thisfunction->type != ty_void)
-    fatal("No return value from non-void %s()\n", Thisfunction->name);
-  if (e != NULL && Thisfunction->type == ty_void)
-    fatal("Cannot return a value from void %s()\n", Thisfunction->name);
+  if (e == NULL && State.Thisfunction->type != ty_void)
+    fatal("No return value from non-void %s()\n", State.Thisfunction->name);
+  if (e != NULL && State.Thisfunction->type == ty_void)
+    fatal("Cannot return a value from void %s()\n", State.Thisfunction->name);
 
   // We have a return value
-  if (e != NULL) value_returned= true;
+  if (e != NULL) State.value_returned= true;
 
   // Build the A_RETURN node
   this = mkastnode(A_RETURN, e, NULL, NULL);
@@ -1796,7 +1840,7 @@ static ASTnode *abort_stmt(void) {
   ASTnode *this;
 
   // Skip the 'abort' token
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // Build the A_ABORT node
   this = mkastnode(A_ABORT, NULL, NULL, NULL);
@@ -1812,7 +1856,7 @@ static ASTnode *break_stmt(void) {
   ASTnode *this;
 
   // Skip the 'break' token
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // Build the A_BREAK node
   this = mkastnode(A_BREAK, NULL, NULL, NULL);
@@ -1828,7 +1872,7 @@ static ASTnode *continue_stmt(void) {
   ASTnode *this;
 
   // Skip the 'continue' token
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // Build the A_CONTINUE node
   this = mkastnode(A_CONTINUE, NULL, NULL, NULL);
@@ -1845,29 +1889,29 @@ static ASTnode *try_stmt(void) {
   Sym *sym;
 
   // Skip the 'try' and get the left parenthesis
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // Ensure we have an identifier and get its symbol
   match(T_IDENT, false);
-  sym = find_symbol(Thistoken.tokstr);
+  sym = find_symbol(State.Thistoken.tokstr);
   if (sym == NULL)
-    fatal("Unknown symbol %s\n", Thistoken.tokstr);
+    fatal("Unknown symbol %s\n", State.Thistoken.tokstr);
 
   // Check that the symbol's type is a struct with
   // an int32 as the first member
   if (!is_struct(sym->type) ||
       (sym->type->memb == NULL) || (sym->type->memb->type != ty_int32))
     fatal("Variable %s not suitable to hold an exception\n",
-	  Thistoken.tokstr);
+	  State.Thistoken.tokstr);
 
   // Make an A_TRY leaf node with the given symbol
   ASTnode *n = mkastleaf(A_TRY, NULL, false, sym, 0);
-  n->strlit = Thistoken.tokstr;
+  n->strlit = State.Thistoken.tokstr;
   n = mkident(n);
 
   // Skip the identifier and right parenthesis
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   rparen();
 
   // Get the try statement block
@@ -1903,7 +1947,7 @@ static ASTnode *switch_stmt(void) {
   int64_t caseval = 0;
 
   // Skip the 'switch' and '('
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // Get the switch expression, the ')' and the '{'
@@ -1921,7 +1965,7 @@ static ASTnode *switch_stmt(void) {
 
   // Now parse the cases
   while (inloop) {
-    switch (Thistoken.token) {
+    switch (State.Thistoken.token) {
       // Leave the loop when we hit a '}'
     case T_RBRACE:
       if (casecount == 0)
@@ -1934,14 +1978,14 @@ static ASTnode *switch_stmt(void) {
       if (seendefault)
 	fatal("Case or default after existing default\n");
 
-      if (Thistoken.token == T_DEFAULT) {
+      if (State.Thistoken.token == T_DEFAULT) {
 	ASTop = A_DEFAULT;
-	scan(&Thistoken);
+	scan(&State.Thistoken);
 	seendefault = true;
       } else {
 	// Scan the case value if required
 	ASTop = A_CASE;
-	scan(&Thistoken);
+	scan(&State.Thistoken);
 
 	// Get the case expression
 	left = expression();
@@ -1970,7 +2014,7 @@ static ASTnode *switch_stmt(void) {
 
       // If the next token is a T_CASE, the existing case will fall
       // into the next case. Otherwise, parse the case body.
-      if (Thistoken.token == T_CASE)
+      if (State.Thistoken.token == T_CASE)
 	body = NULL;
       else
 	body = procedural_stmts();
@@ -1990,7 +2034,7 @@ static ASTnode *switch_stmt(void) {
       break;
     default:
       fatal("Unexpected token in switch: %s\n",
-	    get_tokenstr(Thistoken.token));
+	    get_tokenstr(State.Thistoken.token));
     }
   }
 
@@ -2008,7 +2052,7 @@ static ASTnode *switch_stmt(void) {
 static ASTnode *fallthru_stmt(void) {
 
   // Skip the 'fallthru'
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   semi();
   return (mkastnode(A_FALLTHRU, NULL, NULL, NULL));
 }
@@ -2022,7 +2066,7 @@ static ASTnode *function_call(void) {
 
   // Make an IDENT node from the current token
   s = mkastleaf(A_IDENT, NULL, false, NULL, 0);
-  s->strlit = Thistoken.tokstr;
+  s->strlit = State.Thistoken.tokstr;
 
   // Get the function's Sym pointer
   sym = find_symbol(s->strlit);
@@ -2031,17 +2075,17 @@ static ASTnode *function_call(void) {
     fatal("Unknown function %s()\n", s->strlit);
 
   // Skip the identifier
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // Get the left parenthesis
   lparen();
 
   // If the next token is not a right parenthesis,
-  if (Thistoken.token != T_RPAREN) {
+  if (State.Thistoken.token != T_RPAREN) {
     // See if the lookahead token is an '='.
     // If so, we have a named expression list
-    scan(&Peektoken);
-    if (Peektoken.token == T_ASSIGN) {
+    scan(&State.Peektoken);
+    if (State.Peektoken.token == T_ASSIGN) {
       e = named_expression_list();
     } else {
       // No, so get an expression list
@@ -2068,20 +2112,20 @@ static ASTnode *function_call(void) {
 //- va_end_stmt= VA_END LPAREN IDENT RPAREN SEMI
 //-
 static ASTnode *va_start_end_stmt(void) {
-  int token= Thistoken.token;
+  int token= State.Thistoken.token;
   int astop;
   ASTnode *v;
   Sym *sym;
 
   // Skip the keyword and '('
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // Ensure that we have an identifier
   match(T_IDENT, false);
 
   // Try to find the symbol
-  sym = find_symbol(Thistoken.tokstr);
+  sym = find_symbol(State.Thistoken.tokstr);
   if ((sym == NULL) || (sym->symtype != ST_VARIABLE))
     fatal("Can only do va_start(variable) and va_end(variable)\n");
 
@@ -2090,7 +2134,7 @@ static ASTnode *va_start_end_stmt(void) {
     fatal("va_start(variable) and va_end(variable) must be void * type\n");
 
   // Skip the identifier ')' and ';'
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   rparen();
   semi();
   astop= (token== T_VASTART) ? A_VASTART : A_VAEND;
@@ -2105,7 +2149,7 @@ static ASTnode *undef_stmt(void) {
   ASTnode *ary;
 
   // Skip the keyword and '('
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // Get the associative array.
@@ -2129,7 +2173,6 @@ static ASTnode *undef_stmt(void) {
 // For bracketed expression lists, we keep a
 // count of the depth of '{' nesting.
 //
-static int bel_depth;
 
 //- bracketed_expression_list= LBRACE bracketed_expression_element
 //-                                   (COMMA bracketed_expression_element)*
@@ -2141,26 +2184,26 @@ static ASTnode *bracketed_expression_list(void) {
   ASTnode *last;
 
   // Skip the left brace
-  scan(&Thistoken);
+  scan(&State.Thistoken);
 
   // Make the BEL node which will hold the list
   bel = mkastnode(A_BEL, NULL, NULL, NULL);
   last= NULL;
-  bel_depth=1;
+  State.bel_depth=1;
 
   // Loop getting expressions
   while (1) {
-    switch(Thistoken.token) {
+    switch(State.Thistoken.token) {
       case T_COMMA:
-	scan(&Thistoken);
+	scan(&State.Thistoken);
 	break;
       case T_LBRACE:
-	scan(&Thistoken);
-	bel_depth++;
+	scan(&State.Thistoken);
+	State.bel_depth++;
 	break;
       case T_RBRACE:
-	scan(&Thistoken);
-	bel_depth--;
+	scan(&State.Thistoken);
+	State.bel_depth--;
 	break;
       default:
 	this= bracketed_expression_element();
@@ -2170,7 +2213,7 @@ static ASTnode *bracketed_expression_list(void) {
           last->mid= this; last= this;
 	}
     }
-    if (bel_depth == 0) break;
+    if (State.bel_depth == 0) break;
   }
   return(bel);
 }
@@ -2182,7 +2225,7 @@ static ASTnode *bracketed_expression_element(void) {
   ASTnode *elem;
 
   // Parse one element and return it
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_LBRACE:
     elem = bracketed_expression_list();
     break;
@@ -2204,8 +2247,8 @@ static ASTnode *expression_list(void) {
 
   // If we have a comma, skip it.
   // Get the following expression list
-  if (Thistoken.token == T_COMMA) {
-    scan(&Thistoken);
+  if (State.Thistoken.token == T_COMMA) {
+    scan(&State.Thistoken);
     l = expression_list();
   }
 
@@ -2228,8 +2271,8 @@ static ASTnode *named_expression_list(void) {
   // Build an ASSIGN node with the identifier's
   // name, then skip the identifier
   first = this = mkastleaf(A_ASSIGN, NULL, false, NULL, 0);
-  first->strlit = Thistoken.tokstr;
-  scan(&Thistoken);
+  first->strlit = State.Thistoken.tokstr;
+  scan(&State.Thistoken);
 
   // Check for the '=' token
   match(T_ASSIGN, true);
@@ -2240,12 +2283,12 @@ static ASTnode *named_expression_list(void) {
 
   while (1) {
     // If no comma, stop now
-    if (Thistoken.token != T_COMMA)
+    if (State.Thistoken.token != T_COMMA)
       break;
 
     // Skip the comma
     // Get the next named expression and link it in
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     next = named_expression_list();
     this->right = next;
     this = next;
@@ -2275,16 +2318,16 @@ static ASTnode *ternary_expression(void) {
   // see if it is followed by a '?' before deciding it's a ternary
 
   // Do we have an '('?
-  if (Thistoken.token == T_LPAREN) {
+  if (State.Thistoken.token == T_LPAREN) {
 
     // Get the expression, absorbing '(' and ')'
     n = bitwise_expression();
 
     // If this is followed by a '?' and
     // the expression's type is boolean
-    if ((Thistoken.token == T_QUESTION) && (n->type == ty_bool)) {
+    if ((State.Thistoken.token == T_QUESTION) && (n->type == ty_bool)) {
       // Skip the '?'
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       e= n;
 
       // Get the true expression
@@ -2322,8 +2365,8 @@ static ASTnode *bitwise_expression(void) {
   bool loop = true;
 
   // Deal with a leading '~'
-  if (Thistoken.token == T_INVERT) {
-    scan(&Thistoken);
+  if (State.Thistoken.token == T_INVERT) {
+    scan(&State.Thistoken);
     invert = true;
   }
 
@@ -2337,23 +2380,23 @@ static ASTnode *bitwise_expression(void) {
 
   // See if we have more bitwise operations
   while (loop) {
-    switch (Thistoken.token) {
+    switch (State.Thistoken.token) {
     case T_AMPER:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = boolean_expression();
       cant_do(left, ty_bool, "Cannot do bitwise operations on a boolean\n");
       cant_do(right, ty_bool, "Cannot do bitwise operations on a boolean\n");
       left = binop(left, right, A_AND);
       break;
     case T_OR:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = boolean_expression();
       cant_do(left, ty_bool, "Cannot do bitwise operations on a boolean\n");
       cant_do(right, ty_bool, "Cannot do bitwise operations on a boolean\n");
       left = binop(left, right, A_OR);
       break;
     case T_XOR:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = boolean_expression();
       cant_do(left, ty_bool, "Cannot do bitwise operations on a boolean\n");
       cant_do(right, ty_bool, "Cannot do bitwise operations on a boolean\n");
@@ -2386,9 +2429,9 @@ static ASTnode *logical_and_expression(void) {
 
   // See if we have more logical AND operations
   while (1) {
-    if (Thistoken.token != T_LOGAND)
+    if (State.Thistoken.token != T_LOGAND)
       break;
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     right = relational_expression();
     if ((left->type != ty_bool) || (right->type != ty_bool))
       fatal("Can only do logical AND on boolean types\n");
@@ -2410,9 +2453,9 @@ static ASTnode *logical_or_expression(void) {
 
   // See if we have more logical OR operations
   while (1) {
-    if (Thistoken.token != T_LOGOR)
+    if (State.Thistoken.token != T_LOGOR)
       break;
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     right = relational_expression();
     if ((left->type != ty_bool) || (right->type != ty_bool))
       fatal("Can only do logical OR on boolean types\n");
@@ -2439,8 +2482,8 @@ static ASTnode *relational_expression(void) {
   bool not = false;
 
   // Deal with a leading '!'
-  if (Thistoken.token == T_LOGNOT) {
-    scan(&Thistoken);
+  if (State.Thistoken.token == T_LOGNOT) {
+    scan(&State.Thistoken);
     not = true;
   }
 
@@ -2454,34 +2497,34 @@ static ASTnode *relational_expression(void) {
   }
 
   // See if we have a shift operation
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_GE:
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     right = shift_expression();
     left = binop(left, right, A_GE);
     break;
   case T_GT:
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     right = shift_expression();
     left = binop(left, right, A_GT);
     break;
   case T_LE:
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     right = shift_expression();
     left = binop(left, right, A_LE);
     break;
   case T_LT:
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     right = shift_expression();
     left = binop(left, right, A_LT);
     break;
   case T_EQ:
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     right = shift_expression();
     left = binop(left, right, A_EQ);
     break;
   case T_NE:
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     right = shift_expression();
     left = binop(left, right, A_NE);
     break;
@@ -2504,16 +2547,16 @@ static ASTnode *shift_expression(void) {
 
   // See if we have more shft operations
   while (loop) {
-    switch (Thistoken.token) {
+    switch (State.Thistoken.token) {
     case T_LSHIFT:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = additive_expression();
       cant_do(left, ty_bool, "Cannot do shift operations on a boolean\n");
       cant_do(right, ty_bool, "Cannot do shift operations on a boolean\n");
       left = binop(left, right, A_LSHIFT);
       break;
     case T_RSHIFT:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = additive_expression();
       cant_do(left, ty_bool, "Cannot do shift operations on a boolean\n");
       cant_do(right, ty_bool, "Cannot do shift operations on a boolean\n");
@@ -2543,12 +2586,12 @@ static ASTnode *additive_expression(void) {
   int typesize;
 
   // Deal with a leading '+' or '-'
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_PLUS:
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     break;
   case T_MINUS:
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     negate = true;
     break;
   }
@@ -2563,9 +2606,9 @@ static ASTnode *additive_expression(void) {
 
   // See if we have more additive operations
   while (loop) {
-    switch (Thistoken.token) {
+    switch (State.Thistoken.token) {
     case T_PLUS:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = multiplicative_expression();
       cant_do(left, ty_bool, "Cannot do additive operations on a boolean\n");
       cant_do(right, ty_bool, "Cannot do additive operations on a boolean\n");
@@ -2574,7 +2617,7 @@ static ASTnode *additive_expression(void) {
       left = binop(left, right, A_ADD);
       break;
     case T_MINUS:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = multiplicative_expression();
       cant_do(left, ty_bool, "Cannot do additive operations on a boolean\n");
       cant_do(right, ty_bool, "Cannot do additive operations on a boolean\n");
@@ -2621,9 +2664,9 @@ static ASTnode *multiplicative_expression(void) {
 
   // See if we have more multiplicative operations
   while (loop) {
-    switch (Thistoken.token) {
+    switch (State.Thistoken.token) {
     case T_STAR:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = unary_expression();
       cant_do(left, ty_bool,
 	      "Cannot do multiplicative operations on a boolean\n");
@@ -2632,7 +2675,7 @@ static ASTnode *multiplicative_expression(void) {
       left = binop(left, right, A_MULTIPLY);
       break;
     case T_SLASH:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = unary_expression();
       cant_do(left, ty_bool,
 	      "Cannot do multiplicative operations on a boolean\n");
@@ -2641,7 +2684,7 @@ static ASTnode *multiplicative_expression(void) {
       left = binop(left, right, A_DIVIDE);
       break;
     case T_MOD:
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       right = unary_expression();
       cant_do(left, ty_bool,
 	      "Cannot do multiplicative operations on a boolean\n");
@@ -2667,10 +2710,10 @@ static ASTnode *multiplicative_expression(void) {
 static ASTnode *unary_expression(void) {
   ASTnode *u;
 
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_AMPER:
     // Get the next token and parse it
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     u = primary_expression();
 
     // Get an address based on the AST operation
@@ -2700,7 +2743,7 @@ static ASTnode *unary_expression(void) {
     // Get the next token and parse it
     // recursively as a unary expression.
     // Make it an rvalue
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     u = unary_expression();
     u->rvalue = true;
 
@@ -2742,44 +2785,44 @@ static ASTnode *primary_expression(void) {
   Type *ty;
   bool is_const = false;
 
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_LPAREN:
     // Skip the left parentheses, get the expression,
     // skip the right parentheses and return
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     f = expression();
     rparen();
     return (f);
   case T_NUMLIT:
     // Build an ASTnode with the numeric value and suitable type
-    ty = parse_litval(&(Thistoken.litval));
-    f = mkastleaf(A_NUMLIT, ty, true, NULL, Thistoken.litval.intval);
-    scan(&Thistoken);
+    ty = parse_litval(&(State.Thistoken.litval));
+    f = mkastleaf(A_NUMLIT, ty, true, NULL, State.Thistoken.litval.intval);
+    scan(&State.Thistoken);
     break;
   case T_CONST:
     // It must be a const string literal. Skip the const token.
     // Set the is_const flag. Check we have a following STRLIT
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     is_const= true;
     match(T_STRLIT, false);
   case T_STRLIT:
     // Build an ASTnode with the string literal and ty_string type
     f = mkastleaf(A_STRLIT, ty_string, false, NULL, 0);
-    f->strlit = Thistoken.tokstr;
+    f->strlit = State.Thistoken.tokstr;
     f->is_const= is_const;
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     break;
   case T_TRUE:
     f = mkastleaf(A_NUMLIT, ty_bool, true, NULL, 1);
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     break;
   case T_FALSE:
     f = mkastleaf(A_NUMLIT, ty_bool, true, NULL, 0);
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     break;
   case T_NULL:
     f = mkastleaf(A_NUMLIT, ty_voidptr, true, NULL, 0);
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     break;
   case T_SIZEOF:
     f = sizeof_expression();
@@ -2795,9 +2838,9 @@ static ASTnode *primary_expression(void) {
     break;
   case T_IDENT:
     // Find out what sort of symbol this is
-    sym = find_symbol(Thistoken.tokstr);
+    sym = find_symbol(State.Thistoken.tokstr);
     if (sym == NULL)
-      fatal("Unknown symbol %s\n", Thistoken.tokstr);
+      fatal("Unknown symbol %s\n", State.Thistoken.tokstr);
     switch (sym->symtype) {
     case ST_FUNCTION:
       // This could be a function call or we
@@ -2806,21 +2849,21 @@ static ASTnode *primary_expression(void) {
       // the next token isn't a '('.
       // Don't re-scan Peektoken if it
       // already has a token in it
-      if (Peektoken.token==0)
-        scan(&Peektoken);
-      if (Peektoken.token != T_LPAREN) {
+      if (State.Peektoken.token==0)
+        scan(&State.Peektoken);
+      if (State.Peektoken.token != T_LPAREN) {
 	// Make the IDENT node for the symbol
 	f = mkastleaf(A_IDENT, NULL, false, NULL, 0);
-	f->strlit = Thistoken.tokstr;
+	f->strlit = State.Thistoken.tokstr;
 
         // Check the function exists
-	sym= find_symbol(Thistoken.tokstr);
+	sym= find_symbol(State.Thistoken.tokstr);
 	if ((sym == NULL) || (sym->symtype != ST_FUNCTION))
 	  fatal("Symbol %s does not exist or is not a function\n");
 	f->sym= sym;
 	// Find a matching function pointer type for the function
 	f->type= get_funcptr_type(sym);
-	scan(&Thistoken);
+	scan(&State.Thistoken);
 	break;
       }
 
@@ -2829,9 +2872,9 @@ static ASTnode *primary_expression(void) {
       break;
     case ST_VARIABLE:
       // If this is a function pointer, look at the next token
-      if (Peektoken.token==0)
-        scan(&Peektoken);
-      if (Peektoken.token == T_LPAREN) {
+      if (State.Peektoken.token==0)
+        scan(&State.Peektoken);
+      if (State.Peektoken.token == T_LPAREN) {
 	f= function_call();
       } else {
         f = postfix_variable(NULL);
@@ -2840,15 +2883,15 @@ static ASTnode *primary_expression(void) {
       break;
     case ST_ENUM:
       f = mkastleaf(A_NUMLIT, sym->type, true, NULL, sym->count);
-      scan(&Thistoken);
+      scan(&State.Thistoken);
       break;
     default:
-      fatal("Unknown symbol type for %s\n", Thistoken.tokstr);
+      fatal("Unknown symbol type for %s\n", State.Thistoken.tokstr);
     }
     break;
   default:
     fatal("Unknown token as a primary_expression: %s\n",
-	  get_tokenstr(Thistoken.token));
+	  get_tokenstr(State.Thistoken.token));
   }
 
   return (f);
@@ -2863,7 +2906,7 @@ static ASTnode *sizeof_expression(void) {
   int count;
 
   // Skip the keyword, get the '('
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // Do we have a type?
@@ -2914,14 +2957,14 @@ static ASTnode *va_arg_expression(void) {
   Type *ty;
 
   // Skip the keyword, get the '('
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // Ensure that we have an identifier
   match(T_IDENT, false);
 
   // Try to find the symbol
-  sym = find_symbol(Thistoken.tokstr);
+  sym = find_symbol(State.Thistoken.tokstr);
   if ((sym == NULL) || (sym->symtype != ST_VARIABLE))
     fatal("Need va_arg(variable, type)\n");
 
@@ -2930,7 +2973,7 @@ static ASTnode *va_arg_expression(void) {
     fatal("va_arg(variable,...) variable must be void * type\n");
 
   // Skip the identifier ')' and ','
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   match(T_COMMA, true);
 
   // Get the type in the parentheses
@@ -2962,7 +3005,7 @@ static ASTnode *cast_expression(void) {
   Type *ety, *ty;
 
   // Skip the keyword, get the '('
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // Get the expression in the parentheses
@@ -2993,7 +3036,7 @@ static ASTnode *exists_expression(void) {
   ASTnode *e;
 
   // Skip the keyword, get the '('
-  scan(&Thistoken);
+  scan(&State.Thistoken);
   lparen();
 
   // Get the postfix variable in the parentheses.
@@ -3028,17 +3071,17 @@ static ASTnode *postfix_variable(ASTnode * n) {
   int dimlevel=0;
 
   // Deal with whatever token we currently have
-  switch (Thistoken.token) {
+  switch (State.Thistoken.token) {
   case T_IDENT:
     if (n != NULL)
-      fatal("Cannot use identifier %s here\n", Thistoken.tokstr);
+      fatal("Cannot use identifier %s here\n", State.Thistoken.tokstr);
 
     // An identifier. Make an IDENT leaf node
     // with the identifier in Thistoken
     n = mkastleaf(A_IDENT, NULL, false, NULL, 0);
-    n->strlit = Thistoken.tokstr;
+    n->strlit = State.Thistoken.tokstr;
     n = mkident(n);		// Check variable exists, get its type
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 
     // If the variable is marked inout
     if (n->sym->is_inout) {
@@ -3064,7 +3107,7 @@ static ASTnode *postfix_variable(ASTnode * n) {
 
   case T_LBRACKET:
     // An array access. Skip the token. Get the symbol
-    scan(&Thistoken);
+    scan(&State.Thistoken);
     sym= n->sym;
 
     // Get the expression.
@@ -3107,8 +3150,8 @@ static ASTnode *postfix_variable(ASTnode * n) {
 
         // Stop looping if the next token isn't a left bracket
         // Otherwise, skip it and get the next expression.
-        if (Thistoken.token != T_LBRACKET) break;
-        scan(&Thistoken);
+        if (State.Thistoken.token != T_LBRACKET) break;
+        scan(&State.Thistoken);
         e = expression();
       }
 
@@ -3180,10 +3223,10 @@ static ASTnode *postfix_variable(ASTnode * n) {
 
   case T_DOT:
     // A member access. Skip the '.'
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 
     // Ensure that it's an identifier
-    if (Thistoken.token != T_IDENT)
+    if (State.Thistoken.token != T_IDENT)
       fatal("Need an identifier after a '.' operator\n");
 
     // Check that n has struct type with any pointer depth (for now)
@@ -3211,15 +3254,13 @@ static ASTnode *postfix_variable(ASTnode * n) {
 
     // Check that the identifier following the '.'
     // is a member of the struct
-    for (memb = ty->memb; memb != NULL; memb = memb->next)
-      if (!strcmp(memb->name, Thistoken.tokstr))
-	break;
-
+    memb = find_member(ty, State.Thistoken.tokstr);
     if (memb == NULL)
-      fatal("No member named %s in struct %s\n", Thistoken.tokstr, n->strlit);
+      fatal("No member named %s in struct %s\n", State.Thistoken.tokstr,
+	    n->strlit);
 
     // Skip the identifier
-    scan(&Thistoken);
+    scan(&State.Thistoken);
 
     // Make a NUMLIT node with the member's offset
     off = mkastleaf(A_NUMLIT, ty_uint64, true, NULL, memb->offset);
@@ -0,0 +1,690 @@
+// Precompiled headers for the alic compiler
+// (c) 2025 Warren Toomey, GPL3
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "alic.h"
+#include "proto.h"
+
+// A header which only has declarations can be precompiled
+// with "alic -H file.ah" into file.ahc. This holds the
+// macros, types and global symbols which the header makes.
+// When the header is included and file.ahc is up to date,
+// the pre-processor defines the macros and tells the lexer
+// to load the types and symbols, instead of pre-processing
+// and parsing the header again.
+//
+// The file holds, in order:
+//  - a magic string and the compiler's identity
+//  - the header's include guard, or an empty string
+//  - the files which were read, with their sizes and times
+//  - the names which were looked up but were not macros:
+//    these must still not be macros when we use the file
+//  - the macros
+//  - the types, in the order in which they were made
+//  - the global symbols
+// A Type pointer is stored as an index: -1 for NULL,
+// then the NUMBUILTIN built-in types, then the types in
+// the file.
+
+#define PCHMAGIC "ALICPCH1"
+
+struct Pch {
+  char *header;			// Interned name of the header
+  char *guard;			// Its include guard, or NULL
+  char *data;			// The .ahc file's contents, or NULL
+  size_t len;			// if we can't use it
+  char **reqs;			// Names which must not be macros
+  int nreqs;
+  char *macros;			// Where the macros start in data
+  char *decls;			// Where the types start in data
+  uint64_t hash;		// Hash of the data
+  off_t size;			// Size and time of the .ahc file,
+  struct timespec mtime;	// or -1 if there isn't one
+  Pch *next;
+};
+
+// The headers that we have looked for. The threads
+// share them, and only read a header's data once
+// it is on the list
+static Pch *Pchhead = NULL;
+static pthread_mutex_t Pchlock = PTHREAD_MUTEX_INITIALIZER;
+
+// Writing a precompiled header
+
+static FILE *Wfh;		// The file we are writing
+static Type **Wtypes;		// The types being written
+static int Numwtypes;
+static int Nummacros;
+
+// Write out an integer
+static void put_int(int64_t val) {
+  fwrite(&val, sizeof(val), 1, Wfh);
+}
+
+// Write out a string which may be NULL
+static void put_str(char *s) {
+  if (s == NULL) {
+    put_int(-1);
+    return;
+  }
+  put_int(strlen(s));
+  fwrite(s, 1, strlen(s), Wfh);
+}
+
+// Write out a Type pointer as an index
+static void put_type(Type * ty) {
+  int i;
+
+  if (ty == NULL) {
+    put_int(-1);
+    return;
+  }
+  for (i = 0; i < NUMBUILTIN; i++)
+    if (ty == builtin_type(i)) {
+      put_int(i);
+      return;
+    }
+  for (i = 0; i < Numwtypes; i++)
+    if (ty == Wtypes[i]) {
+      put_int(NUMBUILTIN + i);
+      return;
+    }
+  fatal("Cannot precompile a reference to type %s\n", get_typename(ty));
+}
+
+// Write out a symbol with its parameters
+// and any exception variable
+static void put_sym(Sym * s) {
+  Sym *p;
+  int i, count;
+
+  put_str(s->name);
+  put_int(s->symtype);
+  put_int(s->visibility);
+  put_int(s->has_addr);
+  put_int(s->has_block);
+  put_type(s->type);
+  put_int(s->count);
+  put_int(s->is_variadic);
+  put_int(s->is_const);
+  put_int(s->is_inout);
+  put_int(s->offset);
+  put_int(s->dimensions);
+  count = (s->dimsize == NULL) ? 0 : s->dimensions;
+  put_int(count);
+  for (i = 0; i < count; i++)
+    put_int(s->dimsize[i]);
+  put_type(s->keytype);
+
+  for (count = 0, p = s->paramlist; p != NULL; p = p->next)
+    count++;
+  put_int(count);
+  for (p = s->paramlist; p != NULL; p = p->next)
+    put_sym(p);
+
+  put_int(s->exceptvar != NULL);
+  if (s->exceptvar != NULL)
+    put_sym(s->exceptvar);
+}
+
+// Count the macros
+static void count_macro(char *name, int nparams, char **params, char *body) {
+  Nummacros++;
+}
+
+// Write out a macro
+static void put_macro(char *name, int nparams, char **params, char *body) {
+  int i;
+
+  put_str(name);
+  put_int(nparams);
+  for (i = 0; i < nparams; i++)
+    put_str(params[i]);
+  put_str(body);
+}
+
+// Write out the types, first the details
+// that we need to find or make each one,
+// then the rest of each type
+static void put_types(void) {
+  Type *ty;
+  Paramtype *pt;
+  Sym *memb;
+  int i, count;
+
+  // Get the types in the order that they were made
+  Numwtypes = 0;
+  for (ty = State.Typehead; ty != NULL; ty = ty->next)
+    Numwtypes++;
+  Wtypes = (Type **) Malloc(Numwtypes * sizeof(Type *) + 1);
+  i = Numwtypes;
+  for (ty = State.Typehead; ty != NULL; ty = ty->next) {
+    for (count = 0; count < NUMBUILTIN; count++)
+      if (ty == builtin_type(count))
+	break;
+    if (count == NUMBUILTIN)
+      Wtypes[--i] = ty;
+  }
+  Numwtypes -= i;
+  memmove(Wtypes, Wtypes + i, Numwtypes * sizeof(Type *));
+
+  put_int(Numwtypes);
+  for (i = 0; i < Numwtypes; i++) {
+    ty = Wtypes[i];
+    put_str(ty->name);
+    put_int(ty->kind);
+    put_int(ty->size);
+    put_int(ty->is_unsigned);
+    put_int(ty->ptr_depth);
+  }
+
+  for (i = 0; i < Numwtypes; i++) {
+    ty = Wtypes[i];
+    put_type(ty->basetype);
+    put_int(ty->lower);
+    put_int(ty->upper);
+    put_type(ty->rettype);
+    put_type(ty->excepttype);
+    put_int(ty->is_variadic);
+
+    for (count = 0, pt = ty->paramtype; pt != NULL; pt = pt->next)
+      count++;
+    put_int(count);
+    for (pt = ty->paramtype; pt != NULL; pt = pt->next) {
+      put_type(pt->type);
+      put_int(pt->is_const);
+      put_int(pt->is_inout);
+    }
+
+    for (count = 0, memb = ty->memb; memb != NULL; memb = memb->next)
+      count++;
+    put_int(count);
+    for (memb = ty->memb; memb != NULL; memb = memb->next)
+      put_sym(memb);
+  }
+}
+
+// Write out the precompiled header for the named header,
+// which has been pre-processed and parsed
+void pch_write(char *header) {
+  char name[TEXTLEN], tmpname[TEXTLEN + 16];
+  char path[PATH_MAX];
+  char **list;
+  struct stat sb;
+  Sym *s;
+  int i, count;
+
+  snprintf(name, sizeof(name), "%sc", header);
+  snprintf(tmpname, sizeof(tmpname), "%s.%d", name, (int) getpid());
+  if ((Wfh = fopen(tmpname, "w")) == NULL) {
+    fprintf(stderr, "Unable to create %s: %s\n", tmpname, strerror(errno));
+    exit(1);
+  }
+
+  fwrite(PCHMAGIC, 1, strlen(PCHMAGIC), Wfh);
+  put_str(compiler_id());
+  put_str(pp_guard(header));
+
+  // The files read. A file which we looked
+  // for but didn't find has a size of -1
+  list = pp_files(&count);
+  put_int(count);
+  for (i = 0; i < count; i++) {
+    if (stat(list[i], &sb) == 0 && realpath(list[i], path) != NULL) {
+      put_str(path);
+      put_int(sb.st_size);
+      put_int(sb.st_mtim.tv_sec);
+      put_int(sb.st_mtim.tv_nsec);
+    } else {
+      put_str(list[i]);
+      put_int(-1);
+      put_int(0);
+      put_int(0);
+    }
+  }
+
+  list = pp_missed(&count);
+  put_int(count);
+  for (i = 0; i < count; i++)
+    put_str(list[i]);
+
+  Nummacros = 0;
+  pp_walk_macros(count_macro);
+  put_int(Nummacros);
+  pp_walk_macros(put_macro);
+
+  put_types();
+
+  for (count = 0, s = global_symbols(); s != NULL; s = s->next)
+    count++;
+  put_int(count);
+  for (s = global_symbols(); s != NULL; s = s->next)
+    put_sym(s);
+
+  free(Wtypes);
+  if (ferror(Wfh) || fclose(Wfh) != 0 || rename(tmpname, name) != 0) {
+    unlink(tmpname);
+    fprintf(stderr, "Unable to write %s\n", name);
+    exit(1);
+  }
+}
+
+// Reading a precompiled header
+
+// Read in an integer
+static int64_t get_int(void) {
+  int64_t val;
+
+  if (State.Thispch->data + State.Thispch->len - State.Rptr <
+      (long) sizeof(val))
+    fatal("Precompiled header %sc is corrupt\n", State.Thispch->header);
+  memcpy(&val, State.Rptr, sizeof(val));
+  State.Rptr += sizeof(val);
+  return (val);
+}
+
+// Read in a string and return it interned, or NULL
+static char *get_str(void) {
+  int64_t len = get_int();
+  char *s, *str;
+
+  if (len == -1)
+    return (NULL);
+  if (len < 0 || State.Thispch->data + State.Thispch->len - State.Rptr < len)
+    fatal("Precompiled header %sc is corrupt\n", State.Thispch->header);
+  s = (char *) Malloc(len + 1);
+  memcpy(s, State.Rptr, len);
+  s[len] = '\0';
+  State.Rptr += len;
+  str = intern(s);
+  free(s);
+  return (str);
+}
+
+// Read in an index and return the Type pointer
+static Type *get_type(void) {
+  int64_t i = get_int();
+
+  if (i == -1)
+    return (NULL);
+  if (i >= 0 && i < NUMBUILTIN)
+    return (builtin_type(i));
+  if (i < 0 || i >= NUMBUILTIN + State.Numrtypes)
+    fatal("Precompiled header %sc is corrupt\n", State.Thispch->header);
+  return (State.Rtypes[i - NUMBUILTIN]);
+}
+
+// Read in a symbol with its parameters
+// and any exception variable
+static Sym *get_sym(void) {
+  Sym *s, *p, *last = NULL;
+  int i, count;
+
+  s = (Sym *) Aalloc(State.Permarena, sizeof(Sym));
+  s->name = get_str();
+  s->symtype = get_int();
+  s->visibility = get_int();
+  s->has_addr = get_int();
+  s->has_block = get_int();
+  s->type = get_type();
+  s->count = get_int();
+  s->is_variadic = get_int();
+  s->is_const = get_int();
+  s->is_inout = get_int();
+  s->offset = get_int();
+  s->dimensions = get_int();
+  count = get_int();
+  if (count > 0) {
+    s->dimsize = (int *) Malloc(count * sizeof(int));
+    for (i = 0; i < count; i++)
+      s->dimsize[i] = get_int();
+  }
+  s->keytype = get_type();
+
+  count = get_int();
+  for (i = 0; i < count; i++) {
+    p = get_sym();
+    if (last == NULL)
+      s->paramlist = p;
+    else
+      last->next = p;
+    last = p;
+  }
+
+  if (get_int())
+    s->exceptvar = get_sym();
+  return (s);
+}
+
+// Read in the whole of the named file and set *len
+// to its size. Return NULL if we can't read it
+static char *read_file(char *name, size_t * len) {
+  struct stat sb;
+  char *data;
+  FILE *fh;
+
+  if ((fh = fopen(name, "r")) == NULL)
+    return (NULL);
+  if (fstat(fileno(fh), &sb) == -1) {
+    fclose(fh);
+    return (NULL);
+  }
+  data = (char *) Malloc(sb.st_size + 1);
+  if (fread(data, 1, sb.st_size, fh) != sb.st_size) {
+    free(data);
+    data = NULL;
+  }
+  fclose(fh);
+  *len = sb.st_size;
+  return (data);
+}
+
+// Check that the precompiled header was made by this
+// compiler and that the files it read are unchanged.
+// Get the details we need to use it. Return true if
+// we can use it
+static bool check_pch(Pch * p) {
+  struct stat sb;
+  char *name;
+  int64_t size, sec, nsec;
+  int i, count;
+
+  State.Thispch = p;
+  State.Rptr = p->data;
+  if (p->len < strlen(PCHMAGIC) ||
+      memcmp(State.Rptr, PCHMAGIC, strlen(PCHMAGIC)))
+    return (false);
+  State.Rptr += strlen(PCHMAGIC);
+  if (get_str() != intern(compiler_id()))
+    return (false);
+  p->guard = get_str();
+
+  count = get_int();
+  for (i = 0; i < count; i++) {
+    name = get_str();
+    size = get_int();
+    sec = get_int();
+    nsec = get_int();
+    if (stat(name, &sb) == -1) {
+      if (size != -1)
+	return (false);
+    } else if (size != sb.st_size || sec != sb.st_mtim.tv_sec ||
+	       nsec != sb.st_mtim.tv_nsec)
+      return (false);
+  }
+
+  p->nreqs = get_int();
+  p->reqs = (char **) Malloc(p->nreqs * sizeof(char *) + 1);
+  for (i = 0; i < p->nreqs; i++)
+    p->reqs[i] = get_str();
+
+  // Skip the macros to find the types
+  p->macros = State.Rptr;
+  count = get_int();
+  for (i = 0; i < count; i++) {
+    get_str();
+    for (size = get_int(); size > 0; size--)
+      get_str();
+    get_str();
+  }
+  p->decls = State.Rptr;
+  return (true);
+}
+
+// Get the size and modification time of a
+// header's .ahc file. The size is -1 if there
+// isn't one
+static void pch_filestat(char *header, off_t * size,
+			 struct timespec *mtime) {
+  char name[TEXTLEN];
+  struct stat sb;
+
+  snprintf(name, sizeof(name), "%sc", header);
+  if (stat(name, &sb) == -1) {
+    *size = -1;
+    mtime->tv_sec = mtime->tv_nsec = 0;
+  } else {
+    *size = sb.st_size;
+    *mtime = sb.st_mtim;
+  }
+}
+
+// Search the list for a header. Return it or NULL
+static Pch *pch_lookup(char *header) {
+  Pch *p;
+
+  pthread_mutex_lock(&Pchlock);
+  for (p = Pchhead; p != NULL; p = p->next)
+    if (p->header == header)
+      break;
+  pthread_mutex_unlock(&Pchlock);
+  return (p);
+}
+
+// Given the path to a header file, return its
+// precompiled header if there is one that we can use
+Pch *pch_find(char *path) {
+  char name[TEXTLEN];
+  Pch *p, *other;
+  size_t i;
+
+  path = intern(path);
+  if ((p = pch_lookup(path)) != NULL)
+    return ((p->data != NULL) ? p : NULL);
+
+  // We haven't seen it before. Remember it, even if
+  // we can't use it, so that we only look for it once
+  p = (Pch *) Calloc(sizeof(Pch));
+  p->header = path;
+  pch_filestat(path, &p->size, &p->mtime);
+
+  snprintf(name, sizeof(name), "%sc", path);
+  if ((p->data = read_file(name, &p->len)) != NULL) {
+    if (check_pch(p) == false) {
+      free(p->data);
+      p->data = NULL;
+    } else {
+      // Get a FNV-1a hash of the contents
+      p->hash = 0xcbf29ce484222325ULL;
+      for (i = 0; i < p->len; i++) {
+	p->hash ^= (uint8_t) p->data[i];
+	p->hash *= 0x100000001b3ULL;
+      }
+    }
+  }
+
+  // Add it to the list, unless another
+  // thread has added it in the meantime
+  pthread_mutex_lock(&Pchlock);
+  for (other = Pchhead; other != NULL; other = other->next)
+    if (other->header == path)
+      break;
+  if (other == NULL) {
+    p->next = Pchhead;
+    Pchhead = p;
+  }
+  pthread_mutex_unlock(&Pchlock);
+  if (other != NULL) {
+    free(p->data);
+    free(p->reqs);
+    free(p);
+    p = other;
+  }
+  return ((p->data != NULL) ? p : NULL);
+}
+
+// Forget the headers whose .ahc files, or the files
+// which they were made from, have changed since we
+// looked for them. They are looked for again when next
+// included. A compiler server calls this before each
+// compile, as it keeps the headers for a long time
+void pch_recheck(void) {
+  Pch *p, **prev;
+  struct timespec mtime;
+  off_t size;
+  bool ok;
+
+  pthread_mutex_lock(&Pchlock);
+  prev = &Pchhead;
+  while ((p = *prev) != NULL) {
+    pch_filestat(p->header, &size, &mtime);
+    ok = (size == p->size && mtime.tv_sec == p->mtime.tv_sec &&
+	  mtime.tv_nsec == p->mtime.tv_nsec);
+    if (ok && p->data != NULL) {
+      free(p->reqs);
+      p->reqs = NULL;
+      ok = check_pch(p);
+    }
+
+    if (ok) {
+      prev = &p->next;
+      continue;
+    }
+    *prev = p->next;
+    free(p->data);
+    free(p->reqs);
+    free(p);
+  }
+  pthread_mutex_unlock(&Pchlock);
+}
+
+// Return the header's include guard, or NULL
+char *pch_guard(Pch * p) {
+  return (p->guard);
+}
+
+// Return the name of the header
+char *pch_header(Pch * p) {
+  return (p->header);
+}
+
+// If none of the names that the header looked up are
+// now macros, define the header's macros and return
+// the marker for the lexer to load the rest of it.
+// Otherwise return NULL as we can't use it
+char *pch_use(Pch * p) {
+  static _Thread_local char marker[TEXTLEN + 32];
+  char *name, *body, **params;
+  int i, j, count, nparams;
+
+  for (i = 0; i < p->nreqs; i++)
+    if (pp_defined(p->reqs[i]))
+      return (NULL);
+
+  State.Thispch = p;
+  State.Rptr = p->macros;
+  count = get_int();
+  for (i = 0; i < count; i++) {
+    name = get_str();
+    nparams = get_int();
+    params = NULL;
+    if (nparams >= 0) {
+      params = (char **) Malloc(nparams * sizeof(char *) + 1);
+      for (j = 0; j < nparams; j++)
+	params[j] = get_str();
+    }
+    body = get_str();
+    pp_define(name, nparams, params, body);
+  }
+
+  // The hash is in the marker so that the pre-processed
+  // text changes when the precompiled header does
+  snprintf(marker, sizeof(marker), "# pch \"%s\" %016llx\n",
+	   p->header, (unsigned long long) p->hash);
+  return (marker);
+}
+
+// Load the types and global symbols from the named
+// header's precompiled header. Types and symbols
+// which already exist are not made again.
+void pch_load(char *header) {
+  Type *ty;
+  Paramtype *pt, *lastpt;
+  Sym *s, *g, *next, *memb, *lastmemb;
+  char *name;
+  bool *fill;
+  int i, j, count, kind, size, is_unsigned, ptr_depth;
+
+  State.Thispch = pch_lookup(intern(header));
+  if (State.Thispch == NULL || State.Thispch->data == NULL)
+    fatal("Unable to load the precompiled header for %s\n", header);
+  State.Rptr = State.Thispch->decls;
+
+  // Find or make each type
+  State.Numrtypes = get_int();
+  State.Rtypes = (Type **) Malloc(State.Numrtypes * sizeof(Type *) + 1);
+  fill = (bool *) Malloc(State.Numrtypes * sizeof(bool) + 1);
+  for (i = 0; i < State.Numrtypes; i++) {
+    name = get_str();
+    kind = get_int();
+    size = get_int();
+    is_unsigned = get_int();
+    ptr_depth = get_int();
+
+    // Unnamed user-defined types are never shared.
+    // An existing opaque type can be defined here
+    ty = NULL;
+    if (name != NULL || kind < TY_USER)
+      ty = find_type(name, kind, is_unsigned, ptr_depth);
+    if (ty != NULL && (name == NULL || ptr_depth != 0 ||
+		       ty->size != 0 || size == 0)) {
+      State.Rtypes[i] = ty;
+      fill[i] = false;
+      continue;
+    }
+    State.Rtypes[i] = new_type(kind, size, is_unsigned, ptr_depth, name, NULL);
+    fill[i] = true;
+  }
+
+  // Now fill in the rest of the new types.
+  // Read but ignore the details of the others
+  for (i = 0; i < State.Numrtypes; i++) {
+    ty = (fill[i]) ? State.Rtypes[i] : &(Type) { 0 };
+    ty->basetype = get_type();
+    ty->lower = get_int();
+    ty->upper = get_int();
+    ty->rettype = get_type();
+    ty->excepttype = get_type();
+    ty->is_variadic = get_int();
+
+    count = get_int();
+    for (j = 0, lastpt = NULL; j < count; j++) {
+      pt = (Paramtype *) Malloc(sizeof(Paramtype));
+      pt->type = get_type();
+      pt->is_const = get_int();
+      pt->is_inout = get_int();
+      pt->next = NULL;
+      if (lastpt == NULL)
+	ty->paramtype = pt;
+      else
+	lastpt->next = pt;
+      lastpt = pt;
+    }
+
+    count = get_int();
+    for (j = 0, lastmemb = NULL; j < count; j++) {
+      memb = get_sym();
+      if (fill[i])
+	add_member(ty, memb, lastmemb);
+      lastmemb = memb;
+    }
+  }
+
+  // Add the global symbols which don't already exist
+  count = get_int();
+  for (i = 0; i < count; i++) {
+    s = get_sym();
+    g = add_symbol(s->name, s->symtype, s->type, s->visibility);
+    if (g != NULL) {
+      next = g->next;
+      *g = *s;
+      g->next = next;
+    }
+  }
+
+  free(fill);
+  free(State.Rtypes);
+  State.Rtypes = NULL;
+}
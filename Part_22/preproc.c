@@ -0,0 +1,1425 @@
+// Pre-processor for the alic compiler
+// (c) 2025 Warren Toomey, GPL3
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "alic.h"
+#include "proto.h"
+
+// We deal with #include, #define, #undef, #if, #ifdef,
+// #ifndef, #elif, #else, #endif and #error, and we remove
+// all comments. Macros can use # and ##, and the call of
+// a function-like macro can span several lines. Like cpp,
+// we predefine __LINE__, __FILE__ and the macros that
+// name the host system. The result is a buffer of text with
+// # line "file" markers, just like the output of cpp,
+// which the lexer then reads. An included header with an
+// up to date precompiled header is replaced by a
+// # pch "file" marker, and the lexer loads it.
+
+// A growable text buffer
+typedef struct Textbuf Textbuf;
+struct Textbuf {
+  char *text;			// The text, NUL terminated
+  size_t len;			// Its length
+  size_t size;			// Size of the allocated memory
+};
+
+// A macro definition
+struct Macro {
+  char *name;			// Interned macro name
+  char *body;			// The replacement text
+  int nparams;			// Number of parameters, or -1 if object-like
+  char **params;		// Interned parameter names
+  bool disabled;		// Set while we are expanding the macro
+  bool from_file;		// Defined by an input file, not a header
+  Macro *next;			// Next macro in the same hash bucket
+};
+
+// Each file that we read in is kept, so that
+// a header is only read and cleaned up once.
+// If the whole file is wrapped in an include guard,
+// we keep the guard's name so that we can skip
+// the file entirely when the guard is defined.
+struct Srcfile {
+  char *name;			// Interned file name
+  char *text;			// The file's text without comments
+  char *guard;			// The include guard macro, or NULL
+  Srcfile *next;
+};
+
+#define MAXINCLUDE 200		// Maximum #include nesting
+#define MAXCOND 64		// Maximum #if nesting in a file
+
+// While we expand a line of a file, Lineend points at
+// its end. A macro call which runs past the end can use
+// the following lines: Lineend moves to the end of the
+// last one used, and Morelines counts the lines added
+
+// The macros which cpp would define for this system
+static char *Predefined[] = {
+  "__STDC__ 1",
+#ifdef __x86_64__
+  "__x86_64__ 1",
+#endif
+#ifdef __aarch64__
+  "__aarch64__ 1",
+#endif
+#ifdef __riscv
+  "__riscv 1",
+#endif
+#ifdef __linux__
+  "__linux__ 1",
+#endif
+#ifdef __FreeBSD__
+  "__FreeBSD__ 1",
+#endif
+#ifdef __APPLE__
+  "__APPLE__ 1",
+#endif
+#ifdef __unix__
+  "__unix__ 1",
+#endif
+  NULL
+};
+
+// When we are precompiling a header, we record the names
+// which were looked up but were not macros, and the files
+// which were read. We don't use any precompiled headers then
+
+// Add a name to a list if it is not already there
+static void add_name(Namelist * l, char *name) {
+  int i;
+
+  for (i = 0; i < l->count; i++)
+    if (l->name[i] == name)
+      return;
+  if (l->count == l->size) {
+    l->size = (l->size == 0) ? 64 : l->size * 2;
+    l->name = (char **) realloc(l->name, l->size * sizeof(char *));
+    if (l->name == NULL)
+      fatal("Malloc failure\n");
+  }
+  l->name[l->count++] = name;
+}
+
+// Append len characters to a text buffer
+static void addtext(Textbuf * b, char *s, size_t len) {
+  if (b->len + len + 1 > b->size) {
+    b->size = (b->size == 0) ? 4096 : b->size;
+    while (b->len + len + 1 > b->size)
+      b->size *= 2;
+    b->text = (char *) realloc(b->text, b->size);
+    if (b->text == NULL)
+      fatal("Malloc failure\n");
+  }
+  memcpy(b->text + b->len, s, len);
+  b->len += len;
+  b->text[b->len] = '\0';
+}
+
+// Append a string to a text buffer
+static void addstr(Textbuf * b, char *s) {
+  addtext(b, s, strlen(s));
+}
+
+// Is this a character which can start an identifier?
+static bool is_identstart(int c) {
+  return (isalpha(c) || c == '_');
+}
+
+// Is this a character which can be in an identifier?
+static bool is_identchar(int c) {
+  return (isalnum(c) || c == '_');
+}
+
+// Given a pointer to the start of an identifier, return
+// the interned identifier and set *end past it
+static char *getident(char *s, char **end) {
+  char buf[TEXTLEN];
+  int i;
+
+  for (i = 0; is_identchar(s[i]); i++) {
+    if (i == TEXTLEN - 1)
+      fatal("Identifier too long\n");
+    buf[i] = s[i];
+  }
+  buf[i] = '\0';
+  *end = s + i;
+  return (intern(buf));
+}
+
+// Skip spaces and tabs
+static char *skipblank(char *s) {
+  while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\f' || *s == '\v')
+    s++;
+  return (s);
+}
+
+// Return the length of the line starting at s,
+// not including the newline
+static size_t linelen(char *s) {
+  char *nl = strchr(s, '\n');
+  return (nl == NULL) ? strlen(s) : (size_t) (nl - s);
+}
+
+// Given a pointer to a quote character, return
+// a pointer to the character after the literal
+static char *skipliteral(char *s) {
+  int quote = *s++;
+
+  while (*s && *s != quote && *s != '\n') {
+    if (*s == '\\' && s[1] != '\0')
+      s++;
+    s++;
+  }
+  if (*s == quote)
+    s++;
+  return (s);
+}
+
+// Find a macro by its interned name, or return NULL
+static Macro *find_macro(char *name) {
+  Macro *m;
+
+  for (m = State.Macrohash[namehash(name) & (MACROHASHSIZE - 1)]; m != NULL;
+       m = m->next)
+    if (m->name == name)
+      return (m);
+  if (State.Recording)
+    add_name(&State.Missed, name);
+  return (NULL);
+}
+
+// Free a macro definition
+static void free_macro(Macro * m) {
+  free(m->params);
+  free(m->body);
+  free(m);
+}
+
+// Remove a macro definition
+static void undef_macro(char *name) {
+  Macro **prev, *m;
+
+  // A precompiled header can't undefine a macro
+  // that the includer has defined
+  if (State.Recording)
+    add_name(&State.Missed, name);
+
+  prev = &State.Macrohash[namehash(name) & (MACROHASHSIZE - 1)];
+  for (m = *prev; m != NULL; prev = &(m->next), m = m->next)
+    if (m->name == name) {
+      *prev = m->next;
+      free_macro(m);
+      return;
+    }
+}
+
+// Remove each ## and the whitespace around it
+// from a macro body, pasting the tokens together
+static void paste_body(char *body) {
+  char *s = body, *o = body, *start;
+
+  while (*s) {
+    if (*s == '"' || *s == '\'') {
+      start = s;
+      s = skipliteral(s);
+      memmove(o, start, s - start);
+      o += s - start;
+    } else if (s[0] == '#' && s[1] == '#') {
+      while (o > body && (o[-1] == ' ' || o[-1] == '\t'))
+	o--;
+      s = skipblank(s + 2);
+    } else
+      *o++ = *s++;
+  }
+  *o = '\0';
+}
+
+// Given the text after "#define", add the macro.
+// from_file is true if an input file defines it
+static void define_macro(char *s, bool from_file) {
+  Macro *m;
+  char *name, *end;
+  char *params[TEXTLEN];
+  int len;
+
+  s = skipblank(s);
+  if (!is_identstart(*s))
+    fatal("Expecting a macro name after #define\n");
+  name = getident(s, &s);
+
+  m = (Macro *) Calloc(sizeof(Macro));
+  m->name = name;
+  m->nparams = -1;
+  m->from_file = from_file;
+
+  // A '(' straight after the name
+  // starts a list of parameters
+  if (*s == '(') {
+    m->nparams = 0;
+    s = skipblank(s + 1);
+    while (*s != ')') {
+      if (!is_identstart(*s))
+	fatal("Bad parameter list for macro %s\n", name);
+      if (m->nparams == TEXTLEN)
+	fatal("Too many parameters for macro %s\n", name);
+      params[m->nparams++] = getident(s, &s);
+      s = skipblank(s);
+      if (*s == ',')
+	s = skipblank(s + 1);
+      else if (*s != ')')
+	fatal("Bad parameter list for macro %s\n", name);
+    }
+    s++;
+    m->params = (char **) Malloc(m->nparams * sizeof(char *) + 1);
+    memcpy(m->params, params, m->nparams * sizeof(char *));
+  }
+
+  // The body is the rest of the line without
+  // any leading or trailing whitespace
+  s = skipblank(s);
+  for (end = s + strlen(s); end > s && isspace(end[-1]); end--);
+  len = end - s;
+  if ((len >= 2 && !strncmp(s, "##", 2)) ||
+      (len >= 3 && !strncmp(end - 2, "##", 2)))
+    fatal("'##' at either end of macro %s\n", name);
+  m->body = (char *) Malloc(len + 1);
+  memcpy(m->body, s, len);
+  m->body[len] = '\0';
+
+  // An object-like macro has nothing to substitute,
+  // so we can do any ## pasting now
+  if (m->nparams == -1)
+    paste_body(m->body);
+
+  // Replace any existing definition
+  undef_macro(name);
+  m->next = State.Macrohash[namehash(name) & (MACROHASHSIZE - 1)];
+  State.Macrohash[namehash(name) & (MACROHASHSIZE - 1)] = m;
+}
+
+static void expand(char *s, size_t len, Textbuf * out);
+
+// Copy an argument of a macro call to a buffer.
+// Each run of whitespace, which may include the
+// newlines of a call over several lines, becomes a space
+static void copy_arg(Textbuf * b, char *s, char *end) {
+  char *start;
+
+  while (s < end) {
+    if (*s == '"' || *s == '\'') {
+      start = s;
+      s = skipliteral(s);
+      addtext(b, start, s - start);
+    } else if (isspace(*s)) {
+      while (s < end && isspace(*s))
+	s++;
+      addstr(b, " ");
+    } else
+      addtext(b, s++, 1);
+  }
+}
+
+// Add the argument text to the buffer as a string
+// literal, escaping any '"' and '\' in literals
+static void stringify(Textbuf * b, Textbuf * arg) {
+  char *s, *end, *lit = NULL;
+
+  addstr(b, "\"");
+  for (s = arg->text, end = s + arg->len; s < end; s++) {
+    if (s == lit)
+      lit = NULL;
+    if (lit == NULL && (*s == '"' || *s == '\''))
+      lit = skipliteral(s);
+    if (*s == '"' || (lit != NULL && *s == '\\'))
+      addstr(b, "\\");
+    addtext(b, s, 1);
+  }
+  addstr(b, "\"");
+}
+
+// Return the position of the interned
+// name in the macro's parameters, or -1
+static int find_param(Macro * m, char *name) {
+  int i;
+
+  for (i = 0; i < m->nparams; i++)
+    if (m->params[i] == name)
+      return (i);
+  return (-1);
+}
+
+// Given a function-like macro and a pointer to the
+// '(' after its name, collect and expand the arguments,
+// substitute them into the body and expand the result.
+// Return a pointer to the character after the ')'
+static char *expand_funcmacro(Macro * m, char *s, char *end, Textbuf * out) {
+  Textbuf *args, *raw, *arg, body = { NULL, 0, 0 };
+  char *start, *b, *ident;
+  int depth = 0, nargs = 0, i;
+  size_t maxargs = (m->nparams > 0) ? m->nparams : 1;
+  bool paste = false;
+
+  args = (Textbuf *) Calloc(maxargs * sizeof(Textbuf));
+  raw = (Textbuf *) Calloc(maxargs * sizeof(Textbuf));
+
+  // Split the arguments at the top-level commas. Keep
+  // each one as is, and also macro expand each one
+  for (start = ++s; ; s++) {
+    // The call can carry on to the next line
+    // of the file, but not past its end
+    if (s == end) {
+      if (end != State.Lineend || *end == '\0')
+	fatal("Unterminated argument list for macro %s\n", m->name);
+      end = State.Lineend = end + 1 + linelen(end + 1);
+      State.Morelines++;
+      continue;
+    }
+    if (*s == '"' || *s == '\'') {
+      s = skipliteral(s) - 1;
+      continue;
+    }
+    if (*s == '(')
+      depth++;
+    if ((*s == ',' && depth == 0) || (*s == ')' && depth-- == 0)) {
+      while (isspace(*start))
+	start++;
+      for (b = s; b > start && isspace(b[-1]); b--);
+      if (nargs < maxargs) {
+	copy_arg(&raw[nargs], start, b);
+	expand(raw[nargs].text, raw[nargs].len, &args[nargs]);
+      }
+      if (nargs > 0 || b > start || *s == ',')
+	nargs++;
+      start = s + 1;
+      if (*s == ')')
+	break;
+    }
+  }
+
+  // A single empty argument is still an argument
+  if (m->nparams == 1 && nargs == 0)
+    nargs = 1;
+
+  if (nargs != ((m->nparams > 0) ? m->nparams : 0))
+    fatal("Macro %s needs %d arguments, got %d\n",
+	  m->name, m->nparams, nargs);
+
+  // Substitute the arguments into the body. The
+  // operands of # and ## are not macro expanded
+  for (b = m->body; *b;) {
+    if (*b == '"' || *b == '\'') {
+      start = b;
+      b = skipliteral(b);
+      addtext(&body, start, b - start);
+    } else if (b[0] == '#' && b[1] == '#') {
+      while (body.len > 0 && (body.text[body.len - 1] == ' ' ||
+			      body.text[body.len - 1] == '\t'))
+	body.len--;
+      b = skipblank(b + 2);
+      paste = true;
+      continue;
+    } else if (*b == '#') {
+      b = skipblank(b + 1);
+      if (!is_identstart(*b) || (i = find_param(m, getident(b, &b))) == -1)
+	fatal("'#' is not followed by a parameter in macro %s\n", m->name);
+      stringify(&body, &raw[i]);
+    } else if (is_identstart(*b)) {
+      ident = getident(b, &b);
+      if ((i = find_param(m, ident)) == -1)
+	addstr(&body, ident);
+      else {
+	arg = (paste || !strncmp(skipblank(b), "##", 2)) ? &raw[i] : &args[i];
+	if (arg->len > 0)
+	  addtext(&body, arg->text, arg->len);
+      }
+    } else
+      addtext(&body, b++, 1);
+    paste = false;
+  }
+
+  // Now expand the body with this macro disabled
+  m->disabled = true;
+  if (body.len > 0)
+    expand(body.text, body.len, out);
+  m->disabled = false;
+
+  for (i = 0; i < maxargs; i++) {
+    free(args[i].text);
+    free(raw[i].text);
+  }
+  free(args);
+  free(raw);
+  free(body.text);
+  return (s + 1);
+}
+
+// If the name is __LINE__ or __FILE__, add its
+// value to the buffer and return true
+static bool expand_builtin(char *name, Textbuf * out) {
+  char buf[TEXTLEN + 32];
+
+  if (name[0] != '_' || name[1] != '_')
+    return (false);
+  if (!strcmp(name, "__LINE__"))
+    snprintf(buf, sizeof(buf), "%d", State.Line);
+  else if (!strcmp(name, "__FILE__"))
+    snprintf(buf, sizeof(buf), "\"%s\"", State.Infilename);
+  else
+    return (false);
+  addstr(out, buf);
+  return (true);
+}
+
+// Copy len characters of text to the output buffer,
+// expanding any macros in it
+static void expand(char *s, size_t len, Textbuf * out) {
+  char *end = s + len;
+  char *start, *name, *p;
+  bool online;
+  int lines;
+  Macro *m;
+
+  while (s < end) {
+    start = s;
+
+    // Copy string and character literals as is
+    if (*s == '"' || *s == '\'') {
+      s = skipliteral(s);
+      if (s > end)
+	s = end;
+      addtext(out, start, s - start);
+      continue;
+    }
+
+    // Copy numbers as is, so that we
+    // don't expand e.g. the x1F in 0x1F
+    if (isdigit(*s)) {
+      while (s < end && (is_identchar(*s) || *s == '.'))
+	s++;
+      addtext(out, start, s - start);
+      continue;
+    }
+
+    // Copy anything which isn't an identifier
+    if (!is_identstart(*s)) {
+      addtext(out, s++, 1);
+      continue;
+    }
+
+    // We have an identifier. Copy it if it isn't a macro
+    name = getident(s, &s);
+    m = find_macro(name);
+    if (m == NULL && expand_builtin(name, out))
+      continue;
+    if (m == NULL || m->disabled) {
+      addtext(out, start, s - start);
+      continue;
+    }
+
+    // An object-like macro
+    if (m->nparams == -1) {
+      m->disabled = true;
+      expand(m->body, strlen(m->body), out);
+      m->disabled = false;
+      continue;
+    }
+
+    // A function-like macro, but only if it is followed
+    // by a '('. On a line of a file, this can be on a
+    // following line
+    online = (end == State.Lineend);
+    for (p = s, lines = 0; (p < end || online) && isspace(*p); p++)
+      if (*p == '\n')
+	lines++;
+    if ((p >= end && !online) || *p != '(') {
+      addtext(out, start, s - start);
+      continue;
+    }
+    if (lines > 0) {
+      end = State.Lineend = p + linelen(p);
+      State.Morelines += lines;
+    }
+    s = expand_funcmacro(m, p, end, out);
+
+    // The call may have used more lines
+    if (online)
+      end = State.Lineend;
+  }
+}
+
+// The #if expression evaluator. Expr points at
+// the expression text after any macro expansion.
+// Noeval is non-zero in an operand whose value
+// is not used, e.g. the right of 0 && x
+
+static int64_t eval_ternary(void);
+
+// Skip whitespace in the expression
+static void eval_skip(void) {
+  while (isspace(*State.Expr))
+    State.Expr++;
+}
+
+// Evaluate the escape sequence in a character
+// literal. Expr points after the '\\'
+static int64_t eval_escape(void) {
+  int64_t val;
+  char *end;
+  int i;
+
+  switch (*State.Expr++) {
+  case 'a':
+    return ('\a');
+  case 'b':
+    return ('\b');
+  case 'f':
+    return ('\f');
+  case 'n':
+    return ('\n');
+  case 'r':
+    return ('\r');
+  case 't':
+    return ('\t');
+  case 'v':
+    return ('\v');
+  case 'x':
+    val = strtoll(State.Expr, &end, 16);
+    if (end == State.Expr)
+      fatal("Bad character literal in #if expression\n");
+    State.Expr = end;
+    return ((char) val);
+  }
+
+  // Up to three octal digits
+  State.Expr--;
+  if (*State.Expr >= '0' && *State.Expr <= '7') {
+    for (val = 0, i = 0; i < 3 && *State.Expr >= '0' && *State.Expr <= '7'; i++)
+      val = val * 8 + *State.Expr++ - '0';
+    return ((char) val);
+  }
+
+  // Otherwise the character itself, e.g. \\ or \'
+  return (*State.Expr++);
+}
+
+// Evaluate a primary expression: a number, a character
+// literal, an identifier (which is zero), a unary
+// operator or a parenthesised expression
+static int64_t eval_primary(void) {
+  int64_t val;
+  char *end;
+
+  eval_skip();
+  switch (*State.Expr) {
+  case '(':
+    State.Expr++;
+    val = eval_ternary();
+    eval_skip();
+    if (*State.Expr != ')')
+      fatal("Missing ')' in #if expression\n");
+    State.Expr++;
+    return (val);
+  case '!':
+    State.Expr++;
+    return (!eval_primary());
+  case '-':
+    State.Expr++;
+    return (-eval_primary());
+  case '+':
+    State.Expr++;
+    return (eval_primary());
+  case '~':
+    State.Expr++;
+    return (~eval_primary());
+  case '\'':
+    State.Expr++;
+    if (*State.Expr == '\\') {
+      State.Expr++;
+      val = eval_escape();
+    } else
+      val = *State.Expr++;
+    if (*State.Expr++ != '\'')
+      fatal("Bad character literal in #if expression\n");
+    return (val);
+  }
+
+  if (isdigit(*State.Expr)) {
+    val = strtoll(State.Expr, &end, 0);
+    State.Expr = end;
+    while (*State.Expr == 'u' || *State.Expr == 'U' ||
+	   *State.Expr == 'l' || *State.Expr == 'L')
+      State.Expr++;
+    return (val);
+  }
+
+  if (is_identstart(*State.Expr)) {
+    while (is_identchar(*State.Expr))
+      State.Expr++;
+    return (0);
+  }
+
+  fatal("Bad #if expression\n");
+  return (0);
+}
+
+// List of binary operators and their precedence
+static struct {
+  char *op;
+  int prec;
+} binops[] = {
+  { "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 },
+  { "<=", 7 }, { ">=", 7 }, { "<<", 8 }, { ">>", 8 },
+  { "|", 3 }, { "^", 4 }, { "&", 5 }, { "<", 7 }, { ">", 7 },
+  { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 },
+  { NULL, 0 }
+};
+
+// Evaluate a binary expression using precedence climbing.
+// Only operators with a precedence above minprec are used
+static int64_t eval_binary(int minprec) {
+  int64_t left, right;
+  char *op;
+  int i, prec;
+  bool unused;
+
+  left = eval_primary();
+  while (1) {
+    eval_skip();
+
+    // Find the operator, if any
+    for (i = 0; binops[i].op != NULL; i++)
+      if (!strncmp(State.Expr, binops[i].op, strlen(binops[i].op)))
+	break;
+    op = binops[i].op;
+    prec = binops[i].prec;
+    if (op == NULL || prec <= minprec)
+      return (left);
+
+    // The right of && and || is not used
+    // when the left gives the result
+    State.Expr += strlen(op);
+    unused = (!strcmp(op, "&&") && !left) || (!strcmp(op, "||") && left);
+    State.Noeval += unused;
+    right = eval_binary(prec);
+    State.Noeval -= unused;
+
+    switch (op[0]) {
+    case '|':
+      left = (op[1] == '|') ? (left || right) : (left | right);
+      break;
+    case '&':
+      left = (op[1] == '&') ? (left && right) : (left & right);
+      break;
+    case '^':
+      left = left ^ right;
+      break;
+    case '=':
+      left = (left == right);
+      break;
+    case '!':
+      left = (left != right);
+      break;
+    case '<':
+      if (op[1] == '=')
+	left = (left <= right);
+      else if (op[1] == '<')
+	left = left << right;
+      else
+	left = (left < right);
+      break;
+    case '>':
+      if (op[1] == '=')
+	left = (left >= right);
+      else if (op[1] == '>')
+	left = left >> right;
+      else
+	left = (left > right);
+      break;
+    case '+':
+      left = left + right;
+      break;
+    case '-':
+      left = left - right;
+      break;
+    case '*':
+      left = left * right;
+      break;
+    case '/':
+    case '%':
+      if (right == 0) {
+	if (State.Noeval == 0)
+	  fatal("Division by zero in #if expression\n");
+	left = 0;
+      } else
+	left = (op[0] == '/') ? (left / right) : (left % right);
+      break;
+    }
+  }
+}
+
+// Evaluate a possible ternary expression
+static int64_t eval_ternary(void) {
+  int64_t cond, left, right;
+
+  cond = eval_binary(0);
+  eval_skip();
+  if (*State.Expr != '?')
+    return (cond);
+  State.Expr++;
+  State.Noeval += !cond;
+  left = eval_ternary();
+  State.Noeval -= !cond;
+  eval_skip();
+  if (*State.Expr != ':')
+    fatal("Missing ':' in #if expression\n");
+  State.Expr++;
+  State.Noeval += !!cond;
+  right = eval_ternary();
+  State.Noeval -= !!cond;
+  return (cond ? left : right);
+}
+
+// Given the text after "#if" or "#elif",
+// return true if the expression is true
+static bool eval_if(char *s) {
+  Textbuf text = { NULL, 0, 0 };
+  Textbuf exp = { NULL, 0, 0 };
+  char *name;
+  bool paren;
+  int64_t val;
+
+  // Replace any "defined NAME" or "defined(NAME)"
+  // with 1 or 0 before we expand the macros
+  while (*s) {
+    if (is_identstart(*s)) {
+      char *start = s;
+      name = getident(s, &s);
+      if (strcmp(name, "defined")) {
+	addtext(&text, start, s - start);
+	continue;
+      }
+      s = skipblank(s);
+      paren = (*s == '(');
+      if (paren)
+	s = skipblank(s + 1);
+      if (!is_identstart(*s))
+	fatal("Expecting a macro name after defined\n");
+      name = getident(s, &s);
+      s = skipblank(s);
+      if (paren) {
+	if (*s != ')')
+	  fatal("Missing ')' after defined\n");
+	s++;
+      }
+      addstr(&text, (find_macro(name) != NULL ||
+		     name == intern("__LINE__") ||
+		     name == intern("__FILE__")) ? " 1 " : " 0 ");
+    } else
+      addtext(&text, s++, 1);
+  }
+
+  if (text.len == 0)
+    fatal("Missing expression after #if\n");
+  expand(text.text, text.len, &exp);
+  State.Expr = exp.text;
+  val = eval_ternary();
+  eval_skip();
+  if (*State.Expr != '\0')
+    fatal("Bad #if expression\n");
+
+  free(text.text);
+  free(exp.text);
+  return (val != 0);
+}
+
+// Given the text of a file, return a copy with the
+// comments removed and any lines ending with '\'
+// joined to the next. Like cpp, the newlines that we
+// remove are put back after the end of the line, so
+// that the following lines keep their line numbers.
+static char *clean_text(char *src, size_t len) {
+  char *out = (char *) Malloc(len + 2);
+  char *o = out;
+  char *s = src, *start;
+  int pending = 0;
+
+  while (*s) {
+    // A line continuation
+    if (s[0] == '\\' && s[1] == '\n') {
+      s += 2;
+      pending++;
+      continue;
+    }
+
+    // A // comment: skip to the end of the line
+    if (s[0] == '/' && s[1] == '/') {
+      while (*s && *s != '\n')
+	s++;
+      continue;
+    }
+
+    // A /* */ comment becomes a space
+    if (s[0] == '/' && s[1] == '*') {
+      for (s += 2; *s && !(s[0] == '*' && s[1] == '/'); s++)
+	if (*s == '\n')
+	  pending++;
+      if (*s == '\0')
+	fatal("Unterminated comment\n");
+      s += 2;
+      *o++ = ' ';
+      continue;
+    }
+
+    // Copy string and character literals as is
+    if (*s == '"' || *s == '\'') {
+      start = s;
+      s = skipliteral(s);
+      memcpy(o, start, s - start);
+      o += s - start;
+      continue;
+    }
+
+    // At the end of a line, put back any newlines we removed
+    if (*s == '\n') {
+      *o++ = *s++;
+      State.Line++;
+      for (; pending > 0; pending--, State.Line++)
+	*o++ = '\n';
+      continue;
+    }
+
+    *o++ = *s++;
+  }
+
+  // Ensure the text ends with a newline
+  if (o > out && o[-1] != '\n')
+    *o++ = '\n';
+  for (; pending > 0; pending--)
+    *o++ = '\n';
+  *o = '\0';
+  return (out);
+}
+
+// If the given line is a directive, return a pointer
+// to the directive's name, otherwise return NULL
+static char *directive(char *line) {
+  line = skipblank(line);
+  if (*line != '#')
+    return (NULL);
+  return (skipblank(line + 1));
+}
+
+// If the whole of the text is wrapped in
+// #ifndef NAME ... #endif, return the NAME
+static char *find_guard(char *text) {
+  char *s, *d, *guard = NULL;
+  int depth = 0;
+
+  for (s = text; *s; s += linelen(s) + 1) {
+    // Skip blank lines before the guard
+    if (guard == NULL && *skipblank(s) == '\n')
+      continue;
+
+    d = directive(s);
+
+    // The first non-blank line must be #ifndef
+    if (guard == NULL) {
+      if (d == NULL || strncmp(d, "ifndef", 6) || is_identchar(d[6]))
+	return (NULL);
+      d = skipblank(d + 6);
+      if (!is_identstart(*d))
+	return (NULL);
+      guard = getident(d, &d);
+      depth = 1;
+      continue;
+    }
+
+    // Once we are out of the #ifndef,
+    // there must only be blank lines
+    if (depth == 0) {
+      if (*skipblank(s) != '\n')
+	return (NULL);
+      continue;
+    }
+
+    if (d == NULL)
+      continue;
+    if (!strncmp(d, "if", 2))
+      depth++;
+    else if (!strncmp(d, "endif", 5))
+      depth--;
+  }
+
+  return ((depth == 0) ? guard : NULL);
+}
+
+// Map the named file into memory and return its
+// contents, setting *len to its length. The text is
+// followed by a NUL, as the bytes past the end of a
+// file in its last page are zero. If the file can't
+// be mapped (e.g. a pipe, or its size is a multiple
+// of the page size) then read it into a buffer.
+// *mapped is set true if the file was mapped.
+// Return NULL if the file cannot be opened.
+static char *load_file(char *name, size_t * len, bool *mapped) {
+  Textbuf raw = { NULL, 0, 0 };
+  char buf[65536];
+  struct stat sb;
+  char *text;
+  ssize_t n;
+  int fd;
+
+  if ((fd = open(name, O_RDONLY)) == -1)
+    return (NULL);
+
+  *mapped = false;
+  if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0 &&
+      sb.st_size % sysconf(_SC_PAGESIZE) != 0) {
+    text = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text != MAP_FAILED) {
+      close(fd);
+      *mapped = true;
+      *len = sb.st_size;
+      return (text);
+    }
+  }
+
+  // Read the file in large blocks
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    addtext(&raw, buf, n);
+  if (n == -1)
+    fatal("Unable to read %s\n", name);
+  close(fd);
+  if (raw.text == NULL)
+    addstr(&raw, "");
+  *len = raw.len;
+  return (raw.text);
+}
+
+// Read in the named file, clean it and add it to the
+// list of files. If we already have it, return it.
+// Return NULL if the file cannot be opened
+static Srcfile *read_srcfile(char *name) {
+  Srcfile *f;
+  char *text;
+  size_t len;
+  bool mapped;
+  char *oldname = State.Infilename;
+  int oldline = State.Line;
+
+  name = intern(name);
+  if (State.Recording)
+    add_name(&State.Readfiles, name);
+  for (f = State.Srchead; f != NULL; f = f->next)
+    if (f->name == name)
+      return (f);
+
+  if ((text = load_file(name, &len, &mapped)) == NULL)
+    return (NULL);
+
+  f = (Srcfile *) Calloc(sizeof(Srcfile));
+  f->name = name;
+  State.Infilename = name;
+  State.Line = 1;
+  f->text = clean_text(text, len);
+  f->guard = find_guard(f->text);
+  f->next = State.Srchead;
+  State.Srchead = f;
+  if (mapped)
+    munmap(text, len);
+  else
+    free(text);
+
+  State.Infilename = oldname;
+  State.Line = oldline;
+  return (f);
+}
+
+// Try to include the file with the given path. If there is
+// a usable precompiled header for it, set *pch and return
+// NULL. Otherwise return the file, or NULL if it doesn't exist
+static Srcfile *try_include(char *path, Pch ** pch) {
+  if (State.Recording == false && (*pch = pch_find(path)) != NULL)
+    return (NULL);
+  return (read_srcfile(path));
+}
+
+// Given the text after "#include" and the file with
+// the #include, find and return the included file.
+// If it has a precompiled header, set *pch and return NULL
+static Srcfile *find_include(char *s, Srcfile * parent, Pch ** pch) {
+  char name[TEXTLEN], path[2 * TEXTLEN + 2];
+  char *end, *slash;
+  Srcfile *f = NULL;
+  int close;
+
+  *pch = NULL;
+  s = skipblank(s);
+  if (*s == '"')
+    close = '"';
+  else if (*s == '<')
+    close = '>';
+  else
+    fatal("#include expects \"FILENAME\" or <FILENAME>\n");
+
+  end = strchr(s + 1, close);
+  if (end == NULL || end - s > TEXTLEN - 1)
+    fatal("Bad #include file name\n");
+  memcpy(name, s + 1, end - s - 1);
+  name[end - s - 1] = '\0';
+
+  // Look for a "file" in the parent's directory first
+  if (close == '"') {
+    if (name[0] == '/')
+      snprintf(path, sizeof(path), "%s", name);
+    else if ((slash = strrchr(parent->name, '/')) != NULL)
+      snprintf(path, sizeof(path), "%.*s/%s",
+	       (int) (slash - parent->name), parent->name, name);
+    else
+      snprintf(path, sizeof(path), "%s", name);
+    f = try_include(path, pch);
+  }
+
+  // Then look in the system include directory
+  if (f == NULL && *pch == NULL) {
+    snprintf(path, sizeof(path), "%s/%s", INCDIR, name);
+    f = try_include(path, pch);
+  }
+
+  if (f == NULL && *pch == NULL)
+    fatal("%s: No such file or directory\n", name);
+  return (f);
+}
+
+// Output a line marker for the lexer
+static void add_marker(Textbuf * out, int line, char *name) {
+  char buf[TEXTLEN + 32];
+
+  snprintf(buf, sizeof(buf), "# %d \"%s\"\n", line, name);
+  addstr(out, buf);
+}
+
+// A state of #if processing in a file
+typedef struct {
+  bool active;			// Is this section of lines being used
+  bool taken;			// Has any section been used so far
+  bool seen_else;		// Have we seen the #else yet
+} Condstate;
+
+// Pre-process the given file, adding the text to the buffer
+static void process_file(Srcfile * f, Textbuf * out, int depth) {
+  Condstate cond[MAXCOND];
+  int ncond = 0;
+  bool skipping = false;
+  char *s, *d, *line, *name, *guard, *marker;
+  Srcfile *inc;
+  Pch *pch;
+  size_t len;
+  int lineno, i;
+
+  if (depth == MAXINCLUDE)
+    fatal("#include nested too deeply\n");
+
+  for (s = f->text, lineno = 1; *s; s += len + 1, lineno++) {
+    len = linelen(s);
+    State.Infilename = f->name;
+    State.Line = lineno;
+
+    // Not a directive: output the line if we are
+    // not skipping, expanding any macros in it.
+    // Like cpp, drop any trailing whitespace.
+    // If a macro call used the following lines,
+    // output a blank line for each of them
+    d = directive(s);
+    if (d == NULL) {
+      if (!skipping) {
+	State.Lineend = s + len;
+	State.Morelines = 0;
+	expand(s, len, out);
+	len = State.Lineend - s;
+	State.Lineend = NULL;
+	while (out->len > 0 && (out->text[out->len - 1] == ' ' ||
+				out->text[out->len - 1] == '\t'))
+	  out->len--;
+	for (; State.Morelines > 0; State.Morelines--, lineno++)
+	  addstr(out, "\n");
+      }
+      addstr(out, "\n");
+      continue;
+    }
+
+    // Get a NUL-terminated copy of the directive.
+    // Find its name and the text after the name
+    line = (char *) Malloc(len + 1);
+    memcpy(line, d, len - (d - s));
+    line[len - (d - s)] = '\0';
+    d = line;
+    name = is_identstart(*d) ? getident(d, &d) : NULL;
+
+    if (name == NULL) {
+      // A null directive, or a # line marker
+      if (*d != '\0' && !isdigit(*d) && !skipping)
+	fatal("Unknown pre-processor directive\n");
+    } else if (!strcmp(name, "if") || !strcmp(name, "ifdef") ||
+	       !strcmp(name, "ifndef")) {
+      if (ncond == MAXCOND)
+	fatal("#if nested too deeply\n");
+      cond[ncond].seen_else = false;
+      if (skipping)
+	cond[ncond].active = false;
+      else if (name[2] == '\0')
+	cond[ncond].active = eval_if(d);
+      else {
+	d = skipblank(d);
+	if (!is_identstart(*d))
+	  fatal("Expecting a macro name after #%s\n", name);
+	cond[ncond].active = (find_macro(getident(d, &d)) != NULL);
+	if (name[2] == 'n')
+	  cond[ncond].active = !cond[ncond].active;
+      }
+      // When skipping, no section of this #if is used
+      cond[ncond].taken = skipping || cond[ncond].active;
+      ncond++;
+    } else if (!strcmp(name, "elif")) {
+      if (ncond == 0 || cond[ncond - 1].seen_else)
+	fatal("#elif without #if\n");
+      if (cond[ncond - 1].taken)
+	cond[ncond - 1].active = false;
+      else {
+	cond[ncond - 1].active = eval_if(d);
+	cond[ncond - 1].taken = cond[ncond - 1].active;
+      }
+    } else if (!strcmp(name, "else")) {
+      if (ncond == 0 || cond[ncond - 1].seen_else)
+	fatal("#else without #if\n");
+      cond[ncond - 1].seen_else = true;
+      cond[ncond - 1].active = !cond[ncond - 1].taken;
+      cond[ncond - 1].taken = true;
+    } else if (!strcmp(name, "endif")) {
+      if (ncond == 0)
+	fatal("#endif without #if\n");
+      ncond--;
+    } else if (skipping) {
+      // Ignore any other directives when skipping
+    } else if (!strcmp(name, "define")) {
+      define_macro(d, depth == 0);
+    } else if (!strcmp(name, "undef")) {
+      d = skipblank(d);
+      if (!is_identstart(*d))
+	fatal("Expecting a macro name after #undef\n");
+      undef_macro(getident(d, &d));
+    } else if (!strcmp(name, "include")) {
+      inc = find_include(d, f, &pch);
+
+      // For a precompiled header, skip it if its include guard
+      // is defined. Otherwise get the lexer to load it. If we
+      // can't use it, fall back to reading the header itself
+      if (pch != NULL) {
+	guard = pch_guard(pch);
+	if (guard == NULL || find_macro(guard) == NULL) {
+	  if ((marker = pch_use(pch)) != NULL) {
+	    if (O_verbose)
+	      fprintf(stderr, "using %sc\n", pch_header(pch));
+	    addstr(out, marker);
+	    add_marker(out, lineno + 1, f->name);
+	    free(line);
+	    continue;
+	  }
+	  if ((inc = read_srcfile(pch_header(pch))) == NULL)
+	    fatal("%s: No such file or directory\n", pch_header(pch));
+	}
+      }
+
+      // Skip the file if its include guard is defined.
+      // Otherwise output it between line markers
+      if (inc != NULL &&
+	  (inc->guard == NULL || find_macro(inc->guard) == NULL)) {
+	add_marker(out, 1, inc->name);
+	process_file(inc, out, depth + 1);
+	add_marker(out, lineno + 1, f->name);
+	State.Infilename = f->name;
+	free(line);
+	continue;
+      }
+    } else if (!strcmp(name, "error")) {
+      fatal("#error %s\n", skipblank(d));
+    } else if (strcmp(name, "pragma")) {
+      fatal("Unknown pre-processor directive #%s\n", name);
+    }
+
+    // Work out if we are now skipping lines
+    skipping = false;
+    for (i = 0; i < ncond; i++)
+      if (cond[i].active == false)
+	skipping = true;
+
+    free(line);
+    addstr(out, "\n");
+  }
+
+  if (ncond != 0)
+    fatal("Unterminated #if at end of file\n");
+}
+
+// Start recording the macro names and files for a precompiled
+// header. Any earlier recording is discarded
+void pp_record(void) {
+  State.Recording = true;
+  State.Missed.count = 0;
+  State.Readfiles.count = 0;
+}
+
+// Return the list of names looked up as macros but not
+// found, other than the include guards of the files read
+char **pp_missed(int *count) {
+  Srcfile *f;
+  int i, j, n = 0;
+
+  for (i = 0; i < State.Missed.count; i++) {
+    for (j = 0; j < State.Readfiles.count; j++) {
+      for (f = State.Srchead; f != NULL; f = f->next)
+	if (f->name == State.Readfiles.name[j])
+	  break;
+      if (f != NULL && f->guard == State.Missed.name[i])
+	break;
+    }
+    if (j == State.Readfiles.count)
+      State.Missed.name[n++] = State.Missed.name[i];
+  }
+  State.Missed.count = n;
+  *count = n;
+  return (State.Missed.name);
+}
+
+// Return the list of files that we tried to read
+char **pp_files(int *count) {
+  *count = State.Readfiles.count;
+  return (State.Readfiles.name);
+}
+
+// Return the include guard of a file that we have read
+char *pp_guard(char *filename) {
+  Srcfile *f;
+
+  filename = intern(filename);
+  for (f = State.Srchead; f != NULL; f = f->next)
+    if (f->name == filename)
+      return (f->guard);
+  return (NULL);
+}
+
+// Return true if the interned name is a macro
+bool pp_defined(char *name) {
+  return (find_macro(name) != NULL);
+}
+
+// Define a macro from a precompiled header. The name
+// and parameters are interned, and the macro keeps the
+// list of parameters and a copy of the body
+void pp_define(char *name, int nparams, char **params, char *body) {
+  Macro *m;
+
+  m = (Macro *) Calloc(sizeof(Macro));
+  m->name = name;
+  m->nparams = nparams;
+  m->params = params;
+  m->body = (char *) Malloc(strlen(body) + 1);
+  strcpy(m->body, body);
+  undef_macro(name);
+  m->next = State.Macrohash[namehash(name) & (MACROHASHSIZE - 1)];
+  State.Macrohash[namehash(name) & (MACROHASHSIZE - 1)] = m;
+}
+
+// Call the function with the details of each macro
+void pp_walk_macros(void (*fn) (char *name, int nparams,
+				char **params, char *body)) {
+  Macro *m;
+  int i;
+
+  for (i = 0; i < MACROHASHSIZE; i++)
+    for (m = State.Macrohash[i]; m != NULL; m = m->next)
+      fn(m->name, m->nparams, m->params, m->body);
+}
+
+// Free all the macros
+static void free_macros(void) {
+  Macro *m, *next;
+  int i;
+
+  for (i = 0; i < MACROHASHSIZE; i++) {
+    for (m = State.Macrohash[i]; m != NULL; m = next) {
+      next = m->next;
+      free_macro(m);
+    }
+    State.Macrohash[i] = NULL;
+  }
+}
+
+// Free the macros, the files we have read
+// and the lists of names that we recorded
+void pp_free(void) {
+  Srcfile *f, *next;
+
+  free_macros();
+  for (f = State.Srchead; f != NULL; f = next) {
+    next = f->next;
+    free(f->text);
+    free(f);
+  }
+  State.Srchead = NULL;
+  free(State.Missed.name);
+  free(State.Readfiles.name);
+  memset(&State.Missed, 0, sizeof(Namelist));
+  memset(&State.Readfiles, 0, sizeof(Namelist));
+}
+
+// Pre-process the named file. Return the text
+// and set *len to its length
+char *preprocess(char *filename, size_t * len) {
+
+  bool recording = State.Recording;
+  int i;
+
+  // Start with only the predefined macros. They are
+  // always defined, so a precompiled header doesn't
+  // need to record that it looked them up
+  free_macros();
+  State.Recording = false;
+  for (i = 0; Predefined[i] != NULL; i++)
+    define_macro(Predefined[i], false);
+  State.Recording = recording;
+  return (preprocess_more(filename, len));
+}
+
+// Pre-process another file, keeping the macros
+// defined by the headers of the files before it.
+// Return the text and set *len to its length
+char *preprocess_more(char *filename, size_t * len) {
+  Textbuf out = { NULL, 0, 0 };
+  Macro **prev, *m;
+  Srcfile *f;
+  int i;
+
+  // Remove the macros defined by the earlier files themselves
+  for (i = 0; i < MACROHASHSIZE; i++)
+    for (prev = &State.Macrohash[i]; (m = *prev) != NULL;)
+      if (m->from_file) {
+	*prev = m->next;
+	free_macro(m);
+      } else
+	prev = &(m->next);
+
+  f = read_srcfile(filename);
+  if (f == NULL)
+    return (NULL);
+
+  add_marker(&out, 1, f->name);
+  process_file(f, &out, 0);
+  *len = out.len;
+  return (out.text);
+}
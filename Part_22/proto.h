@@ -5,9 +5,22 @@ ASTnode *mkastleaf(int op, Type * type, bool rvalue, Sym * sym,
 // void freeAST(ASTnode *n);
 void dumpAST(ASTnode * n, int level);
 ASTnode *optAST(ASTnode * n);
+void const_initval(Sym * sym, ASTnode * e);
+int count_AST(ASTnode * n);
+ASTnode **ast_chain(ASTnode * n, int *count);
+
+// cache.c
+void cache_init(char *dir);
+bool cache_enabled(void);
+char *cache_key(char *text, size_t len);
+bool cache_fetch(char *key, char suffix, char *outfile);
+void cache_count(bool hit);
+void cache_store(char *key, char suffix, char *file);
+void cache_stats(FILE * fh);
 
 // cgen.c
 int cgalloctemp(void);
+int cgnumtemps(void);
 void cglabel(int l);
 void cgjump(int l);
 int cgalign(Type * ty, int offset);
@@ -25,6 +38,9 @@ int cgsub(int t1, int t2, Type * type);
 int cgmul(int t1, int t2, Type * type);
 int cgdiv(int t1, int t2, Type * type);
 int cgmod(int t1, int t2, Type * type);
+int cgmulconst(int t, int64_t val, Type * type);
+int cgdivconst(int t, int64_t val, Type * type);
+int cgmodconst(int t, int64_t val, Type * type);
 int cgnegate(int t, Type * type);
 int cgcompare(int op, int t1, int t2, Type * type);
 void cgjump_if_false(int t1, int label);
@@ -64,11 +80,22 @@ int cg_free_aarray(Sym * sym);
 int cg_aaiterstart(int arytemp);
 int cg_aanext(int arytemp);
 int cg_funciterator(ASTnode * n, Breaklabel *this);
-void cg_stridxcheck(int idxtemp, int basetemp, int funcname);
+int cg_strlen(int basetemp);
+void cg_stridxcheck(int idxtemp, int basetemp, int funcname, int lentemp);
 int cg_stringiterator(ASTnode * n, Breaklabel *this);
 int cg_arrayiterator(ASTnode * n, Breaklabel *this);
 int cg_copystruct(int srctemp, int desttemp, int size);
 
+// emit.c
+void emit_flush(void);
+size_t emit_bytes(void);
+void emit_hold(void);
+char *emit_release(size_t *len);
+void emit_text(char *text, size_t len);
+void emitstr(char *s);
+void emitint(int64_t n);
+void emitf(const char *fmt, ...);
+
 // expr.c
 ASTnode *binop(ASTnode * l, ASTnode * r, int op);
 ASTnode *unarop(ASTnode * l, int op);
@@ -79,9 +106,14 @@ ASTnode *get_ary_offset(Sym *sym, ASTnode *e, ASTnode *previdx, int level);
 bool add_function(ASTnode * func, ASTnode * paramlist, int visibility);
 void declare_function(ASTnode * f, int visibility);
 void gen_func_statement_block(ASTnode * s);
+void note_funcref(Sym * func);
+void gen_held_funcs(void);
+void free_heldfuncs(void);
+int funcs_removed(void);
 
 // genast.c
 int genlabel(void);
+int gennumlabels(void);
 int genAST(ASTnode * n);
 int genalign(Type * ty, int offset);
 void gen_file_preamble(void);
@@ -91,6 +123,9 @@ int gen_assign(int ltemp, int rtemp, ASTnode *n);
 ASTnode *check_bel(Sym * sym, ASTnode * list, int offset, bool is_element, int basetemp);
 
 // lexer.c
+char *intern(char *s);
+uint64_t namehash(char *s);
+void lex_input(char *buf, size_t len);
 int scan(Token * t);
 char *get_tokenstr(int token);
 void dumptokens(void);
@@ -104,22 +139,77 @@ void ident(void);
 void comma(void);
 
 // main.c
+int alic_main(int argc, char *argv[]);
 int main(int argc, char *argv[]);
+void stop_pipeline(void);
+pid_t run_cmd(char *cmd, int infd, int outfd);
+bool cmd_succeeded(pid_t pid);
+bool alic_compile(char *filename);
+bool alic_compile_all(char **files, int nfiles, int nthreads);
+void state_init(void);
+void state_free(void);
+void state_reset(void);
 
 // misc.c
+void fatal_jump(jmp_buf * env);
 void fatal(const char *fmt, ...);
 void lfatal(int line, const char *fmt, ...);
 void cant_do(ASTnode * n, Type * t, char *msg);
 void *Malloc(size_t size);
 void *Calloc(size_t size);
+Arena *new_arena(char *name);
+void *Aalloc(Arena * a, size_t size);
+void release_arena(Arena * a);
+void free_arena(Arena * a);
+void arena_stats(Arena * a);
 uint64_t djb2hash(uint8_t * str);
+char *compiler_id(void);
+int time_phase(int phase);
+FILE *time_fh(void);
+void time_report(void);
 
 // parser.c
 void input_file(void);
 
+// pch.c
+void pch_write(char *header);
+Pch *pch_find(char *path);
+void pch_recheck(void);
+char *pch_guard(Pch * p);
+char *pch_header(Pch * p);
+char *pch_use(Pch * p);
+void pch_load(char *header);
+
+// preproc.c
+char *preprocess(char *filename, size_t * len);
+char *preprocess_more(char *filename, size_t * len);
+void pp_record(void);
+char **pp_missed(int *count);
+char **pp_files(int *count);
+char *pp_guard(char *filename);
+bool pp_defined(char *name);
+void pp_define(char *name, int nparams, char **params, char *body);
+void pp_walk_macros(void (*fn) (char *name, int nparams,
+				char **params, char *body));
+void pp_free(void);
+
+// ranges.c
+ASTnode *elide_checks(ASTnode * n);
+int bounds_removed(void);
+int ranges_removed(void);
+ASTnode *hoist_strlens(ASTnode * n);
+
+// server.c
+void run_server(char *name, long memlimit);
+bool run_client(char *name, int argc, char *argv[], int *status);
+
+// shards.c
+bool qbe_shards(char *qbefile, char *asmfile, int nshards);
+
 // strlits.c
 int add_strlit(char *name, bool is_const);
 void gen_strlits(void);
+void free_strlits(void);
 
 // stmts.c
 ASTnode *assignment_statement(ASTnode * v, ASTnode * e);
@@ -127,11 +217,16 @@ ASTnode *declaration_statement(ASTnode * sym, ASTnode * e);
 
 // syms.c
 void init_symtable(void);
+void free_symtable(void);
 Sym *add_sym_to(Sym ** head, char *name, int symtype, Type * type);
 Sym *add_symbol(char *name, int symtype, Type * type, int visibility);
 Sym *find_symbol(char *name);
+Sym *global_symbols(void);
 void new_scope(Sym * func);
 ASTnode *end_scope(void);
+void new_unit(char *filename);
+void add_member(Type * ty, Sym * memb, Sym * last);
+Sym *find_member(Type * ty, char *name);
 ASTnode *mkident(ASTnode * n);
 bool is_array(Sym * sym);
 int get_numelements(Sym *sym, int depth);
@@ -140,6 +235,7 @@ void dumpsyms(void);
 
 // types.c
 void init_typelist(void);
+Type *builtin_type(int i);
 Type *new_type(int kind, int size, bool is_unsigned, int ptr_depth, char *name, Type * base);
 Type *find_type(char *typename, int kind, bool is_unsigned, int ptr_depth);
 Type *pointer_to(Type * ty);
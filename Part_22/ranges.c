@@ -0,0 +1,718 @@
+// Value ranges for the alic compiler
+// (c) 2025 Warren Toomey, GPL3
+
+#include "alic.h"
+#include "proto.h"
+
+// With bounds checking on, each array index is wrapped
+// in an A_BOUNDS node. Once a function has been folded,
+// we work out the range of values that each index can
+// have, and we remove the check when the index must be
+// in range. We know the range of a literal, of a loop
+// variable inside its loop, and of sums, differences,
+// products, masks and remainders made from these.
+//
+// A loop variable is a local integer variable which a
+// for or foreach loop steps up or down by a literal,
+// and which the loop's condition compares against a
+// bound with a known range. The loop's body must not
+// change the variable, and its address must not be
+// taken anywhere in the function.
+//
+// We also use the ranges to lose the checks on values
+// which are stored in a ranged type, returned from a
+// ranged function, widened or cast. A local variable of
+// a ranged type holds a value in its range, or zero if
+// it was never given one. A value loaded from memory
+// fits its type. The check is removed when the value's
+// range is inside the range of its destination.
+
+// Return the smallest and largest
+// value that a variable's type holds
+static int64_t type_min(Type * ty) {
+  if (ty->is_unsigned)
+    return (0);
+  return ((ty->size == 8) ? INT64_MIN : -((int64_t) 1 << (ty->size * 8 - 1)));
+}
+
+static int64_t type_max(Type * ty) {
+  if (ty->size == 8)
+    return (INT64_MAX);
+  if (ty->is_unsigned)
+    return (((int64_t) 1 << (ty->size * 8)) - 1);
+  return (((int64_t) 1 << (ty->size * 8 - 1)) - 1);
+}
+
+// Set the range and return true if it fits in a
+// 32-bit word and in the type. This keeps us clear
+// of any overflow when we add or multiply, and of
+// a small value which the type would have trimmed
+static bool set_range(Range * r, int64_t lo, int64_t hi, Type * ty) {
+  if (lo < INT32_MIN || hi > INT32_MAX)
+    return (false);
+  if (lo < type_min(ty) || hi > type_max(ty))
+    return (false);
+  r->lo = lo;
+  r->hi = hi;
+  return (true);
+}
+
+// Return true if the function called
+// by n has any inout parameters
+static bool has_inout(ASTnode * n) {
+  Paramtype *pt;
+  Sym *param;
+
+  if (n->sym == NULL)
+    return (true);
+  if (n->sym->symtype != ST_FUNCTION) {
+    if (n->sym->type->kind != TY_FUNCPTR)
+      return (true);
+    for (pt = n->sym->type->paramtype; pt != NULL; pt = pt->next)
+      if (pt->is_inout)
+	return (true);
+    return (false);
+  }
+  for (param = n->sym->paramlist; param != NULL; param = param->next)
+    if (param->is_inout)
+      return (true);
+  return (false);
+}
+
+// Add the symbol to the Addrsyms list
+static void add_addrsym(Sym * sym) {
+  if (State.Numaddrsyms == State.Maxaddrsyms) {
+    State.Maxaddrsyms = (State.Maxaddrsyms == 0) ? 16 : State.Maxaddrsyms * 2;
+    State.Addrsyms = (Sym **) realloc(State.Addrsyms,
+				      State.Maxaddrsyms * sizeof(Sym *));
+    if (State.Addrsyms == NULL)
+      fatal("Malloc failure\n");
+  }
+  State.Addrsyms[State.Numaddrsyms++] = sym;
+}
+
+// Add any symbols whose address is taken in the tree n,
+// or which are passed to inout parameters, to the Addrsyms list
+static void find_addrsyms(ASTnode * n) {
+  ASTnode **chain, *arg;
+  int count, i;
+
+  if (n == NULL)
+    return;
+
+  chain = ast_chain(n, &count);
+  for (i = 0; i < count; i++) {
+    n = chain[i];
+    if (n->op == A_ADDR && n->sym != NULL)
+      add_addrsym(n->sym);
+    if (n->op == A_FUNCCALL && has_inout(n))
+      for (arg = n->right; arg != NULL; arg = arg->right)
+	if (arg->left != NULL && arg->left->op == A_IDENT)
+	  add_addrsym(arg->left->sym);
+    if (i == count - 1 || n->left != chain[i + 1])
+      find_addrsyms(n->left);
+    if (i == count - 1 || n->mid != chain[i + 1])
+      find_addrsyms(n->mid);
+    find_addrsyms(n->right);
+  }
+  free(chain);
+}
+
+// Return true if the function takes
+// the address of the variable
+static bool taken_addr(Sym * sym) {
+  int i;
+
+  for (i = 0; i < State.Numaddrsyms; i++)
+    if (State.Addrsyms[i] == sym)
+      return (true);
+  return (false);
+}
+
+// Return true if the variable is a local, and not
+// a parameter, whose address the function doesn't
+// take. Only the function can change its value
+static bool is_local(Sym * sym) {
+  Sym *param;
+
+  if (sym->visibility != SV_LOCAL || sym->symtype != ST_VARIABLE ||
+      sym == State.Thisfunction->exceptvar || taken_addr(sym))
+    return (false);
+  for (param = State.Thisfunction->paramlist; param != NULL;
+       param = param->next)
+    if (param == sym)
+      return (false);
+  return (true);
+}
+
+// If we know the range of the integer
+// expression n, set *r and return true
+static bool get_range(ASTnode * n, Range * r) {
+  Range lr, rr;
+  int i;
+
+  if (n == NULL || n->type == NULL || !is_integer(n->type))
+    return (false);
+
+  switch (n->op) {
+  case A_NUMLIT:
+    return (set_range(r, n->litval.intval, n->litval.intval, n->type));
+  case A_WIDEN:
+  case A_CAST:
+    if (!get_range(n->left, &lr))
+      return (false);
+    return (set_range(r, lr.lo, lr.hi, n->type));
+  case A_IDENT:
+    if (n->rvalue == false)
+      return (false);
+    for (i = State.Numloopvars - 1; i >= 0; i--)
+      if (State.Loopvars[i].sym == n->sym) {
+	*r = State.Loopvars[i].r;
+	return (true);
+      }
+
+    // Every value stored in a ranged local is checked
+    if (has_range(n->type) && is_local(n->sym))
+      return (set_range(r, (n->type->lower < 0) ? n->type->lower : 0,
+			(n->type->upper > 0) ? n->type->upper : 0, n->type));
+
+    // A value loaded from memory fits its type
+    if (n->sym->has_addr && !is_array(n->sym))
+      return (set_range(r, type_min(n->type), type_max(n->type), n->type));
+    return (false);
+  case A_DEREF:
+    if (n->rvalue == false)
+      return (false);
+    return (set_range(r, type_min(n->type), type_max(n->type), n->type));
+  case A_ADD:
+  case A_SUBTRACT:
+  case A_MULTIPLY:
+    if (!get_range(n->left, &lr) || !get_range(n->right, &rr))
+      return (false);
+    if (n->op == A_ADD)
+      return (set_range(r, lr.lo + rr.lo, lr.hi + rr.hi, n->type));
+    if (n->op == A_SUBTRACT)
+      return (set_range(r, lr.lo - rr.hi, lr.hi - rr.lo, n->type));
+
+    // Only multiply by a value which isn't negative
+    if (rr.lo != rr.hi || rr.lo < 0)
+      return (false);
+    return (set_range(r, lr.lo * rr.lo, lr.hi * rr.lo, n->type));
+  case A_AND:
+    // Masking with a value which isn't negative
+    if (!get_range(n->right, &rr) || rr.lo != rr.hi || rr.lo < 0)
+      return (false);
+
+    // and with a value which isn't negative
+    if (get_range(n->left, &lr) && lr.lo >= 0 && lr.hi < rr.lo)
+      return (set_range(r, 0, lr.hi, n->type));
+    return (set_range(r, 0, rr.lo, n->type));
+  case A_MOD:
+    // The remainder of a value which isn't negative
+    if (!get_range(n->right, &rr) || rr.lo != rr.hi || rr.lo <= 0)
+      return (false);
+    if (!n->type->is_unsigned && (!get_range(n->left, &lr) || lr.lo < 0))
+      return (false);
+    return (set_range(r, 0, rr.lo - 1, n->type));
+  }
+  return (false);
+}
+
+// Return true if the tree n can change the variable:
+// it's assigned to or is an argument to a function
+// which has inout parameters
+static bool changes_var(ASTnode * n, Sym * sym) {
+  ASTnode **chain, *arg;
+  int count, i;
+  bool changes = false;
+
+  if (n == NULL)
+    return (false);
+
+  chain = ast_chain(n, &count);
+  for (i = 0; i < count && changes == false; i++) {
+    n = chain[i];
+    if ((n->op == A_IDENT && n->sym == sym && n->rvalue == false) ||
+	(n->op == A_ADDR && n->sym == sym)) {
+      changes = true;
+      break;
+    }
+    if (n->op == A_FUNCCALL && has_inout(n))
+      for (arg = n->right; arg != NULL; arg = arg->right)
+	if (arg->left != NULL && arg->left->op == A_IDENT &&
+	    arg->left->sym == sym)
+	  changes = true;
+
+    if ((i == count - 1 || n->left != chain[i + 1]) &&
+	changes_var(n->left, sym))
+      changes = true;
+    if ((i == count - 1 || n->mid != chain[i + 1]) &&
+	changes_var(n->mid, sym))
+      changes = true;
+    if (changes_var(n->right, sym))
+      changes = true;
+  }
+  free(chain);
+  return (changes);
+}
+
+// If n is the variable, perhaps widened,
+// return true
+static bool is_var(ASTnode * n, Sym * sym) {
+  while (n != NULL && n->op == A_WIDEN)
+    n = n->left;
+  return (n != NULL && n->op == A_IDENT && n->sym == sym && n->rvalue);
+}
+
+// Use the loop's condition to find the largest value
+// of a variable which steps up, or the smallest value
+// of one which steps down. Return true if found
+static bool cond_bound(ASTnode * n, Sym * sym, bool up, int64_t * bound) {
+  Range r;
+
+  if (n == NULL)
+    return (false);
+  if (n->op == A_LOGAND)
+    return (cond_bound(n->left, sym, up, bound) ||
+	    cond_bound(n->right, sym, up, bound));
+  if (!is_var(n->left, sym) || !get_range(n->right, &r))
+    return (false);
+
+  switch (n->op) {
+  case A_LT:
+    *bound = r.hi - 1;
+    return (up);
+  case A_LE:
+    *bound = r.hi;
+    return (up);
+  case A_GT:
+    *bound = r.lo + 1;
+    return (!up);
+  case A_GE:
+    *bound = r.lo;
+    return (!up);
+  }
+  return (false);
+}
+
+// If the A_FOR node n has a loop variable,
+// set *lv to it and its range and return true
+static bool loop_var(ASTnode * n, Loopvar * lv) {
+  ASTnode *send, *step, *init;
+  Sym *sym;
+  Range r;
+  int64_t bound, start, delta;
+  bool up;
+
+  // Get the change statement which the
+  // parser glued after the statement block
+  if (n->mid == NULL || n->mid->op != A_GLUE ||
+      n->mid->is_short_assign == false)
+    return (false);
+  send = n->mid->right;
+
+  // It must be var = var +/- literal
+  if (send == NULL || send->op != A_ASSIGN || send->right == NULL ||
+      send->right->op != A_IDENT)
+    return (false);
+  sym = send->right->sym;
+  step = send->left;
+  if (sym == NULL || sym->visibility != SV_LOCAL || sym->is_inout ||
+      sym->dimensions != 0 || !is_integer(sym->type))
+    return (false);
+  if (step == NULL || (step->op != A_ADD && step->op != A_SUBTRACT) ||
+      !is_var(step->left, sym) || step->right->op != A_NUMLIT)
+    return (false);
+  delta = step->right->litval.intval;
+  if (delta <= 0 || delta > INT32_MAX)
+    return (false);
+  up = (step->op == A_ADD);
+
+  // The condition limits the variable at one end
+  if (!cond_bound(n->left, sym, up, &bound))
+    return (false);
+
+  // The last of the initial statements
+  // may give the value at the other end
+  init = n->right;
+  while (init != NULL && init->op == A_GLUE && init->right != NULL)
+    init = init->right;
+  if (init != NULL && init->op == A_ASSIGN && init->right != NULL &&
+      init->right->op == A_IDENT && init->right->sym == sym &&
+      get_range(init->left, &r))
+    start = (up) ? r.lo : r.hi;
+  else if (up && sym->type->is_unsigned)
+    start = 0;
+  else
+    return (false);
+
+  // The step must not wrap the variable around, unless
+  // it's unsigned, steps up and we already use zero
+  if (up) {
+    if (bound > type_max(sym->type) - delta) {
+      if (!sym->type->is_unsigned)
+	return (false);
+      start = 0;
+    }
+    if (!set_range(&lv->r, start, bound, sym->type))
+      return (false);
+  } else {
+    if (bound < type_min(sym->type) + delta)
+      return (false);
+    if (!set_range(&lv->r, bound, start, sym->type))
+      return (false);
+  }
+
+  // Nothing else can change the variable
+  if (taken_addr(sym) || changes_var(n->mid->left, sym) || changes_var(n->left, sym))
+    return (false);
+
+  lv->sym = sym;
+  return (true);
+}
+
+// Return true if the value n fits in the range lo ... hi
+static bool fits(ASTnode * n, int64_t lo, int64_t hi) {
+  Range r;
+
+  return (get_range(n, &r) && r.lo >= lo && r.hi <= hi);
+}
+
+// Mark n if it would check that its value fits
+// into a range or a type, and the value must fit
+static void elide_range(ASTnode * n) {
+  Type *ty = NULL, *ety;
+  ASTnode *val = n->left;
+
+  switch (n->op) {
+  case A_LOCAL:
+    if (!is_array(n->sym) && !is_struct(n->sym->type))
+      ty = n->type;
+    break;
+  case A_ASSIGN:
+    // A named argument has no destination
+    if (n->right != NULL &&
+	(n->right->op == A_IDENT || n->right->op == A_DEREF))
+      ty = n->right->type;
+    break;
+  case A_RETURN:
+    ty = State.Thisfunction->type;
+    break;
+  case A_WIDEN:
+  case A_CAST:
+    // Only an integer conversion to a type
+    // which doesn't hold every value of the
+    // value's type has a check
+    ty = n->type;
+    ety = val->type;
+    if (!is_integer(ty) || !is_integer(ety) ||
+	(type_min(ety) >= type_min(ty) && type_max(ety) <= type_max(ty)))
+      return;
+    if (fits(val, type_min(ty), type_max(ty))) {
+      n->in_range = true;
+      State.Rangesremoved++;
+    }
+    return;
+  }
+
+  if (ty != NULL && has_range(ty) && fits(val, ty->lower, ty->upper)) {
+    n->in_range = true;
+    State.Rangesremoved++;
+  }
+}
+
+// Walk the tree n, removing the bounds
+// and range checks that we don't need
+static ASTnode *elide(ASTnode * n) {
+  ASTnode **chain;
+  Loopvar lv;
+  Range r;
+  int count, i;
+  bool pushed = false;
+
+  if (n == NULL)
+    return (NULL);
+
+  // Walk each statement in a chain of statements
+  // or declarations. The chain itself doesn't change
+  if (n->op == A_GLUE && n->is_short_assign == false) {
+    chain = ast_chain(n, &count);
+    chain[count - 1]->left = elide(chain[count - 1]->left);
+    for (i = count - 1; i >= 0; i--)
+      chain[i]->right = elide(chain[i]->right);
+    free(chain);
+    return (n);
+  }
+  if (n->op == A_LOCAL) {
+    chain = ast_chain(n, &count);
+    chain[count - 1]->mid = elide(chain[count - 1]->mid);
+    for (i = count - 1; i >= 0; i--) {
+      chain[i]->left = elide(chain[i]->left);
+      chain[i]->right = elide(chain[i]->right);
+      elide_range(chain[i]);
+    }
+    free(chain);
+    return (n);
+  }
+
+  // The loop variable's range only
+  // holds in the loop's body
+  n->left = elide(n->left);
+  n->right = elide(n->right);
+  if (n->op == A_FOR && State.Numloopvars < MAXLOOPDEPTH && loop_var(n, &lv)) {
+    State.Loopvars[State.Numloopvars++] = lv;
+    pushed = true;
+  }
+  n->mid = elide(n->mid);
+  if (pushed)
+    State.Numloopvars--;
+  elide_range(n);
+
+  // Lose the check on an index which is in range
+  if (n->op == A_BOUNDS && n->right->op == A_NUMLIT &&
+      get_range(n->left, &r) && r.lo >= 0 &&
+      r.hi < n->right->litval.intval) {
+    State.Boundsremoved++;
+    return (n->left);
+  }
+  return (n);
+}
+
+// Remove the bounds checks in a function's AST tree
+// on indices which are in range, and mark the values
+// which need no range check
+ASTnode *elide_checks(ASTnode * n) {
+  int oldphase;
+
+  oldphase = time_phase(PH_OPTIMISE);
+  State.Numaddrsyms = 0;
+  State.Numloopvars = 0;
+  find_addrsyms(n);
+  n = elide(n);
+  time_phase(oldphase);
+  return (n);
+}
+
+// Return the number of bounds checks
+// removed since we were last called
+int bounds_removed(void) {
+  int count = State.Boundsremoved;
+
+  State.Boundsremoved = 0;
+  return (count);
+}
+
+// Return the number of range checks
+// removed since we were last called
+int ranges_removed(void) {
+  int count = State.Rangesremoved;
+
+  State.Rangesremoved = 0;
+  return (count);
+}
+
+// A loop which indexes a string variable calls strlen()
+// for each index check. When the loop can't change the
+// variable, we get the length once before the loop with
+// an A_STRLEN node, and each check in the loop uses it.
+// A string can point at memory which a store or a called
+// function changes, e.g. a buffer that fgets() refills.
+// So we only do this in loops which store nothing through
+// pointers or into arrays, structs or associative arrays,
+// and which only call C library functions that don't
+// change memory, such as printf() and strlen(). The
+// A_STRLEN node and the A_ADDOFFSET nodes share a slot
+// number in their count fields.
+
+// C library functions which change no memory that a
+// string could point at. The %n of printf() is ignored
+static char *Purefuncs[] = {
+  "printf", "fprintf", "puts", "fputs", "putchar", "fputc",
+  "strlen", "strcmp", "strncmp", "strchr", "strrchr", "strstr",
+  "memcmp", "atoi", "atol", "abs", "labs", "isalpha", "isdigit",
+  "isalnum", "isspace", "isupper", "islower", "isxdigit",
+  "toupper", "tolower", NULL
+};
+
+// Return true if the node calls one of the C library
+// functions above. A function with a body in this
+// file is not the C library one
+static bool pure_call(ASTnode * n) {
+  int i;
+
+  if (n->sym == NULL || n->sym->symtype != ST_FUNCTION ||
+      n->sym->has_block)
+    return (false);
+  for (i = 0; Purefuncs[i] != NULL; i++)
+    if (!strcmp(n->sym->name, Purefuncs[i]))
+      return (true);
+  return (false);
+}
+
+// Return true if the node can change memory other
+// than a scalar variable: it calls a function, frees
+// memory or stores into memory
+static bool stores_mem(ASTnode * n) {
+  switch (n->op) {
+  case A_FUNCCALL:
+    return (!pure_call(n));
+  case A_FUNCITER:
+  case A_UNDEF:
+  case A_AAFREE:
+    return (true);
+  case A_LOCAL:
+    return (is_array(n->sym) || is_struct(n->sym->type));
+  case A_ASSIGN:
+    return (n->right == NULL || n->right->op != A_IDENT ||
+	    is_array(n->right->sym) || is_struct(n->right->type));
+  }
+  return (false);
+}
+
+// Return true if the tree n can change memory
+// which a string variable could point at
+static bool changes_mem(ASTnode * n) {
+  ASTnode **chain;
+  int count, i;
+  bool found = false;
+
+  if (n == NULL)
+    return (false);
+
+  chain = ast_chain(n, &count);
+  for (i = 0; i < count && found == false; i++) {
+    n = chain[i];
+    if (stores_mem(n) ||
+	((i == count - 1 || n->left != chain[i + 1]) && changes_mem(n->left)) ||
+	((i == count - 1 || n->mid != chain[i + 1]) && changes_mem(n->mid)) ||
+	changes_mem(n->right))
+      found = true;
+  }
+  free(chain);
+  return (found);
+}
+
+// Give the slot number to each string index
+// check in the tree n which uses the variable
+static void set_slot(ASTnode * n, Sym * sym, int slot) {
+  ASTnode **chain;
+  int count, i;
+
+  if (n == NULL)
+    return;
+
+  chain = ast_chain(n, &count);
+  for (i = 0; i < count; i++) {
+    n = chain[i];
+    if (n->op == A_ADDOFFSET && n->type == ty_string && n->count == 0 &&
+	n->right->op == A_IDENT && n->right->sym == sym)
+      n->count = slot;
+    if (i == count - 1 || n->left != chain[i + 1])
+      set_slot(n->left, sym, slot);
+    if (i == count - 1 || n->mid != chain[i + 1])
+      set_slot(n->mid, sym, slot);
+    set_slot(n->right, sym, slot);
+  }
+  free(chain);
+}
+
+// Walk the tree n for string index checks without a slot.
+// If the loop can't change the string variable, give it
+// a slot and add an A_STRLEN node for it to the prelude.
+// The loop mustn't change any memory that it could use
+static void find_strings(ASTnode * n, ASTnode * loop, ASTnode ** prelude) {
+  ASTnode **chain, *len;
+  Sym *sym;
+  int count, i;
+
+  if (n == NULL)
+    return;
+
+  chain = ast_chain(n, &count);
+  for (i = 0; i < count; i++) {
+    n = chain[i];
+    if (n->op == A_ADDOFFSET && n->type == ty_string && n->count == 0 &&
+	n->right->op == A_IDENT && n->right->sym != NULL) {
+      sym = n->right->sym;
+
+      if (!changes_var(loop, sym) && !taken_addr(sym)) {
+	len = (ASTnode *) Aalloc(State.Thisarena, sizeof(ASTnode));
+	memcpy(len, n->right, sizeof(ASTnode));
+	len = mkastnode(A_STRLEN, len, NULL, NULL);
+	len->type = ty_int64;
+	len->count = ++State.Numslots;
+	set_slot(loop, sym, len->count);
+	*prelude = (*prelude == NULL) ? len :
+	  mkastnode(A_GLUE, *prelude, NULL, len);
+      }
+    }
+    if (i == count - 1 || n->left != chain[i + 1])
+      find_strings(n->left, loop, prelude);
+    if (i == count - 1 || n->mid != chain[i + 1])
+      find_strings(n->mid, loop, prelude);
+    find_strings(n->right, loop, prelude);
+  }
+  free(chain);
+}
+
+// Walk the tree n, putting the lengths of the strings
+// which loops index before the loops
+static ASTnode *hoist(ASTnode * n) {
+  ASTnode **chain, *prelude = NULL;
+  int count, i;
+
+  if (n == NULL)
+    return (NULL);
+
+  if (n->op == A_GLUE && n->is_short_assign == false) {
+    chain = ast_chain(n, &count);
+    chain[count - 1]->left = hoist(chain[count - 1]->left);
+    for (i = count - 1; i >= 0; i--)
+      chain[i]->right = hoist(chain[i]->right);
+    free(chain);
+    return (n);
+  }
+  if (n->op == A_LOCAL) {
+    chain = ast_chain(n, &count);
+    chain[count - 1]->mid = hoist(chain[count - 1]->mid);
+    for (i = count - 1; i >= 0; i--) {
+      chain[i]->left = hoist(chain[i]->left);
+      chain[i]->right = hoist(chain[i]->right);
+    }
+    free(chain);
+    return (n);
+  }
+
+  // An outer loop takes the strings first,
+  // so that we get each length as few times
+  // as we can
+  switch (n->op) {
+  case A_WHILE:
+  case A_FOR:
+  case A_STRINGITER:
+  case A_ARRAYITER:
+    if (!changes_mem(n))
+      find_strings(n, n, &prelude);
+  }
+
+  n->left = hoist(n->left);
+  n->mid = hoist(n->mid);
+  n->right = hoist(n->right);
+  if (prelude != NULL)
+    n = mkastnode(A_GLUE, prelude, NULL, n);
+  return (n);
+}
+
+// Get the lengths of the strings which the
+// loops in a function's AST tree index once,
+// before each loop
+ASTnode *hoist_strlens(ASTnode * n) {
+  int oldphase = time_phase(PH_OPTIMISE);
+
+  State.Numaddrsyms = 0;
+  State.Numslots = 0;
+  find_addrsyms(n);
+  n = hoist(n);
+  time_phase(oldphase);
+  return (n);
+}
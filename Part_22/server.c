@@ -0,0 +1,385 @@
+// Compiler server for the alic compiler
+// (c) 2025 Warren Toomey, GPL3
+
+#define _GNU_SOURCE		// For ppoll()
+
+#include <errno.h>
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "alic.h"
+#include "proto.h"
+
+// "alic --server socket" listens on a Unix socket. When
+// ALIC_SERVER is set to the socket's name, alic passes its
+// command line, working directory and standard input,
+// output and error to the server instead of compiling.
+//
+// The server reads and checks the precompiled headers in
+// the include directory once. For each request it forks a
+// child, which starts with the bytes of those headers
+// already in memory and does the compile with the normal
+// command line. So each compile has its own state, and its
+// memory is limited by RLIMIT_AS. When the child exits, the
+// server sends its exit status back to the client.
+//
+// The child runs as the server's user, so the socket is
+// made with mode 0600 and the server refuses a client
+// which is run by a different user.
+//
+// The headers' types and symbols are not put into the
+// tables before the fork. A compile must only see the
+// declarations of the headers that it includes, and the
+// lexer loads each one when it reaches its #include
+
+#define DEFMEMLIMIT 1024	// Default memory limit in megabytes
+#define MAXREQUEST (1024 * 1024)	// Largest request in bytes
+
+// The header of a request. The fds are passed
+// with it, and then come len bytes holding the
+// working directory and the arguments, each
+// one NUL-terminated
+typedef struct Request Request;
+struct Request {
+  int argc;
+  size_t len;
+};
+
+// Make the socket's address from its name
+static void sock_addr(char *name, struct sockaddr_un *addr) {
+  if (strlen(name) >= sizeof(addr->sun_path)) {
+    fprintf(stderr, "Socket name %s is too long\n", name);
+    exit(1);
+  }
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  strcpy(addr->sun_path, name);
+}
+
+// Read exactly len bytes, trying again if a
+// signal interrupts us. Return false on failure
+static bool read_all(int fd, void *buf, size_t len) {
+  ssize_t n;
+
+  for (; len > 0; len -= n, buf = (char *) buf + n)
+    if ((n = read(fd, buf, len)) <= 0) {
+      if (n == -1 && errno == EINTR) {
+	n = 0;
+	continue;
+      }
+      return (false);
+    }
+  return (true);
+}
+
+// Write exactly len bytes, trying again if a
+// signal interrupts us. Return false on failure
+static bool write_all(int fd, void *buf, size_t len) {
+  ssize_t n;
+
+  for (; len > 0; len -= n, buf = (char *) buf + n)
+    if ((n = write(fd, buf, len)) <= 0) {
+      if (n == -1 && errno == EINTR) {
+	n = 0;
+	continue;
+      }
+      return (false);
+    }
+  return (true);
+}
+
+// Return true if the client on the
+// connection is run by our user
+static bool same_user(int conn) {
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+
+  if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1)
+    return (false);
+  return (cred.uid == getuid());
+}
+
+// Find the precompiled headers in the directory and its
+// subdirectories, and read in the ones which are usable
+static void load_headers(char *dir) {
+  char path[TEXTLEN];
+  struct dirent *d;
+  size_t len;
+  DIR *dh;
+
+  if ((dh = opendir(dir)) == NULL)
+    return;
+  while ((d = readdir(dh)) != NULL) {
+    if (d->d_name[0] == '.')
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, d->d_name);
+    len = strlen(d->d_name);
+    if (len > 3 && !strcmp(d->d_name + len - 3, ".ah"))
+      pch_find(path);
+    else if (d->d_type == DT_DIR)
+      load_headers(path);
+  }
+  closedir(dh);
+}
+
+// A compile that is running, and the
+// connection to send its exit status to
+typedef struct Running Running;
+struct Running {
+  pid_t pid;
+  int conn;
+};
+
+static Running *Runlist = NULL;
+static int Numrunning = 0;
+static int Maxrunning = 0;
+
+// Get a request on the connection and do the compile in
+// this process: use the client's fds and directory, limit
+// our memory and run the normal compiler on the arguments.
+// This doesn't return
+static void do_request(int conn, long memlimit) {
+  char cbuf[CMSG_SPACE(3 * sizeof(int))];
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  struct rlimit rl;
+  Request req;
+  int i, fds[3];
+  char *data, **argv;
+
+  // Get the request header and the fds
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &req;
+  iov.iov_len = sizeof(req);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof(cbuf);
+  if (recvmsg(conn, &msg, MSG_WAITALL) != sizeof(req))
+    exit(1);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+    exit(1);
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+  // Get the directory and arguments
+  if (req.argc < 1 || req.len == 0 || req.len > MAXREQUEST)
+    exit(1);
+  data = (char *) Malloc(req.len + 1);
+  if (!read_all(conn, data, req.len))
+    exit(1);
+  data[req.len] = '\0';
+  close(conn);
+
+  for (i = 0; i < 3; i++) {
+    dup2(fds[i], i);
+    close(fds[i]);
+  }
+  if (chdir(data) == -1) {
+    fprintf(stderr, "Unable to change to %s: %s\n", data, strerror(errno));
+    exit(1);
+  }
+
+  rl.rlim_cur = rl.rlim_max = (rlim_t) memlimit *1024 * 1024;
+  setrlimit(RLIMIT_AS, &rl);
+
+  argv = (char **) Malloc((req.argc + 1) * sizeof(char *));
+  for (i = 0; i < req.argc; i++) {
+    data += strlen(data) + 1;
+    argv[i] = data;
+  }
+  argv[req.argc] = NULL;
+  exit(alic_main(req.argc, argv));
+}
+
+// Send the exit status of each finished
+// compile to its client
+static void reap_compiles(void) {
+  int i, status;
+  pid_t pid;
+
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    for (i = 0; i < Numrunning; i++)
+      if (Runlist[i].pid == pid)
+	break;
+    if (i == Numrunning)
+      continue;
+
+    status = (WIFEXITED(status)) ? WEXITSTATUS(status) : 1;
+    write_all(Runlist[i].conn, &status, sizeof(status));
+    close(Runlist[i].conn);
+    Runlist[i] = Runlist[--Numrunning];
+  }
+}
+
+// We only need SIGCHLD to interrupt ppoll()
+static void sigchld(int sig) {
+}
+
+// Run the compiler server on the named socket, limiting
+// each compile to memlimit megabytes, or the default
+// if it is zero. This doesn't return
+void run_server(char *name, long memlimit) {
+  struct sockaddr_un addr;
+  struct sigaction sa;
+  struct pollfd pfd;
+  sigset_t chld, old;
+  mode_t mask;
+  int sock, conn, err;
+  pid_t pid;
+
+  if (memlimit <= 0)
+    memlimit = DEFMEMLIMIT;
+
+  // Get the state that every compile can share
+  lex_input("", 0);
+  load_headers(INCDIR);
+
+  // Only our user can connect to the socket
+  sock_addr(name, &addr);
+  unlink(name);
+  if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+    fprintf(stderr, "Unable to make a socket: %s\n", strerror(errno));
+    exit(1);
+  }
+  mask = umask(0177);
+  err = bind(sock, (struct sockaddr *) &addr, sizeof(addr));
+  umask(mask);
+  if (err == -1 || chmod(name, 0600) == -1 || listen(sock, 64) == -1) {
+    fprintf(stderr, "Unable to listen on %s: %s\n", name, strerror(errno));
+    exit(1);
+  }
+
+  // SIGCHLD is only let in while we wait in ppoll(), so
+  // that we can't miss a compile finishing. A client that
+  // has gone away mustn't stop us when we send it a status
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sigchld;
+  sigaction(SIGCHLD, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  sigemptyset(&chld);
+  sigaddset(&chld, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &chld, &old);
+
+  pfd.fd = sock;
+  pfd.events = POLLIN;
+  while (1) {
+    reap_compiles();
+    if (ppoll(&pfd, 1, NULL, &old) == -1) {
+      if (errno == EINTR)
+	continue;
+      fprintf(stderr, "Unable to wait for a client: %s\n", strerror(errno));
+      exit(1);
+    }
+    if ((conn = accept(sock, NULL, NULL)) == -1)
+      continue;
+    if (!same_user(conn)) {
+      close(conn);
+      continue;
+    }
+
+    // Forget any headers which have changed
+    pch_recheck();
+
+    if ((pid = fork()) == -1) {
+      fprintf(stderr, "Unable to fork: %s\n", strerror(errno));
+      close(conn);
+      continue;
+    }
+
+    // The child does the compile with the usual signals
+    if (pid == 0) {
+      close(sock);
+      signal(SIGCHLD, SIG_DFL);
+      signal(SIGPIPE, SIG_DFL);
+      sigprocmask(SIG_SETMASK, &old, NULL);
+      do_request(conn, memlimit);
+    }
+
+    if (Numrunning == Maxrunning) {
+      Maxrunning = (Maxrunning == 0) ? 16 : Maxrunning * 2;
+      Runlist = (Running *) realloc(Runlist, Maxrunning * sizeof(Running));
+      if (Runlist == NULL)
+	fatal("Malloc failure\n");
+    }
+    Runlist[Numrunning].pid = pid;
+    Runlist[Numrunning].conn = conn;
+    Numrunning++;
+  }
+}
+
+// Pass the command line to the server on the named socket
+// and set *status to the exit status of the compile.
+// Return false if we can't reach the server
+bool run_client(char *name, int argc, char *argv[], int *status) {
+  char cbuf[CMSG_SPACE(3 * sizeof(int))];
+  char cwd[PATH_MAX];
+  int fds[3] = { 0, 1, 2 };
+  struct sockaddr_un addr;
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  Request req;
+  char *data, *s;
+  int i, sock;
+
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    return (false);
+  sock_addr(name, &addr);
+  if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    return (false);
+  if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+    close(sock);
+    return (false);
+  }
+
+  // Build the directory and arguments
+  req.argc = argc;
+  req.len = strlen(cwd) + 1;
+  for (i = 0; i < argc; i++)
+    req.len += strlen(argv[i]) + 1;
+  data = s = (char *) Malloc(req.len);
+  strcpy(s, cwd);
+  s += strlen(s) + 1;
+  for (i = 0; i < argc; i++) {
+    strcpy(s, argv[i]);
+    s += strlen(s) + 1;
+  }
+
+  // Send the header with our fds, then the rest
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &req;
+  iov.iov_len = sizeof(req);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof(cbuf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  if (sendmsg(sock, &msg, 0) != sizeof(req) ||
+      !write_all(sock, data, req.len)) {
+    close(sock);
+    free(data);
+    return (false);
+  }
+  free(data);
+
+  // Wait for the exit status
+  if (!read_all(sock, status, sizeof(*status))) {
+    fprintf(stderr, "Lost the connection to the alic server\n");
+    *status = 1;
+  }
+  close(sock);
+  return (true);
+}
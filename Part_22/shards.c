@@ -0,0 +1,255 @@
+// Parallel QBE translation for the alic compiler
+// (c) 2025 Warren Toomey, GPL3
+
+#include <ctype.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "alic.h"
+#include "proto.h"
+
+// The functions in a QBE file are independent of each
+// other, so a large file can be split into shards which
+// separate qbe processes translate at the same time.
+// Each shard has some of the functions, in their order
+// in the file, and every type definition. The first
+// shard also has all the data. The assembly outputs are
+// then joined in shard order. qbe numbers its local
+// labels (.Lbb, .Lfp) from zero in each run, so those
+// in shard N are renamed .LN_bb, .LN_fp etc.
+
+// A function in the QBE file: its
+// start and its length in bytes
+typedef struct Qfunc Qfunc;
+struct Qfunc {
+  char *start;
+  size_t len;
+};
+
+// Read in the whole of the named file, NUL-terminated,
+// and set *len to its size. Return NULL if we can't
+static char *read_text(char *name, size_t * len) {
+  struct stat sb;
+  char *text;
+  FILE *fh;
+
+  if ((fh = fopen(name, "r")) == NULL)
+    return (NULL);
+  if (fstat(fileno(fh), &sb) == -1) {
+    fclose(fh);
+    return (NULL);
+  }
+  text = (char *) Malloc(sb.st_size + 1);
+  if (fread(text, 1, sb.st_size, fh) != sb.st_size) {
+    free(text);
+    fclose(fh);
+    return (NULL);
+  }
+  fclose(fh);
+  text[sb.st_size] = '\0';
+  *len = sb.st_size;
+  return (text);
+}
+
+// Return the length of the line at s, including its newline
+static size_t line_len(char *s) {
+  char *nl = strchr(s, '\n');
+
+  return ((nl == NULL) ? strlen(s) : nl - s + 1);
+}
+
+// Return true if the line at s starts a function
+static bool is_function(char *s) {
+  if (!strncmp(s, "export ", 7))
+    s += 7;
+  while (*s == ' ')
+    s++;
+  return (!strncmp(s, "function ", 9));
+}
+
+// Make the name of a shard's file
+static char *shard_name(char *filename, int shard) {
+  char name[TEXTLEN];
+
+  snprintf(name, sizeof(name), "%s.%d", filename, shard);
+  return (strdup(name));
+}
+
+// Copy the assembly output of a shard to outfh,
+// renaming its local labels if it isn't shard 0.
+// Text inside double quotes is copied unchanged
+static void copy_shard(FILE * outfh, char *text, int shard) {
+  bool inquote = false;
+  char *s;
+
+  for (s = text; *s != '\0'; s++) {
+    if (*s == '"' && (s == text || s[-1] != '\\'))
+      inquote = !inquote;
+    if (*s == '\n')
+      inquote = false;
+
+    if (shard > 0 && !inquote && s[0] == '.' && s[1] == 'L' &&
+	(s == text || !(isalnum((uint8_t) s[-1]) || s[-1] == '_'
+			|| s[-1] == '.'))) {
+      fprintf(outfh, ".L%d_", shard);
+      s++;
+      continue;
+    }
+    fputc(*s, outfh);
+  }
+}
+
+// Translate the QBE file qbefile to the assembly file
+// asmfile using up to nshards qbe processes at once.
+// Return false if the file has too few functions to
+// split, so that the caller can run qbe on it as usual.
+// Exit if any of the qbe processes fails.
+bool qbe_shards(char *qbefile, char *asmfile, int nshards) {
+  char *text, *s, *shared, *shdend;
+  char **qnames, **snames;
+  char cmd[TEXTLEN];
+  Qfunc *funcs = NULL;
+  int nfuncs = 0, maxfuncs = 0;
+  int i, f, shard, first;
+  size_t len, size, total = 0, done;
+  pid_t *pids;
+  FILE *fh;
+  bool ok = true;
+
+  if ((text = read_text(qbefile, &len)) == NULL) {
+    fprintf(stderr, "Unable to read %s: %s\n", qbefile, strerror(errno));
+    exit(1);
+  }
+
+  // Find the functions. Each one ends with
+  // a line that is just a right brace. The
+  // other lines are the shared types and data
+  shared = (char *) Malloc(len + 1);
+  shdend = shared;
+  s = text;
+  while (*s != '\0') {
+    if (!is_function(s)) {
+      size = line_len(s);
+      memcpy(shdend, s, size);
+      shdend += size;
+      s += size;
+      continue;
+    }
+
+    if (nfuncs == maxfuncs) {
+      maxfuncs = (maxfuncs == 0) ? 256 : maxfuncs * 2;
+      funcs = (Qfunc *) realloc(funcs, maxfuncs * sizeof(Qfunc));
+      if (funcs == NULL)
+	fatal("Malloc failure\n");
+    }
+    funcs[nfuncs].start = s;
+    while (*s != '\0' && strncmp(s, "}\n", 2) && strcmp(s, "}"))
+      s += line_len(s);
+    s += line_len(s);
+    funcs[nfuncs].len = s - funcs[nfuncs].start;
+    total += funcs[nfuncs].len;
+    nfuncs++;
+  }
+  *shdend = '\0';
+
+  if (nshards > nfuncs)
+    nshards = nfuncs;
+  if (nshards < 2) {
+    free(funcs);
+    free(shared);
+    free(text);
+    return (false);
+  }
+
+  // Write out the shards, giving each one about
+  // the same number of bytes of functions. Only
+  // the first shard gets the data, but they all
+  // get the type definitions
+  qnames = (char **) Malloc(nshards * sizeof(char *));
+  snames = (char **) Malloc(nshards * sizeof(char *));
+  pids = (pid_t *) Malloc(nshards * sizeof(pid_t));
+  f = 0;
+  done = 0;
+  for (shard = 0; shard < nshards; shard++) {
+    qnames[shard] = shard_name(qbefile, shard);
+    snames[shard] = shard_name(asmfile, shard);
+    if ((fh = fopen(qnames[shard], "w")) == NULL) {
+      fprintf(stderr, "Unable to create %s: %s\n", qnames[shard],
+	      strerror(errno));
+      exit(1);
+    }
+
+    if (shard == 0)
+      fputs(shared, fh);
+    else
+      for (s = shared; *s != '\0'; s += line_len(s))
+	if (!strncmp(s, "type ", 5))
+	  fwrite(s, 1, line_len(s), fh);
+
+    // Take at least one function, and leave
+    // at least one for each of the later shards
+    first = f;
+    while (f < nfuncs - (nshards - shard - 1) &&
+	   (f == first || shard == nshards - 1 ||
+	    done + funcs[f].len <= total * (shard + 1) / nshards)) {
+      fwrite(funcs[f].start, 1, funcs[f].len, fh);
+      done += funcs[f].len;
+      f++;
+    }
+
+    if (fclose(fh) != 0) {
+      fprintf(stderr, "Unable to write %s\n", qnames[shard]);
+      exit(1);
+    }
+  }
+
+  // Run qbe on all the shards at once
+  time_phase(PH_QBE);
+  for (shard = 0; shard < nshards; shard++) {
+    snprintf(cmd, TEXTLEN, "%s %s %s", QBECMD, snames[shard], qnames[shard]);
+    if (O_verbose)
+      fprintf(stderr, "%s\n", cmd);
+    pids[shard] = run_cmd(cmd, 0, -1);
+  }
+  for (shard = 0; shard < nshards; shard++)
+    if (!cmd_succeeded(pids[shard]))
+      ok = false;
+  time_phase(PH_OTHER);
+
+  // Join the assembly outputs in order
+  if (ok) {
+    if ((fh = fopen(asmfile, "w")) == NULL) {
+      fprintf(stderr, "Unable to create %s: %s\n", asmfile, strerror(errno));
+      exit(1);
+    }
+    for (shard = 0; shard < nshards; shard++) {
+      free(text);
+      if ((text = read_text(snames[shard], &len)) == NULL) {
+	ok = false;
+	break;
+      }
+      copy_shard(fh, text, shard);
+    }
+    if (fclose(fh) != 0)
+      ok = false;
+  }
+
+  for (i = 0; i < nshards; i++) {
+    unlink(qnames[i]);
+    unlink(snames[i]);
+    free(qnames[i]);
+    free(snames[i]);
+  }
+  free(qnames);
+  free(snames);
+  free(pids);
+  free(funcs);
+  free(shared);
+  free(text);
+
+  if (!ok) {
+    fprintf(stderr, "QBE translation of %s failed\n", qbefile);
+    unlink(asmfile);
+    exit(1);
+  }
+  return (true);
+}
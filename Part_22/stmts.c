@@ -52,7 +52,8 @@ ASTnode *declaration_statement(ASTnode * s, ASTnode * e) {
   sym = add_symbol(s->strlit, ST_VARIABLE, s->type, SV_LOCAL);
   sym->has_addr = true;
   sym->is_const= s->is_const;
-  sym->keytype= s->keytype;
+  if (s->is_array == false)
+    sym->keytype= s->keytype;
 
   // If the declaration was marked as an array,
   // update the symbol
@@ -71,6 +72,9 @@ ASTnode *declaration_statement(ASTnode * s, ASTnode * e) {
     e = newnode;
   }
 
+  // Remember the value of a const scalar
+  const_initval(sym, e);
+
   // Add the symbol pointer and the expresson to the s node.
   // Update the node's operation
   s->sym = sym;
@@ -4,33 +4,59 @@
 #include "alic.h"
 #include "proto.h"
 
-static Strlit *Strhead = NULL;	// Linked list of literals
+// The literals are kept in a list, and also in a
+// hash table keyed on their value and constness
 
 // Add a new string literal to the list
 // and return its label number
 int add_strlit(char *name, bool is_const) {
   Strlit *this;
+  int bucket;
+
+  name = intern(name);
+  bucket = (namehash(name) * 2 + is_const) & (STRHASHSIZE - 1);
 
   // If it already exists, don't add it
-  for (this = Strhead; this != NULL; this = this->next)
-    if (!strcmp(this->val, name) && (this->is_const == is_const))
+  for (this = State.Strhash[bucket]; this != NULL; this = this->hashnext)
+    if (this->val == name && this->is_const == is_const)
       return (this->label);
 
-  // Make a new Strlit node and link it to the list
+  // Make a new Strlit node and append it to the list
+  // so that the literals are output in order of first use
   this = (Strlit *) Malloc(sizeof(Strlit));
 
-  this->val = strdup(name);
+  this->val = name;
   this->label = genlabel();
-  this->next = Strhead;
+  this->next = NULL;
   this->is_const= is_const;
-  Strhead = this;
+  this->hashnext = State.Strhash[bucket];
+  State.Strhash[bucket] = this;
+  if (State.Strhead == NULL)
+    State.Strhead = this;
+  else
+    State.Strtail->next = this;
+  State.Strtail = this;
   return (this->label);
 }
 
-// Generate code for all string literals
+// Generate code for all string literals. Then
+// empty the list, ready for the next output file
 void gen_strlits(void) {
   Strlit *this;
 
-  for (this = Strhead; this != NULL; this = this->next)
+  for (this = State.Strhead; this != NULL; this = this->next)
     cgstrlit(this->label, this->val, this->is_const);
+  free_strlits();
+}
+
+// Empty the list of string literals
+void free_strlits(void) {
+  Strlit *this, *next;
+
+  for (this = State.Strhead; this != NULL; this = next) {
+    next = this->next;
+    free(this);
+  }
+  State.Strhead = State.Strtail = NULL;
+  memset(State.Strhash, 0, sizeof(State.Strhash));
 }
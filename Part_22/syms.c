@@ -4,13 +4,131 @@
 #include "alic.h"
 #include "proto.h"
 
-static Scope *Scopehead = NULL;	// Pointer to the most recent scope
-static Scope *Globhead = NULL;	// Pointer to the global symbol table
+// As well as the per-scope lists of symbols, every visible
+// symbol is kept in a hash table so that we don't have to
+// walk all the lists to find one. Struct members are kept
+// in a second hash table keyed on the struct's type.
+// Each bucket holds a chain of these entries.
+struct Hashent {
+  Sym *sym;			// The symbol in this entry
+  void *owner;			// The Scope or struct Type which holds it
+  Hashent *next;		// Next entry in the same bucket
+};
+
+// Return the bucket number for an interned symbol name
+static int symbucket(char *name) {
+  return (namehash(name) & (SYMHASHSIZE - 1));
+}
+
+// Return the bucket number for an interned member name
+static int membbucket(Type * ty, char *name) {
+  return ((namehash(name) ^ (uintptr_t) ty) & (MEMBHASHSIZE - 1));
+}
+
+// Insert a symbol and its owner into a hash bucket
+static void add_hashent(Hashent ** bucket, Sym * sym, void *owner) {
+  Hashent *ent;
+
+  // Reuse a free entry if we have one
+  if (State.Freeent != NULL) {
+    ent = State.Freeent;
+    State.Freeent = State.Freeent->next;
+  } else
+    ent = (Hashent *) Malloc(sizeof(Hashent));
+
+  ent->sym = sym;
+  ent->owner = owner;
+  ent->next = *bucket;
+  *bucket = ent;
+}
+
+// Remove a symbol from the symbol hash table
+static void del_hashent(Sym * sym) {
+  Hashent **prev, *ent;
+
+  prev = &State.Symhash[symbucket(sym->name)];
+  for (ent = *prev; ent != NULL; prev = &(ent->next), ent = ent->next) {
+    if (ent->sym == sym) {
+      *prev = ent->next;
+      ent->next = State.Freeent;
+      State.Freeent = ent;
+      return;
+    }
+  }
+}
 
 // Initialise the symbol table
 void init_symtable(void) {
-  Scopehead = (Scope *) Calloc(sizeof(Scope));
-  Globhead = Scopehead;
+  State.Scopehead = (Scope *) Aalloc(State.Permarena, sizeof(Scope));
+  State.Globhead = State.Scopehead;
+  memset(State.Symhash, 0, sizeof(State.Symhash));
+  memset(State.Membhash, 0, sizeof(State.Membhash));
+  State.Unitfile = NULL;
+  State.Unitnum = 0;
+}
+
+// Free a chain of hash entries
+static void free_hashents(Hashent * ent) {
+  Hashent *next;
+
+  for (; ent != NULL; ent = next) {
+    next = ent->next;
+    free(ent);
+  }
+}
+
+// Free the entries in the symbol table's hash tables.
+// The symbols themselves are in the arenas
+void free_symtable(void) {
+  int i;
+
+  for (i = 0; i < SYMHASHSIZE; i++)
+    free_hashents(State.Symhash[i]);
+  for (i = 0; i < MEMBHASHSIZE; i++)
+    free_hashents(State.Membhash[i]);
+  free_hashents(State.Freeent);
+}
+
+// With -U, start parsing the named file.
+// Hide the private globals of the file before it
+void new_unit(char *filename) {
+  Sym *this;
+
+  for (this = State.Globhead->head; this != NULL; this = this->next)
+    if (this->in_unit) {
+      del_hashent(this);
+      this->in_unit = false;
+    }
+  State.Unitfile = filename;
+  State.Unitnum++;
+}
+
+// With -U, deal with a new global symbol. A private one
+// declared in the file itself (not in a header) is hidden
+// at the end of the file. If an earlier file has a private
+// variable or function of the same name, the new one gets
+// a different name in the QBE code. Only private ones can
+static void add_unit_symbol(Sym * sym) {
+  char buf[TEXTLEN + 16];
+  Sym *this;
+
+  if (sym->visibility == SV_PRIVATE && strcmp(State.Infilename, State.Unitfile))
+    return;
+
+  for (this = State.Globhead->head; this != sym; this = this->next) {
+    if (this->name != sym->name ||
+	(this->symtype != ST_VARIABLE && this->has_block == false))
+      continue;
+    if (sym->visibility != SV_PRIVATE)
+      fatal("%s clashes with a private %s in an earlier file\n",
+	    sym->name, sym->name);
+    snprintf(buf, sizeof(buf), "%s.%d", sym->name, State.Unitnum);
+    sym->qbename = intern(buf);
+    break;
+  }
+
+  if (sym->visibility == SV_PRIVATE)
+    sym->in_unit = true;
 }
 
 // Given a pointer to the head of a symbol list, add
@@ -20,20 +138,21 @@ void init_symtable(void) {
 Sym *add_sym_to(Sym ** head, char *name, int symtype, Type * type) {
   Sym *this, *last;
 
+  if (name != NULL)
+    name = intern(name);
+
   // Walk the list to see if the symbol is already there.
   // Also point last at the last node in the list
   for (this = last = *head; this != NULL; last = this, this = this->next)
-    if (!strcmp(this->name, name))
+    if (this->name == name)
       return (NULL);
 
-  // Make the new symbol node
-  this = (Sym *) Calloc(sizeof(Sym));
+  // Make the new symbol node. These lists hang
+  // off global symbols, so use the global arena
+  this = (Sym *) Aalloc(State.Permarena, sizeof(Sym));
 
   // Fill in the fields
-  if (name != NULL)
-    this->name = strdup(name);
-  else
-    this->name = NULL;
+  this->name = name;
   this->symtype = symtype;
   this->type = type;
 
@@ -47,62 +166,111 @@ Sym *add_sym_to(Sym ** head, char *name, int symtype, Type * type) {
   return (this);
 }
 
+// Add a new symbol to the given scope. If the
+// symbol's name is already in that scope, return
+// NULL. Otherwise return a pointer to the new symbol.
+static Sym *add_sym_to_scope(Scope * scope, char *name,
+			     int symtype, Type * type) {
+  Hashent *ent;
+  Sym *this;
+  int bucket;
+
+  name = intern(name);
+  bucket = symbucket(name);
+
+  // See if the symbol is already in this scope
+  for (ent = State.Symhash[bucket]; ent != NULL; ent = ent->next)
+    if (ent->owner == scope && ent->sym->name == name)
+      return (NULL);
+
+  // Make the new symbol node and fill in the fields.
+  // Local symbols go in the function's arena
+  if (scope == State.Globhead)
+    this = (Sym *) Aalloc(State.Permarena, sizeof(Sym));
+  else
+    this = (Sym *) Aalloc(State.Thisarena, sizeof(Sym));
+  this->name = name;
+  this->symtype = symtype;
+  this->type = type;
+
+  // Append it to the scope's list
+  if (scope->head == NULL)
+    scope->head = this;
+  else
+    scope->tail->next = this;
+  scope->tail = this;
+
+  // and add it to the hash table
+  add_hashent(&State.Symhash[bucket], this, scope);
+  return (this);
+}
+
 // Add a new symbol to the current or the global scope.
 // Return a pointer to the symbol
 Sym *add_symbol(char *name, int symtype, Type * type, int visibility) {
   Sym *this;
 
   if (visibility != SV_LOCAL) {
-    this = add_sym_to(&(Globhead->head), name, symtype, type);
+    this = add_sym_to_scope(State.Globhead, name, symtype, type);
     if (this != NULL) {
       this->has_addr = true;
       this->visibility = visibility;
+      if (State.Unitfile != NULL)
+	add_unit_symbol(this);
     }
   } else {
-    this = add_sym_to(&(Scopehead->head), name, symtype, type);
+    this = add_sym_to_scope(State.Scopehead, name, symtype, type);
     if (this != NULL)
       this->visibility = visibility;
   }
   return (this);
 }
 
-// Find a symbol in any of the scope's symbol lists or return.
-// NULL if not found. For now I'm not worried about performance
+// Find a symbol in any of the visible scopes or
+// return NULL if not found. The parameters of the
+// function we are parsing are in its outermost scope.
+// The name must be interned.
 Sym *find_symbol(char *name) {
-  Scope *thisscope;
-  Sym *this, *param;
+  Hashent *ent;
 
   if (name == NULL)
     return (NULL);
 
-  for (thisscope = Scopehead; thisscope != NULL; thisscope = thisscope->next) {
-    for (this = thisscope->head; this != NULL; this = this->next) {
-      if (!strcmp(this->name, name))
-	return (this);
-
-      // If this is the function we are currently processing,
-      // walk the parameter list to find matching symbols.
-      // Also check for any exception variable
-      if (this == Thisfunction) {
-	for (param = this->paramlist; param != NULL; param = param->next)
-	  if (!strcmp(param->name, name))
-	    return (param);
-	if ((this->exceptvar != NULL) && !strcmp(this->exceptvar->name, name))
-	  return (this->exceptvar);
-      }
-    }
-  }
+  // The most recently added symbols are
+  // at the front of each bucket's chain
+  for (ent = State.Symhash[symbucket(name)]; ent != NULL; ent = ent->next)
+    if (ent->sym->name == name)
+      return (ent->sym);
 
   return (NULL);
 }
 
+// Return the list of global symbols
+Sym *global_symbols(void) {
+  return (State.Globhead->head);
+}
+
 // Start a new scope section on the symbol table.
+// If func is not NULL, we are starting the body of
+// this function, so make its parameters and any
+// exception variable visible in the new scope.
 void new_scope(Sym * func) {
   Scope *thisscope;
+  Sym *param;
+
+  thisscope = (Scope *) Aalloc(State.Thisarena, sizeof(Scope));
+  thisscope->func = func;
+  thisscope->next = State.Scopehead;
+  State.Scopehead = thisscope;
 
-  thisscope = (Scope *) Calloc(sizeof(Scope));
-  thisscope->next = Scopehead;
-  Scopehead = thisscope;
+  if (func == NULL)
+    return;
+
+  for (param = func->paramlist; param != NULL; param = param->next)
+    add_hashent(&State.Symhash[symbucket(param->name)], param, thisscope);
+  if (func->exceptvar != NULL)
+    add_hashent(&State.Symhash[symbucket(func->exceptvar->name)],
+		func->exceptvar, thisscope);
 }
 
 // Remove the latest scope section from the symbol table.
@@ -112,7 +280,7 @@ ASTnode * end_scope(void) {
   ASTnode *e=NULL;
 
   // If there are any associative arrays in this scope, free them
-  for (this = Scopehead->head; this != NULL; this = this->next) {
+  for (this = State.Scopehead->head; this != NULL; this = this->next) {
     if (this->keytype != NULL) {
       e= mkastleaf(A_AAFREE, NULL, false, this, 0);
       if (d==NULL)
@@ -121,13 +289,48 @@ ASTnode * end_scope(void) {
         d= mkastnode(A_GLUE, d, NULL, e);
     }
   }
+
+  // Remove the scope's symbols and any
+  // function parameters from the hash table
+  for (this = State.Scopehead->head; this != NULL; this = this->next)
+    del_hashent(this);
+  if (State.Scopehead->func != NULL) {
+    for (this = State.Scopehead->func->paramlist; this != NULL;
+	 this = this->next)
+      del_hashent(this);
+    if (State.Scopehead->func->exceptvar != NULL)
+      del_hashent(State.Scopehead->func->exceptvar);
+  }
   
-  Scopehead = Scopehead->next;
-  if (Scopehead == NULL)
+  State.Scopehead = State.Scopehead->next;
+  if (State.Scopehead == NULL)
     fatal("Somehow we have lost the global scope!\n");
   return(d);
 }
 
+// Append a member to a struct type's list of
+// members and add it to the member hash table.
+// last points at the current last member or is NULL
+void add_member(Type * ty, Sym * memb, Sym * last) {
+  if (last == NULL)
+    ty->memb = memb;
+  else
+    last->next = memb;
+  add_hashent(&State.Membhash[membbucket(ty, memb->name)], memb, ty);
+}
+
+// Find a member of a struct type or return
+// NULL if not found. The name must be interned
+Sym *find_member(Type * ty, char *name) {
+  Hashent *ent;
+
+  for (ent = State.Membhash[membbucket(ty, name)]; ent != NULL; ent = ent->next)
+    if (ent->owner == ty && ent->sym->name == name)
+      return (ent->sym);
+
+  return (NULL);
+}
+
 // Given an A_IDENT node, confirm that it
 // is a known symbol. Set the node's type
 // and return it.
@@ -195,7 +398,7 @@ void dumpsyms(void) {
   fprintf(Debugfh, "Global symbol table\n");
   fprintf(Debugfh, "-------------------\n");
 
-  for (this = Globhead->head; this != NULL; this = this->next) {
+  for (this = State.Globhead->head; this != NULL; this = this->next) {
     fprintf(Debugfh, "%s %s", get_typename(this->type), this->name);
 
     switch (this->symtype) {
@@ -0,0 +1 @@
+string index out of range in main()
@@ -0,0 +1 @@
+fred[5] out of bounds in main()
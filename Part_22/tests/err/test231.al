@@ -0,0 +1 @@
+fred[7] out of bounds in main()
@@ -0,0 +1,13 @@
+36 2 2 -8
+4 13 3
+48 6 -12 -13
+-3 -2 -136
+1 1 0
+1333333333 3 250000000
+1 1
+1 1 1
+-9223372036854775808 9223372036854775807
+5.000000 0.625000
+K is small
+x is 10
+x is 100
@@ -0,0 +1,10 @@
+hello "a\n" world
+2
+TWO
+2
+5
+7
+3 line 54
+7 line 57
+8 line 61
+x86_64 test227.al 1 1 1
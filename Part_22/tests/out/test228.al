@@ -0,0 +1,60 @@
+0: 0 0 0 0 0 0
+  0 0 0 0 0 0 0 0
+  0 0 0 0
+1: 1 0 1 0 1 0
+  1 0 1 0 1 0 1 0
+  1 0 1 0
+7: 7 3 1 0 7 0
+  7 2 1 1 0 0 7 0
+  7 -1 3 0
+100: 100 50 0 12 4 0
+  100 33 1 14 2 10 0 0
+  100 -25 0 -10
+12345: 12345 6172 1 1543 1 0
+  12345 4115 0 1763 4 1234 5 12
+  345 -3086 1 -1234
+2147483647: 2147483647 1073741823 1 268435455 7 32767
+  65535 715827882 1 306783378 1 214748364 7 2147483
+  647 -536870911 3 -214748364
+-1: -1 0 -1 0 -1 0
+  -1 0 -1 0 -1 0 -1 0
+  -1 0 -1 0
+-7: -7 -3 -1 0 -7 0
+  -7 -2 -1 -1 0 0 -7 0
+  -7 1 -3 0
+-8: -8 -4 0 -1 0 0
+  -8 -2 -2 -1 -1 0 -8 0
+  -8 2 0 0
+-100: -100 -50 0 -12 -4 0
+  -100 -33 -1 -14 -2 -10 0 0
+  -100 25 0 10
+-12345: -12345 -6172 -1 -1543 -1 0
+  -12345 -4115 0 -1763 -4 -1234 -5 -12
+  -345 3086 -1 1234
+-2147483648: -2147483648 -1073741824 0 -268435456 0 -32768
+  0 -715827882 -2 -306783378 -2 -214748364 -8 -2147483
+  -648 536870912 0 214748364
+0: 0 0 0 0 0 0 0
+  0 0 0 0
+1: 0 1 0 1 0 1 0
+  1 0 1 0
+7: 3 1 0 7 2 1 1
+  0 0 7 0
+100: 50 0 6 4 33 1 14
+  2 10 0 0
+2147483648: 1073741824 0 134217728 0 715827882 2 306783378
+  2 214748364 8 2147
+4294967295: 2147483647 1 268435455 15 1431655765 0 613566756
+  3 429496729 5 4294
+0: 0 0 0 0 0 0
+9: 2 1 3 0 0 9
+1000000000000: 250000000000 0 333333333333 1 1000000000 0
+9223372036854775807: 2305843009213693951 3 3074457345618258602 1 9223372036854775 807
+-1: 0 -1 0 -1 0 -1
+-9: -2 -1 -3 0 0 -9
+-1000000000000: -250000000000 0 -333333333333 -1 -1000000000 0
+-9223372036854775808: -2305843009213693952 0 -3074457345618258602 -2 -9223372036854775 -808
+0: 0 0 0 0 0 0
+17: 4 1 5 2 0 17
+10000000000: 2500000000 0 3333333333 1 10000000 0
+4000000000000000007: 1000000000000000001 3 1333333333333333335 2 4000000000000000 7
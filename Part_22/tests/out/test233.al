@@ -0,0 +1 @@
+114 results checked
@@ -0,0 +1,24 @@
+#include <stdio.ah>
+
+// An index is multiplied by the size of the array's
+// elements. For these sizes the multiply is a shift
+// has: =l shl %\.t[0-9]+, 2$
+// has: =l shl %\.t[0-9]+, 3$
+// has: =l shl %\.t[0-9]+, 6$
+// hasnt: mul
+
+public void main(void) {
+  int32 fred[10];
+  int64 jim[4][8];
+  int32 *p;
+  int32 i;
+  int32 j;
+
+  for (i = 0; i < 10; i++)
+    fred[i] = i + 1;
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 8; j++)
+      jim[i][j] = i + j;
+  p = &fred[2];
+  printf("%d %d %d\n", fred[7], jim[3][5], p[i]);
+}
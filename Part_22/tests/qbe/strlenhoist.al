@@ -0,0 +1,15 @@
+#include <stdio.ah>
+
+// Each index of a string checks it against the string's
+// length. The loop can't change the string, as printf()
+// stores into no memory, so the length is found once
+// before the loop instead of at each index
+// once: call \$strlen\(
+
+public void main(void) {
+  string s = "hello";
+  int32 i;
+
+  for (i = 0; i < 4; i++)
+    printf("%c%c\n", s[i], s[i + 1]);
+}
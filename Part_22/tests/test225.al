@@ -0,0 +1,21 @@
+#include <stdio.ah>
+#include <string.ah>
+
+// A store into the buffer behind a string
+// shortens it, so the loop must not keep
+// using the string's old length
+
+public void main(void) {
+  int8 buf[20];
+  string s;
+  int32 i;
+  int32 sum = 0;
+
+  strcpy(buf, "hello world");
+  s = buf;
+  for (i = 0; i < 8; i++) {
+    if (i == 2) buf[1] = 0;
+    sum = sum + s[i];
+  }
+  printf("%d\n", sum);
+}
@@ -0,0 +1,53 @@
+#include <stdio.ah>
+#include <limits.ah>
+
+// Constant folding, const propagation and the
+// removal of branches which can't run
+
+const int32 K = 12;
+const uint32 U = 4000000000;
+const flt64 F = 2.5;
+
+public void main(void) {
+  const int32 NEG = -17;
+  int32 x = 3;
+  int64 min = INT64_MIN;
+  int64 max = INT64_MAX;
+
+  // Signed integer operations
+  printf("%d %d %d %d\n", K * 3, K / 5, K % 5, K - 20);
+  printf("%d %d %d\n", K & 6, K | 1, K ^ 15);
+  printf("%d %d %d %d\n", K << 2, K >> 1, -K, ~K);
+  printf("%d %d %d\n", NEG / 5, NEG % 5, NEG << 3);
+  printf("%d %d %d\n", K < 20, K == 12, (K > 5) && (K < 10));
+
+  // Unsigned integer operations
+  printf("%u %u %u\n", U / 3, U % 7, U >> 4);
+  printf("%d %d\n", U > 3000000000, U + 1 > U);
+
+  // Sums which wrap around in their words
+  printf("%d %d %d\n", (2147483647 + 1) < 0, (4294967295 + 1) == 0,
+         (65536 * 65536) == 0);
+  printf("%ld %ld\n", min, max);
+
+  // Floats
+  printf("%f %f\n", F * 2.0, F / 4.0);
+
+  // Branches which can't run
+  if (K > 100)
+    printf("never\n");
+  else
+    printf("K is small\n");
+
+  while (K < 0) {
+    printf("never\n");
+  }
+
+  for (x = 10; K < 0; x++) {
+    printf("never\n");
+  }
+  printf("x is %d\n", x);
+
+  x = (K == 12) ? 100 : 200;
+  printf("x is %d\n", x);
+}
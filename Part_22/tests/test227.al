@@ -0,0 +1,63 @@
+#include <stdio.ah>
+
+// The pre-processor: # and ##, macro calls over
+// several lines, predefined macros and #if
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define CAT(a, b) a ## b
+#define ADD(a, b) ((a) + (b))
+#define TWO 2
+#define VAR(n) var ## n
+#define OBJ foo ## bar
+
+#if defined(__x86_64__)
+#define ARCH "x86_64"
+#else
+#define ARCH "other"
+#endif
+
+#if '\n' == 10 && '\t' == 9 && '\0' == 0 && '\\' == 92 && '\x41' == 65 && '\101' == 65
+#define ESC 1
+#else
+#define ESC 0
+#endif
+
+#if 0 && (1 / 0)
+#error no short circuit
+#endif
+#if 1 || (1 % 0)
+#define SC 1
+#endif
+#if 1 ? 2 : (3 / 0)
+#endif
+
+#if __LINE__ > 30 && defined(__FILE__)
+#define LATE 1
+#else
+#define LATE 0
+#endif
+
+public void main(void) {
+  int32 var1 = 5;
+  int32 foobar = 7;
+  int32 x;
+
+  printf("%s\n", STR(hello   "a\n"  world));
+  printf("%s\n", XSTR(TWO));
+  printf("%s\n", STR(TWO));
+  printf("%d\n", CAT(TW, O));
+  printf("%d\n", VAR(1));
+  printf("%d\n", OBJ);
+  x = ADD(1,
+          TWO);
+  printf("%d line %d\n", x, __LINE__);
+  x = ADD
+      (3, 4);
+  printf("%d line %d\n", x, __LINE__);
+  x = ADD(ADD(1,
+              2),
+          ADD(TWO, 3));
+  printf("%d line %d\n", x, __LINE__);
+  printf("%s %s %d %d %d\n", ARCH, __FILE__, ESC, SC, LATE);
+}
@@ -0,0 +1,49 @@
+#include <stdio.ah>
+#include <limits.ah>
+
+// Strength reduction of divide and modulo by constants:
+// signed and unsigned, powers of two and other values,
+// negative dividends and the most negative values
+
+int32 s32[12] = { 0, 1, 7, 100, 12345, 2147483647, -1, -7, -8, -100,
+		  -12345, INT32_MIN };
+uint32 u32[6] = { 0, 1, 7, 100, 2147483648, 4294967295 };
+int64 s64[8] = { 0, 9, 1000000000000, INT64_MAX, -1, -9,
+		 -1000000000000, INT64_MIN };
+uint64 u64[4] = { 0, 17, 10000000000, 4000000000000000007 };
+
+public void main(void) {
+  int32 x;
+  uint32 u;
+  int64 y;
+  uint64 v;
+  int i;
+
+  for (i = 0; i < 12; i++) {
+    x = s32[i];
+    printf("%d: %d %d %d %d %d %d\n", x, x / 1, x / 2, x % 2, x / 8,
+	   x % 8, x / 65536);
+    printf("  %d %d %d %d %d %d %d %d\n", x % 65536, x / 3, x % 3,
+	   x / 7, x % 7, x / 10, x % 10, x / 1000);
+    printf("  %d %d %d %d\n", x % 1000, x / -4, x % -4, x / -10);
+  }
+
+  for (i = 0; i < 6; i++) {
+    u = u32[i];
+    printf("%u: %u %u %u %u %u %u %u\n", u, u / 2, u % 2, u / 16,
+	   u % 16, u / 3, u % 3, u / 7);
+    printf("  %u %u %u %u\n", u % 7, u / 10, u % 10, u / 1000000);
+  }
+
+  for (i = 0; i < 8; i++) {
+    y = s64[i];
+    printf("%ld: %ld %ld %ld %ld %ld %ld\n", y, y / 4, y % 4,
+	   y / 3, y % 3, y / 1000, y % 1000);
+  }
+
+  for (i = 0; i < 4; i++) {
+    v = u64[i];
+    printf("%lu: %lu %lu %lu %lu %lu %lu\n", v, v / 4, v % 4,
+	   v / 3, v % 3, v / 1000, v % 1000);
+  }
+}
@@ -0,0 +1,12 @@
+#include <stdio.ah>
+
+// The bounds check stays when the loop
+// can reach the array's size: i <= 5
+public void main(void) {
+  int32 fred[5];
+  int32 i;
+
+  for (i = 0; i <= 5; i++)
+    fred[i] = i;
+  printf("%d\n", fred[4]);
+}
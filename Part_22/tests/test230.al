@@ -0,0 +1,15 @@
+#include <stdio.ah>
+
+// The bounds check stays when the
+// loop's body changes the loop variable
+public void main(void) {
+  int32 fred[5];
+  int32 i;
+
+  for (i = 0; i < 5; i++) {
+    if (i == 3)
+      i = 5;
+    fred[i] = i;
+  }
+  printf("%d\n", fred[3]);
+}
@@ -0,0 +1,19 @@
+#include <stdio.ah>
+
+// The bounds check stays when the loop variable
+// is a global, which a function call can change
+int32 i;
+
+void bump(void) {
+  i = i + 3;
+}
+
+public void main(void) {
+  int32 fred[5];
+
+  for (i = 0; i < 5; i++) {
+    bump();
+    fred[i] = i;
+  }
+  printf("%d\n", fred[3]);
+}
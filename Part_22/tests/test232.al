@@ -0,0 +1,12 @@
+#include <stdio.ah>
+
+// The bounds check stays when
+// foreach goes up to the array's size
+public void main(void) {
+  int32 fred[5];
+  int32 i;
+
+  foreach i (0 ... 5)
+    fred[i] = i;
+  printf("%d\n", fred[4]);
+}
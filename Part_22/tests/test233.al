@@ -0,0 +1,377 @@
+#include <stdio.ah>
+
+// Check that constant folding gives the same
+// results as the run-time code, including
+// where the values wrap around. Each fa_N()
+// has its operands folded, each fb_N() gets
+// the same operands as arguments
+
+int32 checked;
+
+void check(int32 n, int64 folded, int64 runtime) {
+  if (folded != runtime)
+    printf("%d: %ld folded, %ld at run-time\n", n, folded, runtime);
+  checked++;
+}
+
+void ucheck(int32 n, uint64 folded, uint64 runtime) {
+  if (folded != runtime)
+    printf("%d: %lu folded, %lu at run-time\n", n, folded, runtime);
+  checked++;
+}
+
+void bcheck(int32 n, bool folded, bool runtime) {
+  if (folded != runtime)
+    printf("%d: %d folded, %d at run-time\n", n, folded, runtime);
+  checked++;
+}
+
+int8 fa_0(void) { const int8 x = 127; const int8 y = 3; return (x + y); }
+int8 fb_0(int8 x, int8 y) { return (x + y); }
+int8 fa_1(void) { const int8 x = -128; const int8 y = 5; return (x - y); }
+int8 fb_1(int8 x, int8 y) { return (x - y); }
+int8 fa_2(void) { const int8 x = 127; const int8 y = 7; return (x * y); }
+int8 fb_2(int8 x, int8 y) { return (x * y); }
+int8 fa_3(void) { const int8 x = -127; const int8 y = 7; return (x / y); }
+int8 fb_3(int8 x, int8 y) { return (x / y); }
+int8 fa_4(void) { const int8 x = -127; const int8 y = 10; return (x % y); }
+int8 fb_4(int8 x, int8 y) { return (x % y); }
+int8 fa_5(void) { const int8 x = -86; const int8 y = 95; return (x & y); }
+int8 fb_5(int8 x, int8 y) { return (x & y); }
+int8 fa_6(void) { const int8 x = -128; const int8 y = 51; return (x | y); }
+int8 fb_6(int8 x, int8 y) { return (x | y); }
+int8 fa_7(void) { const int8 x = -1; const int8 y = 85; return (x ^ y); }
+int8 fb_7(int8 x, int8 y) { return (x ^ y); }
+int8 fa_8(void) { const int8 x = 127; const int8 y = 3; return (x << y); }
+int8 fb_8(int8 x, int8 y) { return (x << y); }
+int8 fa_9(void) { const int8 x = -128; const int8 y = 3; return (x >> y); }
+int8 fb_9(int8 x, int8 y) { return (x >> y); }
+bool fa_10(void) { const int8 x = -128; const int8 y = 127; return (x < y); }
+bool fb_10(int8 x, int8 y) { return (x < y); }
+bool fa_11(void) { const int8 x = 127; const int8 y = -1; return (x >= y); }
+bool fb_11(int8 x, int8 y) { return (x >= y); }
+int8 fa_12(void) { const int8 x = -127; const int8 y = 0; return (-x); }
+int8 fb_12(int8 x, int8 y) { return (-x); }
+int8 fa_13(void) { const int8 x = 127; const int8 y = 0; return (~x); }
+int8 fb_13(int8 x, int8 y) { return (~x); }
+uint8 fa_14(void) { const uint8 x = 255; const uint8 y = 3; return (x + y); }
+uint8 fb_14(uint8 x, uint8 y) { return (x + y); }
+uint8 fa_15(void) { const uint8 x = 2; const uint8 y = 5; return (x - y); }
+uint8 fb_15(uint8 x, uint8 y) { return (x - y); }
+uint8 fa_16(void) { const uint8 x = 255; const uint8 y = 7; return (x * y); }
+uint8 fb_16(uint8 x, uint8 y) { return (x * y); }
+uint8 fa_17(void) { const uint8 x = 255; const uint8 y = 7; return (x / y); }
+uint8 fb_17(uint8 x, uint8 y) { return (x / y); }
+uint8 fa_18(void) { const uint8 x = 255; const uint8 y = 10; return (x % y); }
+uint8 fb_18(uint8 x, uint8 y) { return (x % y); }
+uint8 fa_19(void) { const uint8 x = 170; const uint8 y = 95; return (x & y); }
+uint8 fb_19(uint8 x, uint8 y) { return (x & y); }
+uint8 fa_20(void) { const uint8 x = 127; const uint8 y = 51; return (x | y); }
+uint8 fb_20(uint8 x, uint8 y) { return (x | y); }
+uint8 fa_21(void) { const uint8 x = 255; const uint8 y = 85; return (x ^ y); }
+uint8 fb_21(uint8 x, uint8 y) { return (x ^ y); }
+uint8 fa_22(void) { const uint8 x = 255; const uint8 y = 3; return (x << y); }
+uint8 fb_22(uint8 x, uint8 y) { return (x << y); }
+uint8 fa_23(void) { const uint8 x = 255; const uint8 y = 3; return (x >> y); }
+uint8 fb_23(uint8 x, uint8 y) { return (x >> y); }
+bool fa_24(void) { const uint8 x = 0; const uint8 y = 255; return (x < y); }
+bool fb_24(uint8 x, uint8 y) { return (x < y); }
+bool fa_25(void) { const uint8 x = 255; const uint8 y = 1; return (x >= y); }
+bool fb_25(uint8 x, uint8 y) { return (x >= y); }
+uint8 fa_26(void) { const uint8 x = 5; const uint8 y = 0; return (~x); }
+uint8 fb_26(uint8 x, uint8 y) { return (~x); }
+int16 fa_27(void) { const int16 x = 32767; const int16 y = 3; return (x + y); }
+int16 fb_27(int16 x, int16 y) { return (x + y); }
+int16 fa_28(void) { const int16 x = -32768; const int16 y = 5; return (x - y); }
+int16 fb_28(int16 x, int16 y) { return (x - y); }
+int16 fa_29(void) { const int16 x = 32767; const int16 y = 7; return (x * y); }
+int16 fb_29(int16 x, int16 y) { return (x * y); }
+int16 fa_30(void) { const int16 x = -32767; const int16 y = 7; return (x / y); }
+int16 fb_30(int16 x, int16 y) { return (x / y); }
+int16 fa_31(void) { const int16 x = -32767; const int16 y = 10; return (x % y); }
+int16 fb_31(int16 x, int16 y) { return (x % y); }
+int16 fa_32(void) { const int16 x = -86; const int16 y = 95; return (x & y); }
+int16 fb_32(int16 x, int16 y) { return (x & y); }
+int16 fa_33(void) { const int16 x = -32768; const int16 y = 51; return (x | y); }
+int16 fb_33(int16 x, int16 y) { return (x | y); }
+int16 fa_34(void) { const int16 x = -1; const int16 y = 85; return (x ^ y); }
+int16 fb_34(int16 x, int16 y) { return (x ^ y); }
+int16 fa_35(void) { const int16 x = 32767; const int16 y = 3; return (x << y); }
+int16 fb_35(int16 x, int16 y) { return (x << y); }
+int16 fa_36(void) { const int16 x = -32768; const int16 y = 3; return (x >> y); }
+int16 fb_36(int16 x, int16 y) { return (x >> y); }
+bool fa_37(void) { const int16 x = -32768; const int16 y = 32767; return (x < y); }
+bool fb_37(int16 x, int16 y) { return (x < y); }
+bool fa_38(void) { const int16 x = 32767; const int16 y = -1; return (x >= y); }
+bool fb_38(int16 x, int16 y) { return (x >= y); }
+int16 fa_39(void) { const int16 x = -32767; const int16 y = 0; return (-x); }
+int16 fb_39(int16 x, int16 y) { return (-x); }
+int16 fa_40(void) { const int16 x = 32767; const int16 y = 0; return (~x); }
+int16 fb_40(int16 x, int16 y) { return (~x); }
+uint16 fa_41(void) { const uint16 x = 65535; const uint16 y = 3; return (x + y); }
+uint16 fb_41(uint16 x, uint16 y) { return (x + y); }
+uint16 fa_42(void) { const uint16 x = 2; const uint16 y = 5; return (x - y); }
+uint16 fb_42(uint16 x, uint16 y) { return (x - y); }
+uint16 fa_43(void) { const uint16 x = 65535; const uint16 y = 7; return (x * y); }
+uint16 fb_43(uint16 x, uint16 y) { return (x * y); }
+uint16 fa_44(void) { const uint16 x = 65535; const uint16 y = 7; return (x / y); }
+uint16 fb_44(uint16 x, uint16 y) { return (x / y); }
+uint16 fa_45(void) { const uint16 x = 65535; const uint16 y = 10; return (x % y); }
+uint16 fb_45(uint16 x, uint16 y) { return (x % y); }
+uint16 fa_46(void) { const uint16 x = 65450; const uint16 y = 95; return (x & y); }
+uint16 fb_46(uint16 x, uint16 y) { return (x & y); }
+uint16 fa_47(void) { const uint16 x = 32767; const uint16 y = 51; return (x | y); }
+uint16 fb_47(uint16 x, uint16 y) { return (x | y); }
+uint16 fa_48(void) { const uint16 x = 65535; const uint16 y = 85; return (x ^ y); }
+uint16 fb_48(uint16 x, uint16 y) { return (x ^ y); }
+uint16 fa_49(void) { const uint16 x = 65535; const uint16 y = 3; return (x << y); }
+uint16 fb_49(uint16 x, uint16 y) { return (x << y); }
+uint16 fa_50(void) { const uint16 x = 65535; const uint16 y = 3; return (x >> y); }
+uint16 fb_50(uint16 x, uint16 y) { return (x >> y); }
+bool fa_51(void) { const uint16 x = 0; const uint16 y = 65535; return (x < y); }
+bool fb_51(uint16 x, uint16 y) { return (x < y); }
+bool fa_52(void) { const uint16 x = 65535; const uint16 y = 1; return (x >= y); }
+bool fb_52(uint16 x, uint16 y) { return (x >= y); }
+uint16 fa_53(void) { const uint16 x = 5; const uint16 y = 0; return (~x); }
+uint16 fb_53(uint16 x, uint16 y) { return (~x); }
+int32 fa_54(void) { const int32 x = 2147483647; const int32 y = 3; return (x + y); }
+int32 fb_54(int32 x, int32 y) { return (x + y); }
+int32 fa_55(void) { const int32 x = -2147483648; const int32 y = 5; return (x - y); }
+int32 fb_55(int32 x, int32 y) { return (x - y); }
+int32 fa_56(void) { const int32 x = 2147483647; const int32 y = 7; return (x * y); }
+int32 fb_56(int32 x, int32 y) { return (x * y); }
+int32 fa_57(void) { const int32 x = -2147483647; const int32 y = 7; return (x / y); }
+int32 fb_57(int32 x, int32 y) { return (x / y); }
+int32 fa_58(void) { const int32 x = -2147483647; const int32 y = 10; return (x % y); }
+int32 fb_58(int32 x, int32 y) { return (x % y); }
+int32 fa_59(void) { const int32 x = -86; const int32 y = 95; return (x & y); }
+int32 fb_59(int32 x, int32 y) { return (x & y); }
+int32 fa_60(void) { const int32 x = -2147483648; const int32 y = 51; return (x | y); }
+int32 fb_60(int32 x, int32 y) { return (x | y); }
+int32 fa_61(void) { const int32 x = -1; const int32 y = 85; return (x ^ y); }
+int32 fb_61(int32 x, int32 y) { return (x ^ y); }
+int32 fa_62(void) { const int32 x = 2147483647; const int32 y = 3; return (x << y); }
+int32 fb_62(int32 x, int32 y) { return (x << y); }
+int32 fa_63(void) { const int32 x = -2147483648; const int32 y = 3; return (x >> y); }
+int32 fb_63(int32 x, int32 y) { return (x >> y); }
+bool fa_64(void) { const int32 x = -2147483648; const int32 y = 2147483647; return (x < y); }
+bool fb_64(int32 x, int32 y) { return (x < y); }
+bool fa_65(void) { const int32 x = 2147483647; const int32 y = -1; return (x >= y); }
+bool fb_65(int32 x, int32 y) { return (x >= y); }
+int32 fa_66(void) { const int32 x = -2147483647; const int32 y = 0; return (-x); }
+int32 fb_66(int32 x, int32 y) { return (-x); }
+int32 fa_67(void) { const int32 x = 2147483647; const int32 y = 0; return (~x); }
+int32 fb_67(int32 x, int32 y) { return (~x); }
+uint32 fa_68(void) { const uint32 x = 4294967295; const uint32 y = 3; return (x + y); }
+uint32 fb_68(uint32 x, uint32 y) { return (x + y); }
+uint32 fa_69(void) { const uint32 x = 2; const uint32 y = 5; return (x - y); }
+uint32 fb_69(uint32 x, uint32 y) { return (x - y); }
+uint32 fa_70(void) { const uint32 x = 4294967295; const uint32 y = 7; return (x * y); }
+uint32 fb_70(uint32 x, uint32 y) { return (x * y); }
+uint32 fa_71(void) { const uint32 x = 4294967295; const uint32 y = 7; return (x / y); }
+uint32 fb_71(uint32 x, uint32 y) { return (x / y); }
+uint32 fa_72(void) { const uint32 x = 4294967295; const uint32 y = 10; return (x % y); }
+uint32 fb_72(uint32 x, uint32 y) { return (x % y); }
+uint32 fa_73(void) { const uint32 x = 4294967210; const uint32 y = 95; return (x & y); }
+uint32 fb_73(uint32 x, uint32 y) { return (x & y); }
+uint32 fa_74(void) { const uint32 x = 2147483647; const uint32 y = 51; return (x | y); }
+uint32 fb_74(uint32 x, uint32 y) { return (x | y); }
+uint32 fa_75(void) { const uint32 x = 4294967295; const uint32 y = 85; return (x ^ y); }
+uint32 fb_75(uint32 x, uint32 y) { return (x ^ y); }
+uint32 fa_76(void) { const uint32 x = 4294967295; const uint32 y = 3; return (x << y); }
+uint32 fb_76(uint32 x, uint32 y) { return (x << y); }
+uint32 fa_77(void) { const uint32 x = 4294967295; const uint32 y = 3; return (x >> y); }
+uint32 fb_77(uint32 x, uint32 y) { return (x >> y); }
+bool fa_78(void) { const uint32 x = 0; const uint32 y = 4294967295; return (x < y); }
+bool fb_78(uint32 x, uint32 y) { return (x < y); }
+bool fa_79(void) { const uint32 x = 4294967295; const uint32 y = 1; return (x >= y); }
+bool fb_79(uint32 x, uint32 y) { return (x >= y); }
+uint32 fa_80(void) { const uint32 x = 5; const uint32 y = 0; return (~x); }
+uint32 fb_80(uint32 x, uint32 y) { return (~x); }
+int64 fa_81(void) { const int64 x = 9223372036854775807; const int64 y = 3; return (x + y); }
+int64 fb_81(int64 x, int64 y) { return (x + y); }
+int64 fa_82(void) { const int64 x = -9223372036854775808; const int64 y = 5; return (x - y); }
+int64 fb_82(int64 x, int64 y) { return (x - y); }
+int64 fa_83(void) { const int64 x = 9223372036854775807; const int64 y = 7; return (x * y); }
+int64 fb_83(int64 x, int64 y) { return (x * y); }
+int64 fa_84(void) { const int64 x = -9223372036854775807; const int64 y = 7; return (x / y); }
+int64 fb_84(int64 x, int64 y) { return (x / y); }
+int64 fa_85(void) { const int64 x = -9223372036854775807; const int64 y = 10; return (x % y); }
+int64 fb_85(int64 x, int64 y) { return (x % y); }
+int64 fa_86(void) { const int64 x = -86; const int64 y = 95; return (x & y); }
+int64 fb_86(int64 x, int64 y) { return (x & y); }
+int64 fa_87(void) { const int64 x = -9223372036854775808; const int64 y = 51; return (x | y); }
+int64 fb_87(int64 x, int64 y) { return (x | y); }
+int64 fa_88(void) { const int64 x = -1; const int64 y = 85; return (x ^ y); }
+int64 fb_88(int64 x, int64 y) { return (x ^ y); }
+int64 fa_89(void) { const int64 x = 9223372036854775807; const int64 y = 3; return (x << y); }
+int64 fb_89(int64 x, int64 y) { return (x << y); }
+int64 fa_90(void) { const int64 x = -9223372036854775808; const int64 y = 3; return (x >> y); }
+int64 fb_90(int64 x, int64 y) { return (x >> y); }
+bool fa_91(void) { const int64 x = -9223372036854775808; const int64 y = 9223372036854775807; return (x < y); }
+bool fb_91(int64 x, int64 y) { return (x < y); }
+bool fa_92(void) { const int64 x = 9223372036854775807; const int64 y = -1; return (x >= y); }
+bool fb_92(int64 x, int64 y) { return (x >= y); }
+int64 fa_93(void) { const int64 x = -9223372036854775807; const int64 y = 0; return (-x); }
+int64 fb_93(int64 x, int64 y) { return (-x); }
+int64 fa_94(void) { const int64 x = 9223372036854775807; const int64 y = 0; return (~x); }
+int64 fb_94(int64 x, int64 y) { return (~x); }
+uint64 fa_95(void) { const uint64 x = 9223372036854775807; const uint64 y = 3; return (x + y); }
+uint64 fb_95(uint64 x, uint64 y) { return (x + y); }
+uint64 fa_96(void) { const uint64 x = 2; const uint64 y = 5; return (x - y); }
+uint64 fb_96(uint64 x, uint64 y) { return (x - y); }
+uint64 fa_97(void) { const uint64 x = 9223372036854775807; const uint64 y = 7; return (x * y); }
+uint64 fb_97(uint64 x, uint64 y) { return (x * y); }
+uint64 fa_98(void) { const uint64 x = 9223372036854775807; const uint64 y = 7; return (x / y); }
+uint64 fb_98(uint64 x, uint64 y) { return (x / y); }
+uint64 fa_99(void) { const uint64 x = 9223372036854775807; const uint64 y = 10; return (x % y); }
+uint64 fb_99(uint64 x, uint64 y) { return (x % y); }
+uint64 fa_100(void) { const uint64 x = 9223372036854775722; const uint64 y = 95; return (x & y); }
+uint64 fb_100(uint64 x, uint64 y) { return (x & y); }
+uint64 fa_101(void) { const uint64 x = 4611686018427387903; const uint64 y = 51; return (x | y); }
+uint64 fb_101(uint64 x, uint64 y) { return (x | y); }
+uint64 fa_102(void) { const uint64 x = 9223372036854775807; const uint64 y = 85; return (x ^ y); }
+uint64 fb_102(uint64 x, uint64 y) { return (x ^ y); }
+uint64 fa_103(void) { const uint64 x = 9223372036854775807; const uint64 y = 3; return (x << y); }
+uint64 fb_103(uint64 x, uint64 y) { return (x << y); }
+uint64 fa_104(void) { const uint64 x = 9223372036854775807; const uint64 y = 3; return (x >> y); }
+uint64 fb_104(uint64 x, uint64 y) { return (x >> y); }
+bool fa_105(void) { const uint64 x = 0; const uint64 y = 9223372036854775807; return (x < y); }
+bool fb_105(uint64 x, uint64 y) { return (x < y); }
+bool fa_106(void) { const uint64 x = 9223372036854775807; const uint64 y = 1; return (x >= y); }
+bool fb_106(uint64 x, uint64 y) { return (x >= y); }
+uint64 fa_107(void) { const uint64 x = 5; const uint64 y = 0; return (~x); }
+uint64 fb_107(uint64 x, uint64 y) { return (~x); }
+
+// Sums of two literals which wrap in a 32-bit
+// word, then used by one of the other operators
+bool fa_108(void) { return ((2147483647 + 1) < 0); }
+bool fb_108(int32 x, int32 y) { return ((x + y) < 0); }
+int32 fa_109(void) { return ((2147483647 + 1) % 7); }
+int32 fb_109(int32 x, int32 y) { return ((x + y) % 7); }
+int32 fa_110(void) { return ((2147483647 + 1) & 0xff0); }
+int32 fb_110(int32 x, int32 y) { return ((x + y) & 0xff0); }
+int32 fa_111(void) { return ((2147483647 + 1) >> 4); }
+int32 fb_111(int32 x, int32 y) { return ((x + y) >> 4); }
+int32 fa_112(void) { return (-(2147483647 + 1)); }
+int32 fb_112(int32 x, int32 y) { return (-(x + y)); }
+bool fa_113(void) { return ((2147483647 + 1) == -2147483648); }
+bool fb_113(int32 x, int32 y) { return ((x + y) == -2147483648); }
+
+public void main(void) {
+  check(0, fa_0(), fb_0(127, 3));
+  check(1, fa_1(), fb_1(-128, 5));
+  check(2, fa_2(), fb_2(127, 7));
+  check(3, fa_3(), fb_3(-127, 7));
+  check(4, fa_4(), fb_4(-127, 10));
+  check(5, fa_5(), fb_5(-86, 95));
+  check(6, fa_6(), fb_6(-128, 51));
+  check(7, fa_7(), fb_7(-1, 85));
+  check(8, fa_8(), fb_8(127, 3));
+  check(9, fa_9(), fb_9(-128, 3));
+  bcheck(10, fa_10(), fb_10(-128, 127));
+  bcheck(11, fa_11(), fb_11(127, -1));
+  check(12, fa_12(), fb_12(-127, 0));
+  check(13, fa_13(), fb_13(127, 0));
+  ucheck(14, fa_14(), fb_14(255, 3));
+  ucheck(15, fa_15(), fb_15(2, 5));
+  ucheck(16, fa_16(), fb_16(255, 7));
+  ucheck(17, fa_17(), fb_17(255, 7));
+  ucheck(18, fa_18(), fb_18(255, 10));
+  ucheck(19, fa_19(), fb_19(170, 95));
+  ucheck(20, fa_20(), fb_20(127, 51));
+  ucheck(21, fa_21(), fb_21(255, 85));
+  ucheck(22, fa_22(), fb_22(255, 3));
+  ucheck(23, fa_23(), fb_23(255, 3));
+  bcheck(24, fa_24(), fb_24(0, 255));
+  bcheck(25, fa_25(), fb_25(255, 1));
+  ucheck(26, fa_26(), fb_26(5, 0));
+  check(27, fa_27(), fb_27(32767, 3));
+  check(28, fa_28(), fb_28(-32768, 5));
+  check(29, fa_29(), fb_29(32767, 7));
+  check(30, fa_30(), fb_30(-32767, 7));
+  check(31, fa_31(), fb_31(-32767, 10));
+  check(32, fa_32(), fb_32(-86, 95));
+  check(33, fa_33(), fb_33(-32768, 51));
+  check(34, fa_34(), fb_34(-1, 85));
+  check(35, fa_35(), fb_35(32767, 3));
+  check(36, fa_36(), fb_36(-32768, 3));
+  bcheck(37, fa_37(), fb_37(-32768, 32767));
+  bcheck(38, fa_38(), fb_38(32767, -1));
+  check(39, fa_39(), fb_39(-32767, 0));
+  check(40, fa_40(), fb_40(32767, 0));
+  ucheck(41, fa_41(), fb_41(65535, 3));
+  ucheck(42, fa_42(), fb_42(2, 5));
+  ucheck(43, fa_43(), fb_43(65535, 7));
+  ucheck(44, fa_44(), fb_44(65535, 7));
+  ucheck(45, fa_45(), fb_45(65535, 10));
+  ucheck(46, fa_46(), fb_46(65450, 95));
+  ucheck(47, fa_47(), fb_47(32767, 51));
+  ucheck(48, fa_48(), fb_48(65535, 85));
+  ucheck(49, fa_49(), fb_49(65535, 3));
+  ucheck(50, fa_50(), fb_50(65535, 3));
+  bcheck(51, fa_51(), fb_51(0, 65535));
+  bcheck(52, fa_52(), fb_52(65535, 1));
+  ucheck(53, fa_53(), fb_53(5, 0));
+  check(54, fa_54(), fb_54(2147483647, 3));
+  check(55, fa_55(), fb_55(-2147483648, 5));
+  check(56, fa_56(), fb_56(2147483647, 7));
+  check(57, fa_57(), fb_57(-2147483647, 7));
+  check(58, fa_58(), fb_58(-2147483647, 10));
+  check(59, fa_59(), fb_59(-86, 95));
+  check(60, fa_60(), fb_60(-2147483648, 51));
+  check(61, fa_61(), fb_61(-1, 85));
+  check(62, fa_62(), fb_62(2147483647, 3));
+  check(63, fa_63(), fb_63(-2147483648, 3));
+  bcheck(64, fa_64(), fb_64(-2147483648, 2147483647));
+  bcheck(65, fa_65(), fb_65(2147483647, -1));
+  check(66, fa_66(), fb_66(-2147483647, 0));
+  check(67, fa_67(), fb_67(2147483647, 0));
+  ucheck(68, fa_68(), fb_68(4294967295, 3));
+  ucheck(69, fa_69(), fb_69(2, 5));
+  ucheck(70, fa_70(), fb_70(4294967295, 7));
+  ucheck(71, fa_71(), fb_71(4294967295, 7));
+  ucheck(72, fa_72(), fb_72(4294967295, 10));
+  ucheck(73, fa_73(), fb_73(4294967210, 95));
+  ucheck(74, fa_74(), fb_74(2147483647, 51));
+  ucheck(75, fa_75(), fb_75(4294967295, 85));
+  ucheck(76, fa_76(), fb_76(4294967295, 3));
+  ucheck(77, fa_77(), fb_77(4294967295, 3));
+  bcheck(78, fa_78(), fb_78(0, 4294967295));
+  bcheck(79, fa_79(), fb_79(4294967295, 1));
+  ucheck(80, fa_80(), fb_80(5, 0));
+  check(81, fa_81(), fb_81(9223372036854775807, 3));
+  check(82, fa_82(), fb_82(-9223372036854775808, 5));
+  check(83, fa_83(), fb_83(9223372036854775807, 7));
+  check(84, fa_84(), fb_84(-9223372036854775807, 7));
+  check(85, fa_85(), fb_85(-9223372036854775807, 10));
+  check(86, fa_86(), fb_86(-86, 95));
+  check(87, fa_87(), fb_87(-9223372036854775808, 51));
+  check(88, fa_88(), fb_88(-1, 85));
+  check(89, fa_89(), fb_89(9223372036854775807, 3));
+  check(90, fa_90(), fb_90(-9223372036854775808, 3));
+  bcheck(91, fa_91(), fb_91(-9223372036854775808, 9223372036854775807));
+  bcheck(92, fa_92(), fb_92(9223372036854775807, -1));
+  check(93, fa_93(), fb_93(-9223372036854775807, 0));
+  check(94, fa_94(), fb_94(9223372036854775807, 0));
+  ucheck(95, fa_95(), fb_95(9223372036854775807, 3));
+  ucheck(96, fa_96(), fb_96(2, 5));
+  ucheck(97, fa_97(), fb_97(9223372036854775807, 7));
+  ucheck(98, fa_98(), fb_98(9223372036854775807, 7));
+  ucheck(99, fa_99(), fb_99(9223372036854775807, 10));
+  ucheck(100, fa_100(), fb_100(9223372036854775722, 95));
+  ucheck(101, fa_101(), fb_101(4611686018427387903, 51));
+  ucheck(102, fa_102(), fb_102(9223372036854775807, 85));
+  ucheck(103, fa_103(), fb_103(9223372036854775807, 3));
+  ucheck(104, fa_104(), fb_104(9223372036854775807, 3));
+  bcheck(105, fa_105(), fb_105(0, 9223372036854775807));
+  bcheck(106, fa_106(), fb_106(9223372036854775807, 1));
+  ucheck(107, fa_107(), fb_107(5, 0));
+  bcheck(108, fa_108(), fb_108(2147483647, 1));
+  check(109, fa_109(), fb_109(2147483647, 1));
+  check(110, fa_110(), fb_110(2147483647, 1));
+  check(111, fa_111(), fb_111(2147483647, 1));
+  check(112, fa_112(), fb_112(2147483647, 1));
+  bcheck(113, fa_113(), fb_113(2147483647, 1));
+  printf("%d results checked\n", checked);
+}
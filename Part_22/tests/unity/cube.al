@@ -0,0 +1,11 @@
+#include "shapes.ah"
+
+#define SCALE 100
+
+int32 scale(int32 x) {
+  return (x * SCALE);
+}
+
+public int32 cube_volume(int32 side) {
+  return (scale(side * side * side));
+}
@@ -0,0 +1,19 @@
+// Compile with the other files using -U.
+// Each file has its own private scale() and
+// SCALE macro, and the output should be
+// the same as compiling them one at a time
+#include <stdio.ah>
+#include "shapes.ah"
+
+#define SCALE 1
+
+int32 scale(int32 x) {
+  return (x * SCALE);
+}
+
+public void main(void) {
+  int32 i;
+
+  for (i = 1; i <= 3; i++)
+    printf("%d: %d %d %d\n", i, scale(i), square_area(i), cube_volume(i));
+}
@@ -0,0 +1,16 @@
+#include "shapes.ah"
+
+#define SCALE 10
+
+int32 scale(int32 x) {
+  return (x * SCALE);
+}
+
+// Nothing calls this
+int32 unused_square(int32 x) {
+  return (x * x);
+}
+
+public int32 square_area(int32 side) {
+  return (scale(side * side));
+}
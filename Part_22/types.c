@@ -16,31 +16,59 @@ int64_t typemax[8]= {
   UINT8_MAX, UINT16_MAX, UINT32_MAX, 0
 };
 
-Type *ty_void = &(Type) { TY_VOID, 1 };
-Type *ty_bool = &(Type) { TY_BOOL, 1 };
+// The built-in types. Each thread's state has a copy
+// of them, as they are linked into its list of types.
+// Precompiled headers refer to them by their position
+// in this list
+static const Type Builtins[NUMBUILTIN] = {
+  { TY_VOID, 1 },
+  { TY_BOOL, 1 },
+  { TY_INT8, 1 },
+  { TY_INT16, 2 },
+  { TY_INT32, 4 },
+  { TY_INT64, 8 },
+  { TY_INT8, 1, true },
+  { TY_INT16, 2, true },
+  { TY_INT32, 4, true },
+  { TY_INT64, 8, true },
+  { TY_FLT32, 4 },
+  { TY_FLT64, 8 },
+  { TY_VOID, 8, false, 1 },		// Used by NULL
+  { TY_STRING, 8, false, 1 }
+};
 
-Type *ty_int8 = &(Type) { TY_INT8, 1 };
-Type *ty_int16 = &(Type) { TY_INT16, 2 };
-Type *ty_int32 = &(Type) { TY_INT32, 4 };
-Type *ty_int64 = &(Type) { TY_INT64, 8 };
+// As well as being on the Typehead list, each type is
+// in a hash table keyed on its name (or its kind and
+// signedness if it has no name) and its pointer depth.
 
-Type *ty_uint8 = &(Type) { TY_INT8, 1, true };
-Type *ty_uint16 = &(Type) { TY_INT16, 2, true };
-Type *ty_uint32 = &(Type) { TY_INT32, 4, true };
-Type *ty_uint64 = &(Type) { TY_INT64, 8, true };
+// Return the bucket number for a type. Named
+// types are found by their interned name only
+static int typebucket(char *name, int kind, bool is_unsigned, int ptr_depth) {
+  uint64_t hash;
 
-Type *ty_flt32 = &(Type) { TY_FLT32, 4 };
-Type *ty_flt64 = &(Type) { TY_FLT64, 8 };
+  if (name != NULL)
+    hash = namehash(name);
+  else
+    hash = kind * 2 + is_unsigned;
+  return ((hash * 31 + ptr_depth) & (TYPEHASHSIZE - 1));
+}
 
-Type *ty_voidptr = &(Type) { TY_VOID, 8, false, 1 };	// Used by NULL
-Type *ty_string  = &(Type) { TY_STRING, 8, false, 1 };
+// Add a type to the type hash table
+static void add_typehash(Type * ty) {
+  int bucket = typebucket(ty->name, ty->kind, ty->is_unsigned, ty->ptr_depth);
 
-// Global variables
-Type *Typehead;
+  ty->ptrto = NULL;
+  ty->valat = NULL;
+  ty->hashnext = State.Typehash[bucket];
+  State.Typehash[bucket] = ty;
+}
 
 // Initialise the type list with the built-in types
 void init_typelist(void) {
-  Typehead = ty_voidptr;
+  Type *ty;
+
+  memcpy(State.Builtins, Builtins, sizeof(Builtins));
+  State.Typehead = ty_voidptr;
   ty_voidptr->next = ty_string;
   ty_string->next = ty_void;
   ty_void->next = ty_bool;
@@ -55,6 +83,18 @@ void init_typelist(void) {
   ty_uint64->next = ty_flt32;
   ty_flt32->next = ty_flt64;
   ty_flt64->next = NULL;
+
+  memset(State.Typehash, 0, sizeof(State.Typehash));
+  for (ty = State.Typehead; ty != NULL; ty = ty->next)
+    add_typehash(ty);
+}
+
+// Return the built-in type at the given position
+// in the list of them, or NULL if there isn't one
+Type *builtin_type(int i) {
+  if (i < 0 || i >= NUMBUILTIN)
+    return (NULL);
+  return (&State.Builtins[i]);
 }
 
 // Create a new Type struct and
@@ -68,6 +108,7 @@ Type *new_type(int kind, int size, bool is_unsigned,
   // See if this is an existing type.
   // If it is and it's not an opaque type, a problem
   if (name != NULL) {
+    name= intern(name);
     ty= find_type(name, 0, false, ptr_depth);
     if ((ty != NULL) && (ty->size > 0))
     fatal("Type %s already exists\n", name);
@@ -75,7 +116,7 @@ Type *new_type(int kind, int size, bool is_unsigned,
 
   // It doesn't exist, make a Type node
   if (ty == NULL) {
-    ty = Calloc(sizeof(Type));
+    ty = Aalloc(State.Permarena, sizeof(Type));
     newnode= true;
   }
 
@@ -89,18 +130,21 @@ Type *new_type(int kind, int size, bool is_unsigned,
 
   // Add it to the list of types
   if (newnode == true) {
-    if (Typehead != NULL)
-      ty->next = Typehead;
-    Typehead = ty;
+    if (State.Typehead != NULL)
+      ty->next = State.Typehead;
+    State.Typehead = ty;
+    add_typehash(ty);
   } else {
     // We've redefined an opaque type. Walk the
     // list of types. Find any type which points
-    // to a type of this name and fill in the basetype
-    for (walktype= Typehead; walktype != NULL; walktype= walktype->next) {
-      if ((walktype->ptr_depth > 0) && (walktype->name!=NULL) &&
-				!strcmp(walktype->name, ty->name)) {
+    // to a type of this name and fill in the basetype.
+    // As an alias now resolves to its base type,
+    // forget any cached value_at() results
+    for (walktype= State.Typehead; walktype != NULL; walktype= walktype->next) {
+      if ((walktype->ptr_depth > 0) && (walktype->name == ty->name)) {
 	walktype->basetype= ty;
 	walktype->kind= ty->kind;
+	walktype->valat= NULL;
       }
     }
   }
@@ -108,9 +152,9 @@ Type *new_type(int kind, int size, bool is_unsigned,
   return (ty);
 }
 
-// Given either a user-defined type name or
-// (if NULL) a built-in typekind, and the
-// pointer depth, return a pointer to the
+// Given either an interned user-defined type
+// name or (if NULL) a built-in typekind, and
+// the pointer depth, return a pointer to the
 // relevant Type structure, or NULL if it
 // does not exist
 Type *find_type(char *typename, int kind, bool is_unsigned, int ptr_depth) {
@@ -118,9 +162,9 @@ Type *find_type(char *typename, int kind, bool is_unsigned, int ptr_depth) {
 
   if (typename != NULL) {
     // We have a name, so search for this name
-    for (this = Typehead; this != NULL; this = this->next) {
-      if (this->name != NULL && this->ptr_depth == ptr_depth
-	  && !strcmp(this->name, typename)) {
+    for (this = State.Typehash[typebucket(typename, 0, false, ptr_depth)];
+	 this != NULL; this = this->hashnext) {
+      if (this->name == typename && this->ptr_depth == ptr_depth) {
 	// This type could be an alias.
 	// If so, return the base type but not when
 	// the type has a range
@@ -134,7 +178,8 @@ Type *find_type(char *typename, int kind, bool is_unsigned, int ptr_depth) {
   } else {
     // Otherwise, search for the type kind. Don't look at
     // any types with names
-    for (this = Typehead; this != NULL; this = this->next) {
+    for (this = State.Typehash[typebucket(NULL, kind, is_unsigned, ptr_depth)];
+	 this != NULL; this = this->hashnext) {
       if (this->name == NULL && this->kind == kind &&
 	  this->is_unsigned == is_unsigned && this->ptr_depth == ptr_depth)
 	return (this);
@@ -149,14 +194,20 @@ Type *find_type(char *typename, int kind, bool is_unsigned, int ptr_depth) {
 Type *pointer_to(Type * ty) {
   Type *this;
 
+  // Use the cached result if we have one
+  if (ty->ptrto != NULL)
+    return (ty->ptrto);
+
   // Search for a pointer to this type
   this = find_type(ty->name, ty->kind, ty->is_unsigned, ty->ptr_depth + 1);
-  if (this != NULL)
-    return (this);
 
-  // We didn't find one, so make one and return it.
-  return (new_type(ty->kind, PTR_SIZE, ty->is_unsigned,
-		ty->ptr_depth + 1, ty->name, ty->basetype));
+  // We didn't find one, so make one
+  if (this == NULL)
+    this = new_type(ty->kind, PTR_SIZE, ty->is_unsigned,
+		ty->ptr_depth + 1, ty->name, ty->basetype);
+
+  ty->ptrto = this;
+  return (this);
 }
 
 // Given a type pointer, return a type that
@@ -170,14 +221,20 @@ Type *value_at(Type * ty) {
   // *string becomes int8
   if (ty == ty_string) return(ty_int8);
 
+  // Use the cached result if we have one
+  if (ty->valat != NULL)
+    return (ty->valat);
+
   // Search for the type that we point to
   this = find_type(ty->name, ty->kind, ty->is_unsigned, ty->ptr_depth - 1);
-  if (this != NULL)
-    return (this);
 
-  // We didn't find one, so make one and return it.
-  return (new_type(ty->kind, PTR_SIZE, ty->is_unsigned,
-		ty->ptr_depth - 1, ty->name, ty->basetype));
+  // We didn't find one, so make one
+  if (this == NULL)
+    this = new_type(ty->kind, PTR_SIZE, ty->is_unsigned,
+		ty->ptr_depth - 1, ty->name, ty->basetype);
+
+  ty->valat = this;
+  return (this);
 }
 
 // Is this type an integer?
@@ -219,7 +276,7 @@ static char *typename[] = {
 };
 
 #define TYPELEN 255
-static char typenbuf[TYPELEN];
+static _Thread_local char typenbuf[TYPELEN];
 
 // Return a string representing the type.
 char *get_typename(Type * ty) {
@@ -442,7 +499,7 @@ Type *get_funcptr_type(Sym *sym) {
   bool params_match;
 
   // Walk the list
-  for (this = Typehead; this != NULL; this = this->next) {
+  for (this = State.Typehead; this != NULL; this = this->next) {
 
     // Skip things that are not function pointers
     if (this->kind != TY_FUNCPTR) continue;